@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "interleave.h"
+#include "memo.h"
+#include "predecode.h"
+#include "rom.h"
+#include "scheduler.h"
+#include "watch.h"
+
+// headless runner: plays every rom given for a number of frames with the
+// same keys held, stops a rom early once --until is true, and prints the
+// --print expressions for each one as a line of
+//   ROM FRAMES VALUE...
+// roms run a few at a time, interleaved (see interleave.h)
+// with --memo, frames already seen (the same rom listed again, attract
+// loops) are replayed from a cache of that many frames instead of emulated
+// --cpu pins the run to one cpu, so several batches started side by side
+// don't get moved around between cores and sockets
+
+enum batch_constants
+{
+    PRINT_NB = 16
+};
+
+// a rom being run
+struct lane_t
+{
+    const char *path;
+    struct chip8_rom_t *rom;
+    struct chip8_predecode_t *pd;
+    long frame;
+    int done;
+    // with --memo, the hash of its state
+    uint64_t hash;
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-batch [--frames N] [--keys MASK] [--until EXPR] [--print EXPR]... [--memo FRAMES] [--cpu N] ROM...\n");
+    exit(1);
+}
+
+void compile(struct chip8_watch_t *w, const char *src)
+{
+    char err[128];
+    if (chip8_watch_t_compile(w, src, err, sizeof(err)) < 0)
+    {
+        fprintf(stderr, "%s\n  %s\n", src, err);
+        exit(1);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 600;
+    uint16_t keys = 0;
+    long memo_nb = 0;
+    long cpu = -1;
+
+    struct chip8_watch_t until;
+    int has_until = 0;
+    static struct chip8_watch_t prints[PRINT_NB];
+    size_t prints_nb = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            keys = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--until") == 0 && i + 1 < argc)
+        {
+            compile(&until, argv[++i]);
+            has_until = 1;
+        }
+        else if (strcmp(argv[i], "--memo") == 0 && i + 1 < argc)
+        {
+            memo_nb = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)
+        {
+            cpu = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--print") == 0 && i + 1 < argc && prints_nb < PRINT_NB)
+        {
+            compile(prints + prints_nb++, argv[++i]);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (i == argc || frames < 0 || memo_nb < 0)
+    {
+        usage();
+    }
+    if (cpu >= 0 && chip8_pin_thread(cpu) < 0)
+    {
+        fprintf(stderr, "Could not pin to cpu %ld\n", cpu);
+        return 1;
+    }
+
+    static struct chip8_memo_t memo;
+    if (memo_nb > 0 && chip8_memo_t_init(&memo, memo_nb) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    int status = 0;
+    static union chip8_t states[INTERLEAVE_WAYS];
+    struct lane_t lanes[INTERLEAVE_WAYS];
+    while (i < argc)
+    {
+        // up to INTERLEAVE_WAYS roms at a time, stepped together
+        size_t lanes_nb = 0;
+        for (; i < argc && lanes_nb < INTERLEAVE_WAYS; i++)
+        {
+            struct chip8_rom_t *rom = chip8_rom_t_load(argv[i]);
+            struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+            if (pd == NULL)
+            {
+                fprintf(stderr, "Could not open ROM %s\n", argv[i]);
+                chip8_rom_t_release(rom);
+                status = 1;
+                continue;
+            }
+            chip8_rom_t_boot(rom, states + lanes_nb);
+            chip8_t_set_keys(states + lanes_nb, keys);
+            lanes[lanes_nb++] = (struct lane_t){.path = argv[i], .rom = rom, .pd = pd};
+        }
+
+        // the expressions are checked at every frame boundary
+        for (;;)
+        {
+            union chip8_t *running[INTERLEAVE_WAYS];
+            const struct chip8_predecode_t *pds[INTERLEAVE_WAYS];
+            size_t running_nb = 0;
+            size_t active = 0;
+            for (size_t l = 0; l < lanes_nb; l++)
+            {
+                struct lane_t *lane = lanes + l;
+                lane->done = lane->done || lane->frame == frames ||
+                             (has_until && chip8_watch_t_eval(&until, states + l, lane->frame));
+                if (lane->done)
+                {
+                    continue;
+                }
+                active++;
+                if (memo_nb > 0)
+                {
+                    chip8_memo_t_frame(&memo, states + l, lane->pd, keys, &lane->hash);
+                }
+                else
+                {
+                    running[running_nb] = states + l;
+                    pds[running_nb++] = lane->pd;
+                }
+                lane->frame++;
+            }
+            if (active == 0)
+            {
+                break;
+            }
+            chip8_t_run_interleaved(running, pds, running_nb, CYCLES_PER_FRAME);
+        }
+
+        for (size_t l = 0; l < lanes_nb; l++)
+        {
+            printf("%s %ld", lanes[l].path, lanes[l].frame);
+            for (size_t j = 0; j < prints_nb; j++)
+            {
+                printf(" %lld", (long long)chip8_watch_t_eval(prints + j, states + l, lanes[l].frame));
+            }
+            printf("\n");
+
+            chip8_predecode_t_release(lanes[l].pd);
+            chip8_rom_t_release(lanes[l].rom);
+        }
+    }
+
+    if (memo_nb > 0)
+    {
+        fprintf(stderr, "memo: %llu frames replayed, %llu emulated\n", (unsigned long long)memo.hits,
+                (unsigned long long)(memo.misses));
+        chip8_memo_t_destroy(&memo);
+    }
+    return status;
+}
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "beam.h"
+
+// everything that makes two branches different apart from the keys they
+// held. pages the instance never wrote to are the rom in every branch,
+// so only the interpreter area and the dirty pages are hashed
+static uint64_t state_hash(const union chip8_t *c8)
+{
+    const size_t keys = offsetof(union chip8_t, keys);
+    const size_t rest = offsetof(union chip8_t, dirty_pages);
+
+    uint64_t hash = chip8_hash(c8->memory, keys);
+    hash = hash * 31 + chip8_hash(c8->memory + rest, PROG_START - rest);
+    for (size_t page = PROG_START / PAGE_SIZE; page < PAGE_NB; page++)
+    {
+        if (c8->dirty_pages & (1 << page))
+        {
+            hash = hash * 31 + chip8_hash(c8->memory + page * PAGE_SIZE, PAGE_SIZE);
+        }
+    }
+    return hash;
+}
+
+static void expand(struct chip8_beam_t *b, size_t child)
+{
+    const size_t parent = child / b->actions_nb;
+    union chip8_t *c8 = b->children + child;
+    struct chip8_beam_result_t *result = b->results + child;
+
+    memcpy(c8, b->beam + parent, sizeof(union chip8_t));
+    chip8_t_set_keys(c8, b->actions[child % b->actions_nb]);
+    for (size_t i = 0; i < b->frames_per_step * CYCLES_PER_FRAME; i++)
+    {
+        chip8_t_emulate_cycle_predecoded(c8, b->pd);
+    }
+
+    const uint64_t frame = b->frame + b->frames_per_step;
+    result->alive = b->dead == NULL || chip8_watch_t_eval(b->dead, c8, frame) == 0;
+    result->score = chip8_watch_t_eval(b->score, c8, frame);
+    result->hash = result->alive ? state_hash(c8) : 0;
+}
+
+// every thread, the caller included, takes branches until there are none left
+static void expand_all(struct chip8_beam_t *b)
+{
+    const size_t nb = b->beam_nb * b->actions_nb;
+    size_t child;
+    while ((child = atomic_fetch_add_explicit(&b->next_child, 1, memory_order_relaxed)) < nb)
+    {
+        expand(b, child);
+    }
+}
+
+static void *beam_thread(void *arg)
+{
+    struct chip8_beam_t *b = arg;
+    uint64_t seen = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&b->lock);
+        while (b->generation == seen && !b->quit)
+        {
+            pthread_cond_wait(&b->wake, &b->lock);
+        }
+        seen = b->generation;
+        const int quit = b->quit;
+        pthread_mutex_unlock(&b->lock);
+        if (quit)
+        {
+            return NULL;
+        }
+
+        expand_all(b);
+
+        pthread_mutex_lock(&b->lock);
+        if (--b->busy == 0)
+        {
+            pthread_cond_signal(&b->idle);
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+}
+
+int chip8_beam_t_init(struct chip8_beam_t *b, const struct chip8_predecode_t *pd, const union chip8_t *boot,
+                      const struct chip8_watch_t *score, const struct chip8_watch_t *dead,
+                      size_t width, size_t frames_per_step, const uint16_t *actions, size_t actions_nb,
+                      size_t steps_cap, size_t threads_nb)
+{
+    memset(b, 0, sizeof(*b));
+    b->pd = pd;
+    b->score = score;
+    b->dead = dead;
+    b->width = width;
+    b->frames_per_step = frames_per_step;
+    b->actions = actions;
+    b->actions_nb = actions_nb;
+    b->steps_cap = steps_cap;
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->wake, NULL);
+    pthread_cond_init(&b->idle, NULL);
+
+    // a power of two at least twice the width, so probing stays short
+    b->picked_nb = 1;
+    while (b->picked_nb < 2 * width)
+    {
+        b->picked_nb *= 2;
+    }
+
+    const size_t children_nb = width * actions_nb;
+    b->beam = aligned_alloc(64, width * sizeof(union chip8_t));
+    b->beam_scores = calloc(width, sizeof(int64_t));
+    b->children = aligned_alloc(64, children_nb * sizeof(union chip8_t));
+    b->results = calloc(children_nb, sizeof(struct chip8_beam_result_t));
+    b->ranks = calloc(children_nb, sizeof(struct chip8_beam_rank_t));
+    b->picked = calloc(b->picked_nb, sizeof(uint64_t));
+    b->choices = calloc(steps_cap * width, sizeof(struct chip8_beam_choice_t));
+    b->threads = calloc(threads_nb ? threads_nb : 1, sizeof(pthread_t));
+    if (width == 0 || actions_nb == 0 || b->beam == NULL || b->beam_scores == NULL || b->children == NULL ||
+        b->results == NULL || b->ranks == NULL || b->picked == NULL || b->choices == NULL || b->threads == NULL)
+    {
+        chip8_beam_t_destroy(b);
+        return -1;
+    }
+
+    memcpy(b->beam, boot, sizeof(union chip8_t));
+    b->beam_scores[0] = chip8_watch_t_eval(score, boot, 0);
+    b->beam_nb = 1;
+
+    // slot 0 stands for the caller
+    b->threads_nb = 1;
+    for (size_t i = 1; i < threads_nb; i++)
+    {
+        if (pthread_create(b->threads + i, NULL, beam_thread, b) != 0)
+        {
+            chip8_beam_t_destroy(b);
+            return -1;
+        }
+        b->threads_nb++;
+    }
+    return 0;
+}
+
+void chip8_beam_t_destroy(struct chip8_beam_t *b)
+{
+    pthread_mutex_lock(&b->lock);
+    b->quit = 1;
+    pthread_cond_broadcast(&b->wake);
+    pthread_mutex_unlock(&b->lock);
+    for (size_t i = 1; i < b->threads_nb; i++)
+    {
+        pthread_join(b->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->wake);
+    pthread_cond_destroy(&b->idle);
+
+    free(b->beam);
+    free(b->beam_scores);
+    free(b->children);
+    free(b->results);
+    free(b->ranks);
+    free(b->picked);
+    free(b->choices);
+    free(b->threads);
+    memset(b, 0, sizeof(*b));
+}
+
+// best score first, and the earlier branch first on a tie so the search
+// is the same no matter how many threads ran it
+static int rank_cmp(const void *a, const void *b)
+{
+    const struct chip8_beam_rank_t *x = a;
+    const struct chip8_beam_rank_t *y = b;
+    if (x->score != y->score)
+    {
+        return x->score < y->score ? 1 : -1;
+    }
+    return x->child < y->child ? -1 : (x->child > y->child);
+}
+
+// insert hash in the picked set, returns 0 if it was already there
+static int pick(struct chip8_beam_t *b, uint64_t hash)
+{
+    // 0 marks an empty slot
+    hash |= 1;
+    size_t slot = hash & (b->picked_nb - 1);
+    while (b->picked[slot] != 0)
+    {
+        if (b->picked[slot] == hash)
+        {
+            return 0;
+        }
+        slot = (slot + 1) & (b->picked_nb - 1);
+    }
+    b->picked[slot] = hash;
+    return 1;
+}
+
+size_t chip8_beam_t_step(struct chip8_beam_t *b)
+{
+    if (b->steps == b->steps_cap)
+    {
+        return 0;
+    }
+
+    // taking the lock on both ends is what publishes the beam to the
+    // workers and their results back to us
+    atomic_store_explicit(&b->next_child, 0, memory_order_relaxed);
+    pthread_mutex_lock(&b->lock);
+    b->generation += 1;
+    b->busy = b->threads_nb - 1;
+    pthread_cond_broadcast(&b->wake);
+    pthread_mutex_unlock(&b->lock);
+
+    expand_all(b);
+
+    pthread_mutex_lock(&b->lock);
+    while (b->busy > 0)
+    {
+        pthread_cond_wait(&b->idle, &b->lock);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    const size_t children_nb = b->beam_nb * b->actions_nb;
+    size_t alive = 0;
+    for (size_t i = 0; i < children_nb; i++)
+    {
+        if (b->results[i].alive)
+        {
+            b->ranks[alive].score = b->results[i].score;
+            b->ranks[alive].child = i;
+            alive++;
+        }
+    }
+    if (alive == 0)
+    {
+        return 0;
+    }
+    qsort(b->ranks, alive, sizeof(struct chip8_beam_rank_t), rank_cmp);
+
+    // keep the best width branches, skipping any that reached a state
+    // a better one already did
+    memset(b->picked, 0, b->picked_nb * sizeof(uint64_t));
+    struct chip8_beam_choice_t *choices = b->choices + b->steps * b->width;
+    size_t nb = 0;
+    for (size_t i = 0; i < alive && nb < b->width; i++)
+    {
+        const uint32_t child = b->ranks[i].child;
+        if (!pick(b, b->results[child].hash))
+        {
+            continue;
+        }
+        memcpy(b->beam + nb, b->children + child, sizeof(union chip8_t));
+        b->beam_scores[nb] = b->ranks[i].score;
+        choices[nb].parent = child / b->actions_nb;
+        choices[nb].keys = b->actions[child % b->actions_nb];
+        nb++;
+    }
+
+    b->beam_nb = nb;
+    b->steps += 1;
+    b->frame += b->frames_per_step;
+    return nb;
+}
+
+void chip8_beam_t_best_inputs(const struct chip8_beam_t *b, uint16_t *keys)
+{
+    size_t at = 0;
+    for (size_t step = b->steps; step-- > 0;)
+    {
+        const struct chip8_beam_choice_t *choice = b->choices + step * b->width + at;
+        keys[step] = choice->keys;
+        at = choice->parent;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef CHIP8_BEAM_H
+#define CHIP8_BEAM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "predecode.h"
+#include "watch.h"
+
+// what the search keeps for every state in the beam, enough to walk back
+// from the best one to the inputs that led there
+struct chip8_beam_choice_t
+{
+    uint32_t parent; // index in the beam one step earlier
+    uint16_t keys;   // held for the step that led here
+};
+
+// what evaluating one branch came up with
+struct chip8_beam_result_t
+{
+    int64_t score;
+    // of the state apart from the keys held, to merge branches that
+    // ended up in the same place
+    uint64_t hash;
+    int alive;
+};
+
+struct chip8_beam_rank_t
+{
+    int64_t score;
+    uint32_t child;
+};
+
+// searches for input sequences that maximize a watch expression.
+// every step, each of the width states in the beam is branched once per
+// action: the state is copied, the action's keys are held for
+// frames_per_step frames and the score is evaluated. the best width
+// distinct children become the next beam.
+// branches are spread over a pool of threads that lives as long as the
+// search, and a branch is a 4 KB copy and a run of predecoded cycles
+struct chip8_beam_t
+{
+    const struct chip8_predecode_t *pd;
+    const struct chip8_watch_t *score;
+    // optional, a branch where this is non-zero is dropped (game over,
+    // soft-lock detected, ...)
+    const struct chip8_watch_t *dead;
+
+    size_t width;
+    size_t frames_per_step;
+    const uint16_t *actions;
+    size_t actions_nb;
+
+    // the current beam from best to worst, and one slot per branch of it
+    union chip8_t *beam;
+    int64_t *beam_scores;
+    size_t beam_nb;
+    union chip8_t *children;
+    struct chip8_beam_result_t *results;
+    struct chip8_beam_rank_t *ranks;
+    // open addressing set of the state hashes already picked in a step
+    uint64_t *picked;
+    size_t picked_nb;
+
+    // width choices per step taken
+    struct chip8_beam_choice_t *choices;
+    size_t steps;
+    size_t steps_cap;
+    uint64_t frame;
+
+    // the caller and threads_nb - 1 workers take branches off next_child.
+    // a step bumps generation to wake the workers up, and waits for busy
+    // to drop back to zero
+    pthread_t *threads;
+    size_t threads_nb;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    uint64_t generation;
+    size_t busy;
+    int quit;
+    atomic_size_t next_child;
+};
+
+// start a search from boot with steps_cap steps at most, run on threads_nb
+// threads (counting the caller). the pointers have to outlive the search.
+// returns -1 if we're out of memory or can't start the threads
+int chip8_beam_t_init(struct chip8_beam_t *b, const struct chip8_predecode_t *pd, const union chip8_t *boot,
+                      const struct chip8_watch_t *score, const struct chip8_watch_t *dead,
+                      size_t width, size_t frames_per_step, const uint16_t *actions, size_t actions_nb,
+                      size_t steps_cap, size_t threads_nb);
+void chip8_beam_t_destroy(struct chip8_beam_t *b);
+
+// expand the beam by one step. returns the number of states in the new
+// beam, or 0 (and leaves the beam as it was) when every branch died, which
+// usually points at a soft-lock, or when steps_cap steps were taken
+size_t chip8_beam_t_step(struct chip8_beam_t *b);
+
+// the best state found so far
+static inline const union chip8_t *chip8_beam_t_best(const struct chip8_beam_t *b)
+{
+    return b->beam;
+}
+
+// the keys held at each step on the way to the best state, steps entries
+void chip8_beam_t_best_inputs(const struct chip8_beam_t *b, uint16_t *keys);
+
+#endif
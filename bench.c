@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "interleave.h"
+#include "predecode.h"
+#include "rom.h"
+#include "specialize.h"
+
+// interpreter benchmark: runs every rom given with each way the core can
+// execute an instruction, checks they all end in the same state, and
+// prints millions of instructions per second for each.
+// exits with 2 if any of them disagrees with chip8_t_emulate_cycle
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-bench [--frames N] [--keys MASK] ROM...\n");
+    exit(1);
+}
+
+static void run_switch(union chip8_t *c8, const struct chip8_predecode_t *pd)
+{
+    (void)pd;
+    chip8_t_emulate_cycle(c8);
+}
+
+static void run_predecoded(union chip8_t *c8, const struct chip8_predecode_t *pd)
+{
+    chip8_t_emulate_cycle_predecoded(c8, pd);
+}
+
+static void run_specialized(union chip8_t *c8, const struct chip8_predecode_t *pd)
+{
+    (void)pd;
+    chip8_t_emulate_cycle_specialized(c8);
+}
+
+static void run_specialized_small(union chip8_t *c8, const struct chip8_predecode_t *pd)
+{
+    (void)pd;
+    chip8_t_emulate_cycle_specialized_small(c8);
+}
+
+static const struct
+{
+    const char *name;
+    void (*step)(union chip8_t *c8, const struct chip8_predecode_t *pd);
+} ENGINES[] = {
+    {"switch", run_switch},
+    {"predecoded", run_predecoded},
+    {"specialized", run_specialized},
+    {"specialized-small", run_specialized_small},
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 100000;
+    uint16_t keys = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            keys = strtol(argv[++i], NULL, 0);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (i == argc || frames <= 0)
+    {
+        usage();
+    }
+
+    chip8_specialize_init();
+
+    int status = 0;
+    for (; i < argc; i++)
+    {
+        struct chip8_rom_t *rom = chip8_rom_t_load(argv[i]);
+        struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+        if (pd == NULL)
+        {
+            fprintf(stderr, "Could not open ROM %s\n", argv[i]);
+            chip8_rom_t_release(rom);
+            status = 1;
+            continue;
+        }
+
+        printf("%s\n", argv[i]);
+        union chip8_t reference;
+        long reference_cycles = 0;
+        for (size_t e = 0; e < sizeof(ENGINES) / sizeof(ENGINES[0]); e++)
+        {
+            union chip8_t c8;
+            chip8_rom_t_boot(rom, &c8);
+            chip8_t_set_keys(&c8, keys);
+
+            const double start = now();
+            long cycles = 0;
+            // stop before the core would read past the end of memory
+            for (; cycles < frames * CYCLES_PER_FRAME && c8.PC < MEM_NB - 1; cycles++)
+            {
+                ENGINES[e].step(&c8, pd);
+            }
+            const double seconds = now() - start;
+
+            int same = 1;
+            if (e == 0)
+            {
+                reference = c8;
+                reference_cycles = cycles;
+            }
+            else
+            {
+                same = memcmp(&c8, &reference, sizeof(c8)) == 0;
+            }
+            printf("  %-18s %8.1f MIPS%s\n", ENGINES[e].name, cycles / seconds / 1e6,
+                   same ? "" : "  DIFFERENT FINAL STATE");
+            if (!same)
+            {
+                status = 2;
+            }
+        }
+
+        // and several copies stepped together, counting all their cycles
+        static union chip8_t copies[INTERLEAVE_WAYS];
+        union chip8_t *c8s[INTERLEAVE_WAYS];
+        const struct chip8_predecode_t *pds[INTERLEAVE_WAYS];
+        for (size_t k = 0; k < INTERLEAVE_WAYS; k++)
+        {
+            chip8_rom_t_boot(rom, copies + k);
+            chip8_t_set_keys(copies + k, keys);
+            c8s[k] = copies + k;
+            pds[k] = pd;
+        }
+        const long cycles = reference_cycles;
+        const double start = now();
+        chip8_t_run_interleaved(c8s, pds, INTERLEAVE_WAYS, cycles);
+        const double seconds = now() - start;
+        int same = 1;
+        for (size_t k = 0; k < INTERLEAVE_WAYS; k++)
+        {
+            same = same && memcmp(copies + k, &reference, sizeof(reference)) == 0;
+        }
+        printf("  %-18s %8.1f MIPS%s\n", "interleaved", INTERLEAVE_WAYS * cycles / seconds / 1e6,
+               same ? "" : "  DIFFERENT FINAL STATE");
+        if (!same)
+        {
+            status = 2;
+        }
+
+        chip8_predecode_t_release(pd);
+        chip8_rom_t_release(rom);
+    }
+    return status;
+}
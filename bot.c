@@ -0,0 +1,158 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "beam.h"
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+#include "watch.h"
+
+// headless playtesting bot: beam searches for the inputs that maximize
+// --score, dropping branches where --dead becomes true. prints the best
+// score after every step, and the inputs that reached it at the end.
+// a step where every branch is dead is reported as a likely soft-lock
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-bot --score EXPR [--dead EXPR] [--steps N] [--width N] [--hold FRAMES]\n");
+    fprintf(stderr, "                   [--threads N] [--actions MASK,MASK,...] ROM\n");
+    exit(1);
+}
+
+void compile(struct chip8_watch_t *w, const char *src)
+{
+    char err[128];
+    if (chip8_watch_t_compile(w, src, err, sizeof(err)) < 0)
+    {
+        fprintf(stderr, "%s\n  %s\n", src, err);
+        exit(1);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    long steps = 100;
+    long width = 64;
+    long hold = 6;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *rom_path = NULL;
+
+    struct chip8_watch_t score;
+    struct chip8_watch_t dead;
+    int has_score = 0;
+    int has_dead = 0;
+
+    // nothing held, or any one key
+    uint16_t actions[64] = {0};
+    size_t actions_nb = 17;
+    for (size_t i = 1; i < actions_nb; i++)
+    {
+        actions[i] = 1 << (i - 1);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--score") == 0 && i + 1 < argc)
+        {
+            compile(&score, argv[++i]);
+            has_score = 1;
+        }
+        else if (strcmp(argv[i], "--dead") == 0 && i + 1 < argc)
+        {
+            compile(&dead, argv[++i]);
+            has_dead = 1;
+        }
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+        {
+            steps = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+        {
+            width = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc)
+        {
+            hold = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--actions") == 0 && i + 1 < argc)
+        {
+            const char *p = argv[++i];
+            for (actions_nb = 0; *p != '\0' && actions_nb < 64; actions_nb++)
+            {
+                char *end;
+                actions[actions_nb] = strtol(p, &end, 0);
+                p = *end == ',' ? end + 1 : end;
+                if (end == p && *end != '\0')
+                {
+                    usage();
+                }
+            }
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || !has_score || steps <= 0 || width <= 0 || hold <= 0 || threads <= 0 || actions_nb == 0)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    union chip8_t boot;
+    chip8_rom_t_boot(rom, &boot);
+
+    static struct chip8_beam_t b;
+    if (chip8_beam_t_init(&b, pd, &boot, &score, has_dead ? &dead : NULL, width, hold, actions, actions_nb, steps, threads) < 0)
+    {
+        fprintf(stderr, "Could not start the search\n");
+        return 1;
+    }
+
+    int status = 0;
+    for (long step = 0; step < steps; step++)
+    {
+        if (chip8_beam_t_step(&b) == 0)
+        {
+            printf("step %ld: every branch is dead, soft-lock after frame %llu?\n", step, (unsigned long long)b.frame);
+            status = 2;
+            break;
+        }
+        printf("step %ld frame %llu score %lld\n", step, (unsigned long long)b.frame, (long long)b.beam_scores[0]);
+    }
+
+    // one line per step: the frame it started on and the keys held
+    uint16_t *keys = malloc(b.steps * sizeof(uint16_t));
+    if (keys != NULL)
+    {
+        chip8_beam_t_best_inputs(&b, keys);
+        for (size_t i = 0; i < b.steps; i++)
+        {
+            printf("input %zu 0x%04X\n", i * hold, keys[i]);
+        }
+        free(keys);
+    }
+
+    chip8_beam_t_destroy(&b);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return status;
+}
@@ -0,0 +1,162 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "chip8.h"
+
+uint64_t chip8_core_id(void)
+{
+#ifdef CHIP8_CORE_ID
+    return CHIP8_CORE_ID;
+#else
+    static const char built[] = __DATE__ " " __TIME__;
+    return chip8_hash(built, sizeof(built));
+#endif
+}
+
+static int hash_file(const char *path, uint64_t *hash)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    uint8_t *data = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    int ok = 1;
+    for (;;)
+    {
+        if (size == cap)
+        {
+            cap = cap ? cap * 2 : 4096;
+            uint8_t *d = realloc(data, cap);
+            if (d == NULL)
+            {
+                ok = 0;
+                break;
+            }
+            data = d;
+        }
+        const size_t got = fread(data + size, 1, cap - size, f);
+        size += got;
+        if (got == 0)
+        {
+            break;
+        }
+    }
+    ok = ok && !ferror(f);
+    fclose(f);
+    *hash = chip8_hash(data, size);
+    free(data);
+    return ok ? 0 : -1;
+}
+
+int chip8_cache_key_t_make(struct chip8_cache_key_t *key, const struct chip8_case_t *c)
+{
+    memset(key, 0, sizeof(*key));
+    key->frames = c->frames;
+    key->core_id = chip8_core_id();
+    if (hash_file(c->rom, &key->rom_hash) < 0)
+    {
+        return -1;
+    }
+    return c->movie[0] && hash_file(c->movie, &key->movie_hash) < 0 ? -1 : 0;
+}
+
+int chip8_cache_t_open(struct chip8_cache_t *cache, const char *dir)
+{
+    memset(cache, 0, sizeof(*cache));
+    if (strlen(dir) + 32 >= sizeof(cache->dir) || (mkdir(dir, 0755) < 0 && errno != EEXIST))
+    {
+        return -1;
+    }
+    strcpy(cache->dir, dir);
+    return 0;
+}
+
+// DIR/ab/cdef..., with the first byte of the hash as a subdirectory so
+// no directory grows too big
+static void key_path(const struct chip8_cache_t *cache, const struct chip8_cache_key_t *key, char *path,
+                     size_t size, int subdir_only)
+{
+    const uint64_t fields[4] = {key->rom_hash, key->movie_hash, (uint64_t)key->frames, key->core_id};
+    const uint64_t hash = chip8_hash(fields, sizeof(fields));
+    if (subdir_only)
+    {
+        snprintf(path, size, "%s/%02x", cache->dir, (unsigned)(hash >> 56));
+    }
+    else
+    {
+        snprintf(path, size, "%s/%02x/%014llx", cache->dir, (unsigned)(hash >> 56),
+                 (unsigned long long)(hash & 0xFFFFFFFFFFFFFFULL));
+    }
+}
+
+int chip8_cache_t_get(struct chip8_cache_t *cache, const struct chip8_cache_key_t *key,
+                      struct chip8_case_result_t *result)
+{
+    char path[CACHE_PATH_NB + 32];
+    key_path(cache, key, path, sizeof(path), 0);
+    FILE *f = fopen(path, "r");
+    unsigned long long rom_hash, movie_hash, core_id, state_hash, display_hash;
+    long frames;
+    long frames_run;
+    unsigned pc;
+    const int ok = f != NULL &&
+                   fscanf(f, "%llx %llx %ld %llx %ld %x %llx %llx", &rom_hash, &movie_hash, &frames, &core_id,
+                          &frames_run, &pc, &state_hash, &display_hash) == 8 &&
+                   rom_hash == key->rom_hash && movie_hash == key->movie_hash && frames == key->frames &&
+                   core_id == key->core_id;
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+    if (!ok)
+    {
+        cache->misses++;
+        return -1;
+    }
+    result->frames = frames_run;
+    result->pc = pc;
+    result->state_hash = state_hash;
+    result->display_hash = display_hash;
+    cache->hits++;
+    return 0;
+}
+
+int chip8_cache_t_put(struct chip8_cache_t *cache, const struct chip8_cache_key_t *key,
+                      const struct chip8_case_result_t *result)
+{
+    char path[CACHE_PATH_NB + 32];
+    key_path(cache, key, path, sizeof(path), 1);
+    if (mkdir(path, 0755) < 0 && errno != EEXIST)
+    {
+        return -1;
+    }
+    key_path(cache, key, path, sizeof(path), 0);
+
+    // written next to it and renamed, so a reader never sees half of it
+    // even with several runs sharing the directory
+    char tmp[CACHE_PATH_NB + 64];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    fprintf(f, "%016llx %016llx %ld %016llx %ld %03x %016llx %016llx\n", (unsigned long long)key->rom_hash,
+            (unsigned long long)key->movie_hash, key->frames, (unsigned long long)key->core_id, result->frames,
+            result->pc, (unsigned long long)result->state_hash, (unsigned long long)result->display_hash);
+    const int ok = !ferror(f);
+    if (fclose(f) != 0 || !ok || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
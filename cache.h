@@ -0,0 +1,53 @@
+#ifndef CHIP8_CACHE_H
+#define CHIP8_CACHE_H
+
+#include <stdint.h>
+
+#include "manifest.h"
+
+enum cache_constants
+{
+    CACHE_PATH_NB = 1024
+};
+
+// everything a case's result depends on: what's in its rom and movie
+// files, how long it runs and which core runs it. the core has no quirk
+// settings, so its build id stands for its whole behaviour
+struct chip8_cache_key_t
+{
+    uint64_t rom_hash;
+    uint64_t movie_hash; // 0 without a movie
+    long frames;
+    uint64_t core_id;
+};
+
+// results of earlier runs in a directory, one small file per key named
+// after the key's hash, so runs on several machines can share it.
+// the key is stored again in the file to rule out hash collisions
+struct chip8_cache_t
+{
+    char dir[CACHE_PATH_NB];
+    uint64_t hits;
+    uint64_t misses;
+};
+
+// the id of this build of the core. the makefile derives it from the core's
+// sources and the compiler flags, so results cached by an older core are
+// never found again. without it every build gets an id of its own
+uint64_t chip8_core_id(void);
+
+// the key of a case. returns -1 if its rom or movie can't be read
+int chip8_cache_key_t_make(struct chip8_cache_key_t *key, const struct chip8_case_t *c);
+
+// use dir, creating it if needed. returns -1 if it can't be
+int chip8_cache_t_open(struct chip8_cache_t *cache, const char *dir);
+
+// returns 0 and fills result if key is in the cache, -1 if not
+int chip8_cache_t_get(struct chip8_cache_t *cache, const struct chip8_cache_key_t *key,
+                      struct chip8_case_result_t *result);
+
+// returns -1 if it can't be written
+int chip8_cache_t_put(struct chip8_cache_t *cache, const struct chip8_cache_key_t *key,
+                      const struct chip8_case_result_t *result);
+
+#endif
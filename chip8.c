@@ -0,0 +1,563 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "heatmap.h"
+
+const uint8_t FONTSET[FONTSET_NB] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+void chip8_t_init(union chip8_t *c8)
+{
+    // clear memory
+    // here is why I like C unions.
+    // instead of initializing each struct member, we can
+    // just set all the memory to zero!
+    memset(c8->memory, 0, MEM_NB);
+    // load font set
+    memcpy(c8->fontset, FONTSET, FONTSET_NB);
+    // initialize PC
+    c8->PC = PROG_START;
+    c8->rng = RNG_SEED;
+}
+
+long chip8_t_load_rom(union chip8_t *c8, const char *path)
+{
+    FILE *rom = fopen(path, "rb");
+    if (rom == NULL)
+    {
+        return -1;
+    }
+    size_t size = fread(c8->memory + PROG_START, sizeof(uint8_t), (MEM_NB - PROG_START), rom);
+    fclose(rom);
+    return (long)size;
+}
+
+void chip8_t_draw(union chip8_t *c8, uint8_t x, uint8_t y, const uint8_t *sprite, uint8_t n)
+{
+    // init VF to zero, then check for collision
+    c8->V[0xF] = 0;
+
+    size_t startCol = c8->V[x];
+    size_t startRow = c8->V[y];
+
+    // read each byte
+    for (size_t offsetRow = 0; offsetRow < n; offsetRow++)
+    {
+        uint8_t nthByte = sprite[offsetRow];
+        size_t pxRow = (startRow + offsetRow) % 32;
+
+        // read each bit (pixel)
+        for (size_t offsetCol = 0; offsetCol < 8; offsetCol++)
+        {
+            // get the offsetCol'th bit from the left end of this byte
+            size_t byteShamt = 7 - offsetCol;
+            int bytePxVal = (nthByte & (1 << byteShamt)) >> byteShamt;
+
+            size_t pxCol = (startCol + offsetCol) % 64;
+
+            // bit array indices
+            size_t bitIndex = (pxRow * 64) + pxCol;
+            size_t byteIndex = bitIndex / 8;
+            size_t dispShamt = 7 - (bitIndex % 8);
+
+            // get the value of the bit in the display bit array
+            // xor the display
+            uint8_t originalPxVal = ((c8->display[byteIndex]) & (1 << dispShamt)) >> dispShamt;
+            uint8_t newPxVal = originalPxVal ^ bytePxVal;
+
+            // set the new value
+            c8->display[byteIndex] ^= ((bytePxVal) << dispShamt);
+
+            // update VF
+            c8->V[0xF] = c8->V[0xF] | ((originalPxVal && (!newPxVal)) ? 1 : 0);
+        }
+    }
+
+    c8->draw_flag = 1;
+}
+
+void chip8_t_execute(union chip8_t *c8, struct chip8_insn_t in)
+{
+    const uint8_t op = in.op;
+    const uint8_t x = in.x;
+    const uint8_t y = in.y;
+    const uint16_t nnn = in.nnn;
+    const uint8_t kk = in.kk;
+    const uint8_t n = in.n;
+
+    CHIP8_HEAT(HEATMAP_EXECUTE, c8->PC, 2);
+
+    // execute instruction
+    // The original implementation of the Chip-8 language includes 36
+    // different instructions, including math, graphics, and flow control
+    // functions.
+
+    if (op == 0)
+    {
+        // 00E0 - CLS
+        if (n == 0x0)
+        {
+            // Clear the display.
+            memset(c8->display, 0, 32 * 64 / 8);
+            c8->draw_flag = 1;
+            c8->PC += 2;
+        }
+        // 00EE - RET
+        else if (n == 0xE)
+        {
+            // Return from a subroutine.
+            // The interpreter sets the program counter to the address at
+            // the top of the stack, then subtracts 1 from the stack pointer.
+            c8->SP -= 1;
+            c8->PC = c8->stack[c8->SP];
+            c8->PC += 2;
+        }
+    }
+    // 1nnn - JP addr
+    else if (op == 0x1)
+    {
+        // Jump to location nnn.
+        // The interpreter sets the program counter to nnn.
+        c8->PC = nnn;
+    }
+    // 2nnn - CALL addr
+    else if (op == 0x2)
+    {
+        // Call subroutine at nnn.
+        // The interpreter increments the stack pointer, then puts
+        // the current PC on the top of the stack.
+        // The PC is then set to nnn.
+        // SP isn't bounded, so deep enough the slot lands in program
+        // memory and has to count as a write to it like Fx33/Fx55 do
+        const uint16_t slot = offsetof(union chip8_t, stack) + 2 * c8->SP;
+        if (slot >= PROG_START)
+        {
+            c8->dirty_pages |= chip8_page_mask(slot, 2);
+            CHIP8_HEAT(HEATMAP_WRITE, slot, 2);
+        }
+        c8->stack[c8->SP] = c8->PC;
+        c8->SP += 1;
+        c8->PC = nnn;
+    }
+    // 3xkk - SE Vx, byte
+    else if (op == 0x3)
+    {
+        // Skip next instruction if Vx = kk.
+        // The interpreter compares register Vx to kk, and if they are equal,
+        // increments the program counter by 2.
+        c8->PC += (c8->V[x] == kk) ? 4 : 2;
+    }
+    // 4xkk - SNE Vx, byte
+    else if (op == 0x4)
+    {
+        // Skip next instruction if Vx != kk.
+        // The interpreter compares register Vx to kk, and if they
+        // are not equal, increments the program counter by 2.
+        c8->PC += (c8->V[x] != kk) ? 4 : 2;
+    }
+    // 5xy0 - SE Vx, Vy
+    else if (op == 0x5)
+    {
+        // Skip next instruction if Vx = Vy.
+        // The interpreter compares register Vx to register Vy, and if they
+        // are equal, increments the program counter by 2.
+        c8->PC += (c8->V[x] == c8->V[y]) ? 4 : 2;
+    }
+    // 6xkk - LD Vx, byte
+    else if (op == 0x6)
+    {
+        // Set Vx = kk.
+        // The interpreter puts the value kk into register Vx.
+        c8->V[x] = kk;
+        c8->PC += 2;
+    }
+    // 7xkk - ADD Vx, byte
+    else if (op == 0x7)
+    {
+        // Set Vx = Vx + kk.
+        // Adds the value kk to the value of register Vx,
+        // then stores the result in Vx.
+        c8->V[x] += kk;
+        c8->PC += 2;
+    }
+    else if (op == 0x8)
+    {
+        // 8xy0 - LD Vx, Vy
+        if (n == 0x0)
+        {
+            // Set Vx = Vy.
+            // Stores the value of register Vy in register Vx.
+            c8->V[x] = c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy1 - OR Vx, Vy
+        else if (n == 0x1)
+        {
+            // Set Vx = Vx OR Vy.
+            // Performs a bitwise OR on the values of Vx and Vy, then stores
+            // the result in Vx.
+            // A bitwise OR compares the corresponding bits from two values,
+            // and if either bit is 1, then the same bit in the result is
+            // also 1.
+            // Otherwise, it is 0.
+            c8->V[x] |= c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy2 - AND Vx, Vy
+        else if (n == 0x2)
+        {
+            // Set Vx = Vx AND Vy.
+            // Performs a bitwise AND on the values of Vx and Vy, then stores
+            // the result in Vx.
+            // A bitwise AND compares the corresponding bits from two values,
+            // and if both bits are 1, then the same bit in the result is
+            // also 1.
+            // Otherwise, it is 0.
+            c8->V[x] &= c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy3 - XOR Vx, Vy
+        else if (n == 0x3)
+        {
+            // Set Vx = Vx XOR Vy.
+            // Performs a bitwise exclusive OR on the values of Vx and Vy,
+            // then stores the result in Vx.
+            // An exclusive OR compares the corresponding bits from two values,
+            // and if the bits are not both the same, then the corresponding
+            // bit in the result is set to 1.
+            // Otherwise, it is 0.
+            c8->V[x] ^= c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy4 - ADD Vx, Vy
+        else if (n == 0x4)
+        {
+            // Set Vx = Vx + Vy, set VF = carry.
+            // The values of Vx and Vy are added together.
+            // If the result is greater than 8 bits (i.e., > 255,) VF is
+            // set to 1, otherwise 0.
+            // Only the lowest 8 bits of the result are kept, and stored in Vx.
+
+            c8->V[0xF] = (c8->V[x] + c8->V[y] > 255) ? 1 : 0;
+            c8->V[x] += c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy5 - SUB Vx, Vy
+        else if (n == 0x5)
+        {
+            // Set Vx = Vx - Vy, set VF = NOT borrow.
+            // If Vx > Vy, then VF is set to 1, otherwise 0.
+            // Then Vy is subtracted from Vx, and the results stored in Vx.
+            c8->V[0xF] = (c8->V[x] > c8->V[y]) ? 1 : 0;
+            c8->V[x] -= c8->V[y];
+            c8->PC += 2;
+        }
+        // 8xy6 - SHR Vx {, Vy}
+        else if (n == 0x6)
+        {
+            // Set Vx = Vx SHR 1.
+            // If the least-significant bit of Vx is 1, then VF is set to 1,
+            // otherwise 0.
+            // Then Vx is divided by 2.
+            c8->V[0xF] = c8->V[x] & 1;
+            c8->V[x] >>= 1;
+            c8->PC += 2;
+        }
+        // 8xy7 - SUBN Vx, Vy
+        else if (n == 0x7)
+        {
+            // Set Vx = Vy - Vx, set VF = NOT borrow.
+            // If Vy > Vx, then VF is set to 1, otherwise 0.
+            // Then Vx is subtracted from Vy, and the results stored in Vx.
+            c8->V[0xF] = ((c8->V[y]) > (c8->V[x])) ? 1 : 0;
+            c8->V[x] = (c8->V[y]) - (c8->V[x]);
+            c8->PC += 2;
+        }
+        // 8xyE - SHL Vx {, Vy}
+        else if (n == 0xE)
+        {
+            // Set Vx = Vx SHL 1.
+            // If the most-significant bit of Vx is 1, then VF is set to 1,
+            // otherwise to 0.
+            // Then Vx is multiplied by 2.
+            c8->V[0xF] = (c8->V[x] >> 7);
+            c8->V[x] <<= 1;
+            c8->PC += 2;
+        }
+    }
+    // 9xy0 - SNE Vx, Vy
+    else if (op == 0x9)
+    {
+        // Skip next instruction if Vx != Vy.
+        // The values of Vx and Vy are compared, and if they are not equal,
+        // the program counter is increased by 2.
+        c8->PC += (c8->V[x] != c8->V[y]) ? 4 : 2;
+    }
+    // Annn - LD I, addr
+    else if (op == 0xA)
+    {
+        // Set I = nnn.
+        // The value of register I is set to nnn.
+        c8->I = nnn;
+        c8->PC += 2;
+    }
+    // Bnnn - JP V0, addr
+    else if (op == 0xB)
+    {
+        // Jump to location nnn + V0.
+        // The program counter is set to nnn plus the value of V0.
+        c8->PC = nnn + c8->V[0];
+    }
+    // Cxkk - RND Vx, byte
+    else if (op == 0xC)
+    {
+        // Set Vx = random byte AND kk.
+        // The interpreter generates a random number from 0 to 255,
+        // which is then ANDed with the value kk.
+        // The results are stored in Vx.
+        // See instruction 8xy2 for more information on AND.
+        c8->V[x] = (chip8_t_random(c8) & kk);
+        c8->PC += 2;
+    }
+    // Dxyn - DRW Vx, Vy, nibble
+    else if (op == 0xD)
+    {
+        // Display n-byte sprite starting at memory location I at (Vx, Vy),
+        // set VF = collision.
+        // The interpreter reads n bytes from memory,
+        // starting at the address stored in I.
+        // These bytes are then displayed as sprites
+        // on screen at coordinates (Vx, Vy).
+        // Sprites are XORed onto the existing screen.
+        // If this causes any pixels to be erased, VF is set to 1,
+        // otherwise it is set to 0.
+        // If the sprite is positioned so part of it is outside the
+        // coordinates of the display, it wraps around to the opposite
+        // side of the screen.
+        // See instruction 8xy3 for more information on XOR, and
+        // section 2.4, Display,
+        // for more information on the Chip-8 screen and sprites.
+
+        // NOTE: look for errors here first
+
+        CHIP8_HEAT(HEATMAP_READ, c8->I, n);
+        chip8_t_draw(c8, x, y, c8->memory + c8->I, n);
+        c8->PC += 2;
+    }
+    else if (op == 0xE)
+    {
+        // Ex9E - SKP Vx
+        if (kk == 0x9E)
+        {
+            // Skip next instruction if key with the value of Vx is pressed.
+            // Checks the keyboard, and if the key corresponding to
+            // the value of Vx is currently in the down position,
+            // PC is increased by 2.
+            c8->PC += (c8->keys[c8->V[x]]) ? 4 : 2;
+        }
+        // ExA1 - SKNP Vx
+        else if (kk == 0xA1)
+        {
+            // Skip next instruction if key with the val of Vx is not pressed.
+            // Checks the keyboard, and if the key corresponding to
+            // the value of Vx is currently in the up position,
+            // PC is increased by 2.
+            c8->PC += (!c8->keys[c8->V[x]]) ? 4 : 2;
+        }
+    }
+    else if (op == 0xF)
+    {
+        // Fx07 - LD Vx, DT
+        if (kk == 0x07)
+        {
+            // Set Vx = delay timer value.
+            // The value of DT is placed into Vx.
+            c8->V[x] = c8->DT;
+            c8->PC += 2;
+        }
+        // Fx0A - LD Vx, K
+        else if (kk == 0x0A)
+        {
+            // Wait for a key press, store the value of the key in Vx.
+            // All execution stops until a key is pressed, then the value of that key is stored in Vx.
+
+            // check if a key was pressed, and if not,
+            // then perform this instruction again
+            uint8_t keyPressed = 0;
+            for (size_t i = 0; i < 16; i++)
+            {
+                keyPressed = keyPressed || c8->keys[i];
+                c8->V[x] = keyPressed ? i : (c8->V[x]);
+            }
+
+            // don't increment PC if key not pressed
+            if (!keyPressed)
+            {
+                return;
+            }
+
+            c8->PC += 2;
+        }
+        // Fx15 - LD DT, Vx
+        else if (kk == 0x15)
+        {
+            // Set delay timer = Vx.
+            // DT is set equal to the value of Vx.
+            c8->DT = c8->V[x];
+            c8->PC += 2;
+        }
+        // Fx18 - LD ST, Vx
+        else if (kk == 0x18)
+        {
+            // Set sound timer = Vx.
+            // ST is set equal to the value of Vx.
+            c8->ST = c8->V[x];
+            c8->PC += 2;
+        }
+        // Fx1E - ADD I, Vx
+        else if (kk == 0x1E)
+        {
+            // Set I = I + Vx.
+            // The values of I and Vx are added,
+            // and the results are stored in I.
+            // VF is set to 1 when range overflow (I+VX>0xFFF),
+            // and 0 when it isn't
+            c8->V[0xF] = (c8->I + c8->V[x]) > 0xFFF;
+            c8->I += c8->V[x];
+            c8->PC += 2;
+        }
+        else if (kk == 0x29)
+        {
+            // Fx29 - LD F, Vx
+            // Set I = location of sprite for digit Vx.
+            // The value of I is set to the location for
+            // the hexadecimal sprite corresponding to the value of Vx.
+            // See section 2.4, Display, for more information on
+            // the Chip-8 hexadecimal font.
+            c8->I = 5 * c8->V[x];
+            c8->PC += 2;
+        }
+        // Fx33 - LD B, Vx
+        else if (kk == 0x33)
+        {
+            // Store BCD representation of Vx in memory
+            // locations I, I+1, and I+2.
+            // The interpreter takes the decimal value of Vx,
+            // and places the hundreds digit in memory at location in I,
+            // the tens digit at location I+1, and the ones digit at
+            // location I+2.
+            CHIP8_HEAT(HEATMAP_WRITE, c8->I, 3);
+            c8->memory[c8->I] = c8->V[x] / 100;
+            c8->memory[c8->I + 1] = (c8->V[x] / 10) % 10;
+            c8->memory[c8->I + 2] = c8->V[x] % 10;
+            c8->dirty_pages |= chip8_page_mask(c8->I, 3);
+            c8->PC += 2;
+        }
+        // Fx55 - LD [I], Vx
+        else if (kk == 0x55)
+        {
+            // Store registers V0 through Vx in memory starting at location I.
+            // The interpreter copies the values of registers V0 through Vx
+            // into memory, starting at the address in I.
+            CHIP8_HEAT(HEATMAP_WRITE, c8->I, x + 1);
+            memcpy(c8->memory + c8->I, c8->V, x + 1);
+            c8->dirty_pages |= chip8_page_mask(c8->I, x + 1);
+            // according to Griffin, the interpreter also incremented I
+            // by x + 1 after this instruction
+            c8->I += x + 1;
+            c8->PC += 2;
+        }
+        // Fx65 - LD Vx, [I]
+        else if (kk == 0x65)
+        {
+            // Read registers V0 through Vx from memory starting at location I.
+            // The interpreter reads values from memory starting at location I
+            // into registers V0 through Vx.
+            CHIP8_HEAT(HEATMAP_READ, c8->I, x + 1);
+            memcpy(c8->V, ((c8->memory) + (c8->I)), x + 1);
+            // according to Griffin, the interpreter also incremented I
+            // by x + 1 after this instruction
+            c8->I += x + 1;
+            c8->PC += 2;
+        }
+    }
+
+    chip8_t_update_timers(c8);
+}
+
+void chip8_t_emulate_cycle(union chip8_t *c8)
+{
+    // instructions are two bytes long
+    const uint16_t instruction = (c8->memory[c8->PC] << 8) | c8->memory[c8->PC + 1];
+    chip8_t_execute(c8, chip8_insn_t_decode(instruction));
+}
+
+void chip8_t_run_frames(union chip8_t *c8, size_t frames)
+{
+    for (size_t i = 0; i < frames * CYCLES_PER_FRAME; i++)
+    {
+        chip8_t_emulate_cycle(c8);
+    }
+}
+
+uint64_t chip8_hash(const void *data, size_t len)
+{
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// murmur3's finalizer
+static inline uint64_t fmix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void chip8_hash128(const void *data, size_t len, uint64_t out[2])
+{
+    const uint8_t *p = data;
+    uint64_t a = 0x9E3779B97F4A7C15ULL;
+    uint64_t b = 0xC2B2AE3D27D4EB4FULL ^ len;
+    for (size_t i = 0; i < len; i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        memcpy(&w, p + i, sizeof(w));
+        a = rotl((a ^ w) * 0x87C37B91114253D5ULL, 31);
+        b = rotl((b + w) * 0x4CF5AD432745937FULL, 29) ^ a;
+    }
+    out[0] = fmix(a ^ fmix(b));
+    out[1] = fmix(b + out[0]);
+}
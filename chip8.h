@@ -0,0 +1,178 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum constants
+{
+    MEM_NB = 4096,
+    FONTSET_NB = 80,
+    PROG_START = 0x200,
+
+    // the timers tick once per cycle and the frontend runs about 600 cycles
+    // a second, so a 60 Hz frame is 10 cycles
+    CYCLES_PER_FRAME = 10,
+
+    // any non-zero seed will do, a fixed one keeps runs reproducible
+    RNG_SEED = 0x2545F491,
+
+    // memory is split into 16 pages of 256 bytes when it is shared
+    // between instances (see cow.h)
+    PAGE_SIZE = 256,
+    PAGE_NB = MEM_NB / PAGE_SIZE
+};
+
+union chip8_t
+{
+    uint8_t memory[MEM_NB];
+    struct
+    {
+        // first 80 bytes reserved for fontset
+        uint8_t fontset[FONTSET_NB];
+
+        uint8_t V[16]; // registers
+        uint8_t DT;    // delay timer
+        uint8_t ST;    // sound timer
+        uint8_t SP;    // stack pointer
+
+        uint16_t PC;        // program counter
+        uint16_t I;         // I register
+        uint16_t stack[16]; // call stack
+
+        // 32 x 64 = 2048 bit (256 byte) screen
+        // we emulate this via a bit array to save memory
+        uint8_t display[32 * 64 / 8];
+
+        // whether to draw the screen
+        // not a part of chip 8 but reduces emulator flickering
+        uint8_t draw_flag;
+
+        // represents whether a key is pressed
+        // TODO: use a single uint_16 here as a bit array
+        // to save space
+        uint8_t keys[16];
+
+        // bitmap of the 256 byte pages written by Fx33 or Fx55.
+        // lets shared predecoded code (see predecode.h) fall back to
+        // decoding from memory once an instance modifies itself
+        uint16_t dirty_pages;
+
+        // state of the random number generator used by Cxkk.
+        // it lives in the instance so that restoring a saved state
+        // replays exactly the same frames
+        uint32_t rng;
+
+        // in this implementation, the interpreter uses
+        // 80 + 16 + 1 + 1 + 1 + 2 + 2 + 32 + 256 + 1 + 16 + 2 + 4 = 414 bytes.
+        // this is less than the program start (0x200 = 512), so
+        // it's safe to manipulate this part of the chip 8's memory
+    };
+};
+
+// a decoded instruction.
+// every field the interpreter might need is extracted up front so
+// the same decode can be shared by all the ways of executing it
+struct chip8_insn_t
+{
+    uint16_t instruction;
+    uint16_t nnn;
+    uint8_t op;
+    uint8_t x;
+    uint8_t y;
+    uint8_t kk;
+    uint8_t n;
+};
+
+extern const uint8_t FONTSET[FONTSET_NB];
+
+static inline struct chip8_insn_t chip8_insn_t_decode(uint16_t instruction)
+{
+    struct chip8_insn_t in;
+    in.instruction = instruction;
+    in.op = (instruction & 0xF000) >> 12;
+    in.x = (instruction & 0x0F00) >> 8;
+    in.y = (instruction & 0x00F0) >> 4;
+    in.nnn = instruction & 0x0FFF;
+    in.kk = instruction & 0x00FF;
+    in.n = instruction & 0x000F;
+    return in;
+}
+
+// bits of dirty_pages covering the len bytes starting at addr
+static inline uint16_t chip8_page_mask(uint16_t addr, uint16_t len)
+{
+    const uint16_t first = (addr >> 8) & (PAGE_NB - 1);
+    const uint16_t last = ((addr + len - 1) >> 8) & (PAGE_NB - 1);
+    return (1 << first) | (1 << last);
+}
+
+static inline void chip8_t_update_timers(union chip8_t *c8)
+{
+    if (c8->DT > 0)
+    {
+        c8->DT -= 1;
+    }
+    if (c8->ST > 0)
+    {
+        c8->ST -= 1;
+    }
+}
+
+// xorshift32, never returns to zero as long as it isn't seeded with zero
+static inline uint8_t chip8_t_random(union chip8_t *c8)
+{
+    uint32_t r = c8->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    c8->rng = r;
+    return r >> 24;
+}
+
+// the keypad as a bit mask, bit i is key i
+static inline uint16_t chip8_t_get_keys(const union chip8_t *c8)
+{
+    uint16_t mask = 0;
+    for (size_t i = 0; i < 16; i++)
+    {
+        mask |= (c8->keys[i] != 0) << i;
+    }
+    return mask;
+}
+
+static inline void chip8_t_set_keys(union chip8_t *c8, uint16_t mask)
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        c8->keys[i] = (mask >> i) & 1;
+    }
+}
+
+// clear memory, load the fontset and point PC at the program start
+void chip8_t_init(union chip8_t *c8);
+
+// load a rom file at PROG_START.
+// returns the number of bytes read, or -1 if the file can't be opened
+long chip8_t_load_rom(union chip8_t *c8, const char *path);
+
+// xor an n-byte sprite onto the display at (Vx, Vy) and set VF on collision
+void chip8_t_draw(union chip8_t *c8, uint8_t x, uint8_t y, const uint8_t *sprite, uint8_t n);
+
+// execute an already decoded instruction and update the timers
+void chip8_t_execute(union chip8_t *c8, struct chip8_insn_t in);
+
+// fetch, decode and execute the instruction at PC
+void chip8_t_emulate_cycle(union chip8_t *c8);
+
+// run whole frames of CYCLES_PER_FRAME cycles
+void chip8_t_run_frames(union chip8_t *c8, size_t frames);
+
+// 64-bit FNV-1a, used to key anything shared between instances
+uint64_t chip8_hash(const void *data, size_t len);
+
+// 128-bit hash of whole 8 byte words, len has to be a multiple of 8.
+// several times faster than chip8_hash, for hashing states on hot paths
+void chip8_hash128(const void *data, size_t len, uint64_t out[2]);
+
+#endif
@@ -0,0 +1,35 @@
+#include "coverage.h"
+
+size_t chip8_coverage_t_count(const struct chip8_coverage_t *cov, enum coverage_kind kind)
+{
+    size_t nb = 0;
+    for (size_t i = 0; i < COVERAGE_WORDS; i++)
+    {
+        nb += __builtin_popcountll(cov->bits[kind][i]);
+    }
+    return nb;
+}
+
+size_t chip8_coverage_t_new(const struct chip8_coverage_t *seen, const struct chip8_coverage_t *cov)
+{
+    size_t nb = 0;
+    for (size_t k = 0; k < COVERAGE_KINDS; k++)
+    {
+        for (size_t i = 0; i < COVERAGE_WORDS; i++)
+        {
+            nb += __builtin_popcountll(cov->bits[k][i] & ~seen->bits[k][i]);
+        }
+    }
+    return nb;
+}
+
+void chip8_coverage_t_merge(struct chip8_coverage_t *dst, const struct chip8_coverage_t *cov)
+{
+    for (size_t k = 0; k < COVERAGE_KINDS; k++)
+    {
+        for (size_t i = 0; i < COVERAGE_WORDS; i++)
+        {
+            dst->bits[k][i] |= cov->bits[k][i];
+        }
+    }
+}
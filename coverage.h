@@ -0,0 +1,72 @@
+#ifndef CHIP8_COVERAGE_H
+#define CHIP8_COVERAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "predecode.h"
+
+enum coverage_constants
+{
+    COVERAGE_WORDS = MEM_NB / 64
+};
+
+enum coverage_kind
+{
+    COVERAGE_PC,          // executed
+    COVERAGE_SKIPPED,     // a skip that skipped
+    COVERAGE_NOT_SKIPPED, // a skip that didn't
+    COVERAGE_KINDS
+};
+
+// which addresses a rom executed, and for the skips (3xkk, 4xkk, 5xy0,
+// 9xy0, Ex9E and ExA1) at each address, which way they went.
+// a bit per address each, 1.5 KB in all
+struct chip8_coverage_t
+{
+    uint64_t bits[COVERAGE_KINDS][COVERAGE_WORDS];
+};
+
+static inline void chip8_coverage_t_set(struct chip8_coverage_t *cov, enum coverage_kind kind, uint16_t addr)
+{
+    cov->bits[kind][addr / 64] |= (uint64_t)1 << (addr % 64);
+}
+
+static inline int chip8_coverage_t_get(const struct chip8_coverage_t *cov, enum coverage_kind kind, uint16_t addr)
+{
+    return (cov->bits[kind][addr / 64] >> (addr % 64)) & 1;
+}
+
+// chip8_t_emulate_cycle_predecoded, marking the instruction it runs
+static inline void chip8_t_emulate_cycle_covered(union chip8_t *c8, const struct chip8_predecode_t *pd,
+                                                 struct chip8_coverage_t *cov)
+{
+    const uint16_t pc = c8->PC;
+    if (pc >= MEM_NB - 1)
+    {
+        chip8_t_emulate_cycle_predecoded(c8, pd);
+        return;
+    }
+
+    chip8_coverage_t_set(cov, COVERAGE_PC, pc);
+    const uint8_t op = c8->memory[pc] >> 4;
+    const uint8_t kk = c8->memory[pc + 1];
+    const int skip = op == 0x3 || op == 0x4 || op == 0x5 || op == 0x9 || (op == 0xE && (kk == 0x9E || kk == 0xA1));
+    chip8_t_emulate_cycle_predecoded(c8, pd);
+    if (skip)
+    {
+        chip8_coverage_t_set(cov, c8->PC == pc + 4 ? COVERAGE_SKIPPED : COVERAGE_NOT_SKIPPED, pc);
+    }
+}
+
+// number of addresses marked kind in cov
+size_t chip8_coverage_t_count(const struct chip8_coverage_t *cov, enum coverage_kind kind);
+
+// number of bits set in cov that aren't in seen
+size_t chip8_coverage_t_new(const struct chip8_coverage_t *seen, const struct chip8_coverage_t *cov);
+
+// add the bits of cov to dst
+void chip8_coverage_t_merge(struct chip8_coverage_t *dst, const struct chip8_coverage_t *cov);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cow.h"
+
+void chip8_cow_t_init(struct chip8_cow_t *cow, struct chip8_rom_t *rom)
+{
+    memset(cow->low, 0, PROG_START);
+    union chip8_t *c8 = chip8_cow_t_regs(cow);
+    memcpy(c8->fontset, FONTSET, FONTSET_NB);
+    c8->PC = PROG_START;
+    c8->rng = RNG_SEED;
+
+    cow->rom = chip8_rom_t_retain(rom);
+    cow->private_pages = 0;
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        // the rom image is never written through the page table,
+        // chip8_cow_t_write makes a private copy first
+        cow->pages[p] = rom->image + p * PAGE_SIZE;
+    }
+    for (size_t p = 0; p < PROG_START / PAGE_SIZE; p++)
+    {
+        cow->pages[p] = cow->low + p * PAGE_SIZE;
+        cow->private_pages |= 1 << p;
+    }
+}
+
+void chip8_cow_t_destroy(struct chip8_cow_t *cow)
+{
+    for (size_t p = PROG_START / PAGE_SIZE; p < PAGE_NB; p++)
+    {
+        if (cow->private_pages & (1 << p))
+        {
+            free(cow->pages[p]);
+        }
+    }
+    cow->private_pages = 0;
+    chip8_rom_t_release(cow->rom);
+    cow->rom = NULL;
+}
+
+void chip8_cow_t_write(struct chip8_cow_t *cow, uint16_t addr, uint8_t value)
+{
+    const size_t p = (addr >> 8) & (PAGE_NB - 1);
+
+    // first write to this page, give the instance its own copy
+    if (!(cow->private_pages & (1 << p)))
+    {
+        uint8_t *page = aligned_alloc(64, PAGE_SIZE);
+        if (page == NULL)
+        {
+            fprintf(stderr, "Could not allocate a private page\n");
+            exit(3);
+        }
+        memcpy(page, cow->pages[p], PAGE_SIZE);
+        cow->pages[p] = page;
+        cow->private_pages |= 1 << p;
+    }
+
+    cow->pages[p][addr & (PAGE_SIZE - 1)] = value;
+}
+
+// where stack[sp] is. SP isn't bounded, so deep enough the slot is past
+// the interpreter area and has to go through the page table
+static inline uint16_t stack_slot(uint8_t sp)
+{
+    return offsetof(union chip8_t, stack) + 2 * sp;
+}
+
+void chip8_cow_t_execute(struct chip8_cow_t *cow, struct chip8_insn_t in)
+{
+    union chip8_t *c8 = chip8_cow_t_regs(cow);
+
+    // only Dxyn, Fx33, Fx55 and Fx65 address memory through I, CALL and
+    // RET once the stack has grown into program memory, and Ex9E and ExA1
+    // with a Vx that indexes keys past it.
+    // everything else runs on the private interpreter area as is
+    if (in.op == 0x2 && stack_slot(c8->SP) >= PROG_START)
+    {
+        // 2nnn - CALL addr
+        const uint16_t slot = stack_slot(c8->SP);
+        uint8_t bytes[2];
+        memcpy(bytes, &c8->PC, sizeof(bytes));
+        chip8_cow_t_write(cow, slot, bytes[0]);
+        chip8_cow_t_write(cow, slot + 1, bytes[1]);
+        c8->dirty_pages |= chip8_page_mask(slot, 2);
+        c8->SP += 1;
+        c8->PC = in.nnn;
+    }
+    else if (in.op == 0x0 && in.n == 0xE && stack_slot(c8->SP - 1) >= PROG_START)
+    {
+        // 00EE - RET
+        c8->SP -= 1;
+        const uint16_t slot = stack_slot(c8->SP);
+        const uint8_t bytes[2] = {chip8_cow_t_read(cow, slot), chip8_cow_t_read(cow, slot + 1)};
+        memcpy(&c8->PC, bytes, sizeof(bytes));
+        c8->PC += 2;
+    }
+    else if (in.op == 0xE && (in.kk == 0x9E || in.kk == 0xA1) &&
+             offsetof(union chip8_t, keys) + c8->V[in.x] >= PROG_START)
+    {
+        // Ex9E - SKP Vx, ExA1 - SKNP Vx
+        const uint8_t pressed = chip8_cow_t_read(cow, offsetof(union chip8_t, keys) + c8->V[in.x]);
+        c8->PC += (in.kk == 0x9E ? pressed : !pressed) ? 4 : 2;
+    }
+    else if (in.op == 0xD)
+    {
+        // Dxyn - DRW Vx, Vy, nibble
+        // the sprite may cross a page, so gather it first
+        uint8_t sprite[16];
+        for (size_t i = 0; i < in.n; i++)
+        {
+            sprite[i] = chip8_cow_t_read(cow, c8->I + i);
+        }
+        chip8_t_draw(c8, in.x, in.y, sprite, in.n);
+        c8->PC += 2;
+    }
+    else if (in.op == 0xF && in.kk == 0x33)
+    {
+        // Fx33 - LD B, Vx
+        chip8_cow_t_write(cow, c8->I, c8->V[in.x] / 100);
+        chip8_cow_t_write(cow, c8->I + 1, (c8->V[in.x] / 10) % 10);
+        chip8_cow_t_write(cow, c8->I + 2, c8->V[in.x] % 10);
+        c8->PC += 2;
+    }
+    else if (in.op == 0xF && in.kk == 0x55)
+    {
+        // Fx55 - LD [I], Vx
+        for (size_t i = 0; i <= in.x; i++)
+        {
+            chip8_cow_t_write(cow, c8->I + i, c8->V[i]);
+        }
+        c8->I += in.x + 1;
+        c8->PC += 2;
+    }
+    else if (in.op == 0xF && in.kk == 0x65)
+    {
+        // Fx65 - LD Vx, [I]
+        for (size_t i = 0; i <= in.x; i++)
+        {
+            c8->V[i] = chip8_cow_t_read(cow, c8->I + i);
+        }
+        c8->I += in.x + 1;
+        c8->PC += 2;
+    }
+    else
+    {
+        chip8_t_execute(c8, in);
+        return;
+    }
+
+    chip8_t_update_timers(c8);
+}
+
+void chip8_cow_t_emulate_cycle(struct chip8_cow_t *cow)
+{
+    const uint16_t pc = chip8_cow_t_regs(cow)->PC;
+
+    // instructions are two bytes long
+    const uint16_t instruction = (chip8_cow_t_read(cow, pc) << 8) | chip8_cow_t_read(cow, pc + 1);
+    chip8_cow_t_execute(cow, chip8_insn_t_decode(instruction));
+}
+
+void chip8_cow_t_flatten(const struct chip8_cow_t *cow, union chip8_t *c8)
+{
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        memcpy(c8->memory + p * PAGE_SIZE, cow->pages[p], PAGE_SIZE);
+    }
+}
+
+size_t chip8_cow_t_footprint(const struct chip8_cow_t *cow)
+{
+    size_t shared = 0;
+    for (size_t p = PROG_START / PAGE_SIZE; p < PAGE_NB; p++)
+    {
+        shared += (cow->private_pages & (1 << p)) ? 0 : PAGE_SIZE;
+    }
+    return sizeof(struct chip8_cow_t) + (MEM_NB - PROG_START) - shared;
+}
@@ -0,0 +1,63 @@
+#ifndef CHIP8_COW_H
+#define CHIP8_COW_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "rom.h"
+
+// an instance whose program memory is shared with every other instance
+// running the same rom.
+// most roms never write to 0x200-0xFFF, so instead of a private 4 KB
+// copy each instance maps the shared image page by page and only gets
+// a private 256 byte page the first time Fx33 or Fx55 writes to it
+struct chip8_cow_t
+{
+    // the private interpreter area (0x000-0x1FF).
+    // it has the same layout as the start of union chip8_t, so the core
+    // can run every instruction that doesn't touch rom memory directly on it
+    _Alignas(64) uint8_t low[PROG_START];
+
+    struct chip8_rom_t *rom;
+
+    // write bitmap, bit p is set once page p is private to this instance.
+    // pages 0 and 1 (the interpreter area) are always private
+    uint16_t private_pages;
+
+    // page table, every entry is either a page of rom->image
+    // or this instance's private copy of it
+    uint8_t *pages[PAGE_NB];
+};
+
+// reset the instance and map every page of rom. takes a reference to rom
+void chip8_cow_t_init(struct chip8_cow_t *cow, struct chip8_rom_t *rom);
+
+// free the private pages and drop the reference to the rom
+void chip8_cow_t_destroy(struct chip8_cow_t *cow);
+
+// the registers, display and keys of the instance
+static inline union chip8_t *chip8_cow_t_regs(struct chip8_cow_t *cow)
+{
+    return (union chip8_t *)cow->low;
+}
+
+static inline uint8_t chip8_cow_t_read(const struct chip8_cow_t *cow, uint16_t addr)
+{
+    return cow->pages[(addr >> 8) & (PAGE_NB - 1)][addr & (PAGE_SIZE - 1)];
+}
+
+void chip8_cow_t_write(struct chip8_cow_t *cow, uint16_t addr, uint8_t value);
+
+// execute an already decoded instruction and update the timers
+void chip8_cow_t_execute(struct chip8_cow_t *cow, struct chip8_insn_t in);
+
+// fetch, decode and execute the instruction at PC
+void chip8_cow_t_emulate_cycle(struct chip8_cow_t *cow);
+
+// copy the instance into a flat chip8_t, e.g. for a savestate
+void chip8_cow_t_flatten(const struct chip8_cow_t *cow, union chip8_t *c8);
+
+// number of bytes this instance holds privately
+size_t chip8_cow_t_footprint(const struct chip8_cow_t *cow);
+
+#endif
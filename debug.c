@@ -0,0 +1,231 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "rom.h"
+#include "undo.h"
+
+// interactive debugger with reverse execution, reads commands from stdin:
+//   step [N]        run N instructions (default 1)
+//   back [N]        undo N instructions (default 1)
+//   cont [N]        run until a breakpoint or a watched byte changes,
+//                   at most N instructions (default 10000000)
+//   rcont           the same, backwards, as far as the history goes
+//   goto CYCLE      go back to an earlier cycle
+//   break ADDR      toggle a breakpoint on PC == ADDR
+//   watch ADDR      toggle stopping when the byte at ADDR changes
+//   keys MASK       hold the keys in MASK
+//   regs            print the registers
+//   mem ADDR [N]    print N bytes of memory (default 16)
+//   quit
+
+enum debug_constants
+{
+    WATCH_NB = 16,
+    CONT_NB = 10000000
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-debug [--history SEGMENTS] ROM\n");
+    exit(1);
+}
+
+static uint8_t breaks[MEM_NB];
+static uint16_t watches[WATCH_NB];
+static size_t watches_nb;
+
+// whether to stop after moving from before to c8
+static int stop(const union chip8_t *before, const union chip8_t *c8)
+{
+    if (breaks[c8->PC & (MEM_NB - 1)])
+    {
+        printf("breakpoint\n");
+        return 1;
+    }
+    for (size_t i = 0; i < watches_nb; i++)
+    {
+        if (before->memory[watches[i]] != c8->memory[watches[i]])
+        {
+            printf("0x%03X: %u -> %u\n", watches[i], before->memory[watches[i]], c8->memory[watches[i]]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void toggle_watch(uint16_t addr)
+{
+    for (size_t i = 0; i < watches_nb; i++)
+    {
+        if (watches[i] == addr)
+        {
+            watches[i] = watches[--watches_nb];
+            return;
+        }
+    }
+    if (watches_nb < WATCH_NB)
+    {
+        watches[watches_nb++] = addr;
+    }
+}
+
+static void where(const struct chip8_undo_t *u, const union chip8_t *c8)
+{
+    printf("cycle %llu PC=0x%03X %02X%02X\n", (unsigned long long)u->cycle, c8->PC, c8->memory[c8->PC & (MEM_NB - 1)],
+           c8->memory[(c8->PC + 1) & (MEM_NB - 1)]);
+}
+
+int main(int argc, char const *argv[])
+{
+    long history = 256;
+    const char *rom_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            history = strtol(argv[++i], NULL, 10);
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || history < 1)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    if (rom == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    static struct chip8_undo_t u;
+    if (chip8_undo_t_init(&u, history) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    union chip8_t c8;
+    chip8_rom_t_boot(rom, &c8);
+    chip8_undo_t_clear(&u, &c8);
+    where(&u, &c8);
+
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char cmd[16];
+        long a = -1;
+        long b = -1;
+        if (sscanf(line, "%15s %li %li", cmd, &a, &b) < 1)
+        {
+            continue;
+        }
+
+        union chip8_t before;
+        if (strcmp(cmd, "step") == 0 || strcmp(cmd, "cont") == 0)
+        {
+            const int cont = cmd[0] == 'c';
+            const long n = a >= 0 ? a : cont ? CONT_NB : 1;
+            for (long i = 0; i < n; i++)
+            {
+                memcpy(&before, &c8, sizeof(c8));
+                if (chip8_undo_t_step(&u, &c8) < 0)
+                {
+                    printf("out of memory\n");
+                    break;
+                }
+                if (cont && stop(&before, &c8))
+                {
+                    break;
+                }
+            }
+            where(&u, &c8);
+        }
+        else if (strcmp(cmd, "back") == 0 || strcmp(cmd, "rcont") == 0)
+        {
+            const int cont = cmd[0] == 'r';
+            const long n = cont ? -1 : a >= 0 ? a : 1;
+            for (long i = 0; i != n; i++)
+            {
+                memcpy(&before, &c8, sizeof(c8));
+                if (!chip8_undo_t_back(&u, &c8))
+                {
+                    printf("start of history\n");
+                    break;
+                }
+                if (cont && stop(&before, &c8))
+                {
+                    break;
+                }
+            }
+            where(&u, &c8);
+        }
+        else if (strcmp(cmd, "goto") == 0 && a >= 0)
+        {
+            if (chip8_undo_t_seek(&u, &c8, a) < 0)
+            {
+                printf("history covers cycles %llu to %llu\n", (unsigned long long)chip8_undo_t_oldest(&u),
+                       (unsigned long long)u.cycle);
+            }
+            where(&u, &c8);
+        }
+        else if (strcmp(cmd, "break") == 0 && a >= 0 && a < MEM_NB)
+        {
+            breaks[a] = !breaks[a];
+        }
+        else if (strcmp(cmd, "watch") == 0 && a >= 0 && a < MEM_NB)
+        {
+            toggle_watch(a);
+        }
+        else if (strcmp(cmd, "keys") == 0 && a >= 0)
+        {
+            chip8_t_set_keys(&c8, a);
+        }
+        else if (strcmp(cmd, "regs") == 0)
+        {
+            for (size_t i = 0; i < 16; i++)
+            {
+                printf("V%zX=%02X%c", i, c8.V[i], i == 7 || i == 15 ? '\n' : ' ');
+            }
+            printf("I=%03X DT=%02X ST=%02X SP=%02X\n", c8.I, c8.DT, c8.ST, c8.SP);
+            where(&u, &c8);
+        }
+        else if (strcmp(cmd, "mem") == 0 && a >= 0 && a < MEM_NB)
+        {
+            const long n = b > 0 ? b : 16;
+            for (long i = 0; i < n && a + i < MEM_NB; i++)
+            {
+                if (i % 16 == 0)
+                {
+                    printf("%s0x%03lX:", i ? "\n" : "", a + i);
+                }
+                printf(" %02X", c8.memory[a + i]);
+            }
+            printf("\n");
+        }
+        else if (strcmp(cmd, "quit") == 0)
+        {
+            break;
+        }
+        else
+        {
+            printf("?\n");
+        }
+        fflush(stdout);
+    }
+
+    chip8_undo_t_destroy(&u);
+    chip8_rom_t_release(rom);
+    return 0;
+}
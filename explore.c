@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "explore.h"
+
+static size_t pow2_at_least(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+    {
+        p *= 2;
+    }
+    return p;
+}
+
+// find or claim the slot for a hash. returns 1 if we claimed it, and the
+// caller has to publish it by storing hi, 0 if the hash was already there
+// and -1 if the set is full
+static int set_insert(struct chip8_explore_slot_t *set, size_t nb, uint64_t lo, uint64_t hi,
+                      struct chip8_explore_slot_t **found)
+{
+    // zero marks an empty slot or an unpublished hi
+    lo |= 1;
+    hi |= 1;
+    size_t i = lo & (nb - 1);
+    for (size_t probes = 0; probes < nb; probes++, i = (i + 1) & (nb - 1))
+    {
+        struct chip8_explore_slot_t *slot = set + i;
+        uint64_t cur = atomic_load_explicit(&slot->lo, memory_order_acquire);
+        if (cur == 0)
+        {
+            if (atomic_compare_exchange_strong_explicit(&slot->lo, &cur, lo, memory_order_acq_rel, memory_order_acquire))
+            {
+                *found = slot;
+                return 1;
+            }
+            // somebody else claimed it first, cur is now their lo
+        }
+        if (cur == lo)
+        {
+            // the owner is about to publish, this is only ever a few stores
+            uint64_t h;
+            while ((h = atomic_load_explicit(&slot->hi, memory_order_acquire)) == 0)
+            {
+            }
+            if (h == hi)
+            {
+                *found = slot;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+static void set_publish(struct chip8_explore_slot_t *slot, uint64_t hi, uint32_t id)
+{
+    atomic_store_explicit(&slot->id, id, memory_order_relaxed);
+    atomic_store_explicit(&slot->hi, hi | 1, memory_order_release);
+}
+
+// the id of a page, adding it to the store if it's new. UINT32_MAX if full
+static uint32_t intern_page(struct chip8_explore_t *ex, const uint8_t *page)
+{
+    uint64_t h[2];
+    chip8_hash128(page, PAGE_SIZE, h);
+
+    struct chip8_explore_slot_t *slot;
+    const int r = set_insert(ex->page_set, ex->page_set_nb, h[0], h[1], &slot);
+    if (r < 0)
+    {
+        return UINT32_MAX;
+    }
+    if (r == 0)
+    {
+        return atomic_load_explicit(&slot->id, memory_order_relaxed);
+    }
+
+    uint32_t id = atomic_fetch_add_explicit(&ex->pages_nb, 1, memory_order_relaxed);
+    if (id >= ex->pages_cap)
+    {
+        // still publish, so nobody spins on this slot forever
+        id = UINT32_MAX;
+    }
+    else
+    {
+        memcpy(ex->pages[id], page, PAGE_SIZE);
+    }
+    set_publish(slot, h[1], id);
+    return id;
+}
+
+// everything the host might change without affecting the machine is
+// cleared before hashing: held keys, draw_flag and dirty_pages
+static void canonicalize(union chip8_t *c8)
+{
+    memset(c8->keys, 0, sizeof(c8->keys));
+    c8->draw_flag = 0;
+    c8->dirty_pages = 0;
+}
+
+void chip8_explore_t_restore(const struct chip8_explore_t *ex, uint32_t state, union chip8_t *c8)
+{
+    const struct chip8_explore_state_t *s = ex->states + state;
+    uint16_t dirty = 0;
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        memcpy(c8->memory + p * PAGE_SIZE, ex->pages[s->pages[p]], PAGE_SIZE);
+        dirty |= (s->pages[p] != ex->rom_pages[p]) << p;
+    }
+    // the predecoded fetch has to know which pages differ from the rom
+    c8->dirty_pages = dirty;
+}
+
+// add a state, returns 1 if it's new, 0 if it was visited already and
+// -1 if there's no room left
+static int add_state(struct chip8_explore_t *ex, const struct chip8_explore_state_t *s)
+{
+    uint64_t h[2];
+    chip8_hash128(s->pages, sizeof(s->pages), h);
+
+    struct chip8_explore_slot_t *slot;
+    const int r = set_insert(ex->state_set, ex->state_set_nb, h[0], h[1], &slot);
+    if (r <= 0)
+    {
+        return r;
+    }
+
+    const uint32_t id = atomic_fetch_add_explicit(&ex->states_nb, 1, memory_order_relaxed);
+    if (id >= ex->states_cap)
+    {
+        set_publish(slot, h[1], UINT32_MAX);
+        return -1;
+    }
+    ex->states[id] = *s;
+    set_publish(slot, h[1], id);
+    return 1;
+}
+
+static void report(struct chip8_explore_t *ex, int violation, uint32_t parent, uint16_t keys, uint16_t pc)
+{
+    // keep the one that comes first in breadth first order, so the
+    // report doesn't depend on which thread got there first
+    pthread_mutex_lock(&ex->lock);
+    if (ex->violation == 0 || parent < ex->violation_parent ||
+        (parent == ex->violation_parent && keys < ex->violation_keys))
+    {
+        ex->violation = violation;
+        ex->violation_parent = parent;
+        ex->violation_keys = keys;
+        ex->violation_pc = pc;
+    }
+    pthread_mutex_unlock(&ex->lock);
+}
+
+// run one action from a restored state, checking every cycle
+static void expand(struct chip8_explore_t *ex, uint32_t parent, const union chip8_t *base, uint16_t keys)
+{
+    union chip8_t c8;
+    memcpy(&c8, base, sizeof(c8));
+    chip8_t_set_keys(&c8, keys);
+
+    for (size_t i = 0; i < ex->hold * CYCLES_PER_FRAME; i++)
+    {
+        const uint16_t pc = c8.PC;
+        chip8_t_emulate_cycle_predecoded(&c8, ex->pd);
+
+        // a call with a full stack leaves SP at 17, a return with an
+        // empty one wraps it around to 255
+        if (c8.SP > 16)
+        {
+            report(ex, c8.SP == 17 ? EXPLORE_OVERFLOW : EXPLORE_UNDERFLOW, parent, keys, pc);
+            return;
+        }
+        if (c8.PC < PROG_START || c8.PC > MEM_NB - 2)
+        {
+            report(ex, EXPLORE_BAD_PC, parent, keys, pc);
+            return;
+        }
+    }
+    if (ex->bad != NULL && chip8_watch_t_eval(ex->bad, &c8, (ex->depth + 1) * ex->hold))
+    {
+        report(ex, EXPLORE_BAD_WATCH, parent, keys, c8.PC);
+        return;
+    }
+
+    // only the interpreter area and pages that differ from the rom can
+    // be anything but the rom's own pages
+    const uint16_t dirty = c8.dirty_pages;
+    canonicalize(&c8);
+
+    struct chip8_explore_state_t s;
+    s.parent = parent;
+    s.keys = keys;
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        s.pages[p] = (p < PROG_START / PAGE_SIZE || (dirty & (1 << p))) ? intern_page(ex, c8.memory + p * PAGE_SIZE)
+                                                                         : ex->rom_pages[p];
+        if (s.pages[p] == UINT32_MAX)
+        {
+            atomic_store_explicit(&ex->full, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    if (add_state(ex, &s) < 0)
+    {
+        atomic_store_explicit(&ex->full, 1, memory_order_relaxed);
+    }
+}
+
+static void *explore_thread(void *arg)
+{
+    struct chip8_explore_t *ex = arg;
+    union chip8_t base;
+
+    size_t state;
+    while ((state = atomic_fetch_add_explicit(&ex->next, 1, memory_order_relaxed)) < ex->level_last &&
+           !atomic_load_explicit(&ex->full, memory_order_relaxed))
+    {
+        chip8_explore_t_restore(ex, state, &base);
+        for (size_t a = 0; a < ex->actions_nb; a++)
+        {
+            expand(ex, state, &base, ex->actions[a]);
+        }
+    }
+    return NULL;
+}
+
+int chip8_explore_t_init(struct chip8_explore_t *ex, const struct chip8_rom_t *rom, const struct chip8_predecode_t *pd,
+                         const struct chip8_watch_t *bad, const uint16_t *actions, size_t actions_nb, size_t hold,
+                         size_t max_states)
+{
+    memset(ex, 0, sizeof(*ex));
+    ex->rom = rom;
+    ex->pd = pd;
+    ex->bad = bad;
+    ex->actions = actions;
+    ex->actions_nb = actions_nb;
+    ex->hold = hold;
+    pthread_mutex_init(&ex->lock, NULL);
+
+    // most states share all but a couple of pages
+    ex->states_cap = max_states;
+    ex->pages_cap = 4 * max_states + PAGE_NB;
+    ex->state_set_nb = pow2_at_least(2 * ex->states_cap);
+    ex->page_set_nb = pow2_at_least(2 * ex->pages_cap);
+
+    ex->states = malloc(ex->states_cap * sizeof(struct chip8_explore_state_t));
+    ex->pages = malloc(ex->pages_cap * PAGE_SIZE);
+    ex->state_set = calloc(ex->state_set_nb, sizeof(struct chip8_explore_slot_t));
+    ex->page_set = calloc(ex->page_set_nb, sizeof(struct chip8_explore_slot_t));
+    if (max_states == 0 || ex->states == NULL || ex->pages == NULL || ex->state_set == NULL || ex->page_set == NULL)
+    {
+        chip8_explore_t_destroy(ex);
+        return -1;
+    }
+
+    // the boot state is the first level
+    union chip8_t boot;
+    chip8_rom_t_boot(rom, &boot);
+    canonicalize(&boot);
+    struct chip8_explore_state_t s = {.parent = UINT32_MAX};
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        s.pages[p] = intern_page(ex, boot.memory + p * PAGE_SIZE);
+        ex->rom_pages[p] = s.pages[p];
+    }
+    add_state(ex, &s);
+    ex->level_first = 0;
+    ex->level_last = 1;
+    return 0;
+}
+
+void chip8_explore_t_destroy(struct chip8_explore_t *ex)
+{
+    pthread_mutex_destroy(&ex->lock);
+    free(ex->states);
+    free(ex->pages);
+    free(ex->state_set);
+    free(ex->page_set);
+    memset(ex, 0, sizeof(*ex));
+}
+
+enum explore_result chip8_explore_t_run(struct chip8_explore_t *ex, size_t max_depth, size_t threads_nb)
+{
+    pthread_t threads[threads_nb > 1 ? threads_nb - 1 : 1];
+
+    for (size_t d = 0; d < max_depth; d++)
+    {
+        if (ex->level_first == ex->level_last)
+        {
+            return EXPLORE_DONE;
+        }
+
+        atomic_store_explicit(&ex->next, ex->level_first, memory_order_relaxed);
+        size_t started = 0;
+        while (started + 1 < threads_nb && pthread_create(threads + started, NULL, explore_thread, ex) == 0)
+        {
+            started++;
+        }
+        explore_thread(ex);
+        for (size_t i = 0; i < started; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        if (ex->violation)
+        {
+            return EXPLORE_VIOLATION;
+        }
+        if (atomic_load(&ex->full))
+        {
+            return EXPLORE_FULL;
+        }
+        ex->level_first = ex->level_last;
+        ex->level_last = atomic_load(&ex->states_nb);
+        ex->depth += 1;
+    }
+    return ex->level_first == ex->level_last ? EXPLORE_DONE : EXPLORE_DEPTH;
+}
+
+size_t chip8_explore_t_trace(const struct chip8_explore_t *ex, uint32_t state, uint16_t *keys)
+{
+    size_t nb = 0;
+    for (uint32_t s = state; ex->states[s].parent != UINT32_MAX; s = ex->states[s].parent)
+    {
+        nb++;
+    }
+    size_t i = nb;
+    for (uint32_t s = state; ex->states[s].parent != UINT32_MAX; s = ex->states[s].parent)
+    {
+        keys[--i] = ex->states[s].keys;
+    }
+    return nb;
+}
@@ -0,0 +1,117 @@
+#ifndef CHIP8_EXPLORE_H
+#define CHIP8_EXPLORE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+#include "watch.h"
+
+enum explore_result
+{
+    EXPLORE_DONE,      // every reachable state was visited
+    EXPLORE_DEPTH,     // stopped at the depth limit
+    EXPLORE_FULL,      // ran out of room for states or pages
+    EXPLORE_VIOLATION  // a state broke one of the checks
+};
+
+enum explore_violation
+{
+    EXPLORE_BAD_PC = 1,     // PC left PROG_START..MEM_NB - 2
+    EXPLORE_OVERFLOW = 2,   // call with all 16 stack slots in use
+    EXPLORE_UNDERFLOW = 3,  // return with an empty stack
+    EXPLORE_BAD_WATCH = 4   // the user's expression was true
+};
+
+// a slot of one of the concurrent hash sets.
+// lo is claimed with a compare and swap, and hi is stored last, so once
+// hi is non-zero everything else in the slot can be read
+struct chip8_explore_slot_t
+{
+    _Atomic uint64_t lo;
+    _Atomic uint64_t hi;
+    // for pages, the index of the page in the page store
+    _Atomic uint32_t id;
+};
+
+// a visited state: which page each 256 bytes of it is, and how we got here
+struct chip8_explore_state_t
+{
+    uint32_t pages[PAGE_NB];
+    uint32_t parent;
+    uint16_t keys;
+};
+
+// model checker: visits every state a rom can reach with any sequence of
+// the given actions (key masks held for hold frames each), breadth first
+// across threads, and checks every cycle for a bad PC or the stack
+// overflowing or underflowing, and every step for a watch expression.
+// states are stored as 16 ids of hash-consed pages, so the pages that
+// never change (the rom, mostly) are stored once for all states, and two
+// states are the same exactly when their page ids are. visited states
+// are deduplicated through a lock-free set of 128-bit hashes of those ids
+struct chip8_explore_t
+{
+    const struct chip8_rom_t *rom;
+    const struct chip8_predecode_t *pd;
+    const struct chip8_watch_t *bad;
+    const uint16_t *actions;
+    size_t actions_nb;
+    size_t hold;
+
+    // page store, and the set from page hash to its id
+    uint8_t (*pages)[PAGE_SIZE];
+    atomic_uint pages_nb;
+    size_t pages_cap;
+    struct chip8_explore_slot_t *page_set;
+    size_t page_set_nb;
+
+    // every state visited, in breadth first order, and the set of their hashes
+    struct chip8_explore_state_t *states;
+    atomic_uint states_nb;
+    size_t states_cap;
+    struct chip8_explore_slot_t *state_set;
+    size_t state_set_nb;
+
+    // page ids of the boot image, to tell which pages a state modified
+    uint32_t rom_pages[PAGE_NB];
+
+    // the level being expanded
+    size_t level_first;
+    size_t level_last;
+    atomic_size_t next;
+    atomic_int full;
+
+    // the first violation found, states[violation_parent] + violation_keys
+    // leads to it
+    pthread_mutex_t lock;
+    int violation;
+    uint32_t violation_parent;
+    uint16_t violation_keys;
+    uint16_t violation_pc;
+
+    size_t depth;
+};
+
+// room for max_states states and four times as many distinct pages.
+// bad may be NULL. returns -1 if we're out of memory
+int chip8_explore_t_init(struct chip8_explore_t *ex, const struct chip8_rom_t *rom, const struct chip8_predecode_t *pd,
+                         const struct chip8_watch_t *bad, const uint16_t *actions, size_t actions_nb, size_t hold,
+                         size_t max_states);
+void chip8_explore_t_destroy(struct chip8_explore_t *ex);
+
+// explore max_depth more levels on threads_nb threads
+enum explore_result chip8_explore_t_run(struct chip8_explore_t *ex, size_t max_depth, size_t threads_nb);
+
+// the keys held at each step from boot to a state, returns how many steps
+// that is. keys needs room for depth entries
+size_t chip8_explore_t_trace(const struct chip8_explore_t *ex, uint32_t state, uint16_t *keys);
+
+// rebuild a flat instance from a stored state
+void chip8_explore_t_restore(const struct chip8_explore_t *ex, uint32_t state, union chip8_t *c8);
+
+#endif
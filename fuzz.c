@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz.h"
+
+// splitmix64, each thread gets its own stream
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int add_input(struct chip8_fuzz_t *f, const struct chip8_fuzz_input_t *input)
+{
+    if (f->corpus_nb == f->corpus_cap)
+    {
+        const size_t cap = f->corpus_cap ? f->corpus_cap * 2 : 64;
+        struct chip8_fuzz_input_t *corpus = realloc(f->corpus, cap * sizeof(*corpus));
+        if (corpus == NULL)
+        {
+            return -1;
+        }
+        f->corpus = corpus;
+        f->corpus_cap = cap;
+    }
+    f->corpus[f->corpus_nb++] = *input;
+    return 0;
+}
+
+// keep what's new from one execution. called with the lock held
+static void add_result(struct chip8_fuzz_t *f, const struct chip8_fuzz_input_t *input,
+                       const struct chip8_coverage_t *cov, const struct chip8_fuzz_crash_t *crash)
+{
+    if (chip8_coverage_t_new(&f->coverage, cov) > 0)
+    {
+        chip8_coverage_t_merge(&f->coverage, cov);
+        add_input(f, input);
+    }
+    if (crash == NULL || f->crashes_nb == FUZZ_CRASHES_NB)
+    {
+        return;
+    }
+    for (size_t i = 0; i < f->crashes_nb; i++)
+    {
+        if (f->crashes[i].kind == crash->kind && f->crashes[i].pc == crash->pc)
+        {
+            return;
+        }
+    }
+    f->crashes[f->crashes_nb++] = *crash;
+}
+
+int chip8_fuzz_t_init(struct chip8_fuzz_t *f, const struct chip8_predecode_t *pd, size_t max_frames, uint64_t seed)
+{
+    memset(f, 0, sizeof(*f));
+    f->pd = pd;
+    f->max_frames = max_frames;
+    f->seed = seed;
+    pthread_mutex_init(&f->lock, NULL);
+
+    struct chip8_fuzz_input_t input = {.nb = 1};
+    input.frames[0] = max_frames < UINT16_MAX ? max_frames : UINT16_MAX;
+    if (add_input(f, &input) < 0)
+    {
+        chip8_fuzz_t_destroy(f);
+        return -1;
+    }
+
+    struct chip8_coverage_t cov;
+    memset(&cov, 0, sizeof(cov));
+    struct chip8_fuzz_crash_t crash;
+    const int crashed = chip8_fuzz_t_play(f, &input, &cov, &crash);
+    chip8_coverage_t_merge(&f->coverage, &cov);
+    add_result(f, &input, &cov, crashed ? &crash : NULL);
+    return 0;
+}
+
+void chip8_fuzz_t_destroy(struct chip8_fuzz_t *f)
+{
+    pthread_mutex_destroy(&f->lock);
+    free(f->corpus);
+    memset(f, 0, sizeof(*f));
+}
+
+int chip8_fuzz_t_play(const struct chip8_fuzz_t *f, const struct chip8_fuzz_input_t *input,
+                      struct chip8_coverage_t *cov, struct chip8_fuzz_crash_t *crash)
+{
+    union chip8_t c8;
+    chip8_rom_t_boot(f->pd->rom, &c8);
+
+    size_t frame = 0;
+    for (size_t run = 0; run < input->nb; run++)
+    {
+        chip8_t_set_keys(&c8, input->keys[run]);
+        for (size_t i = 0; i < input->frames[run] && frame < f->max_frames; i++, frame++)
+        {
+            for (size_t j = 0; j < CYCLES_PER_FRAME; j++)
+            {
+                const uint16_t pc = c8.PC;
+                chip8_t_emulate_cycle_covered(&c8, f->pd, cov);
+
+                // a call with a full stack leaves SP at 17, a return with
+                // an empty one wraps it around to 255
+                int kind = 0;
+                if (c8.SP > 16)
+                {
+                    kind = c8.SP == 17 ? FUZZ_OVERFLOW : FUZZ_UNDERFLOW;
+                }
+                else if (c8.PC < PROG_START || c8.PC > MEM_NB - 2)
+                {
+                    kind = FUZZ_BAD_PC;
+                }
+                if (kind != 0)
+                {
+                    if (crash != NULL)
+                    {
+                        crash->kind = kind;
+                        crash->pc = pc;
+                        crash->frame = frame;
+                        crash->input = *input;
+                    }
+                    return kind;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static uint16_t random_keys(uint64_t *rng)
+{
+    const uint64_t r = next_random(rng);
+    switch (r % 4)
+    {
+    case 0:
+        return 0;
+    case 3:
+        return r >> 16;
+    default:
+        // mostly one key at a time, like a player
+        return 1 << ((r >> 8) % 16);
+    }
+}
+
+static void mutate(struct chip8_fuzz_input_t *in, const struct chip8_fuzz_input_t *other, uint64_t *rng)
+{
+    const size_t rounds = 1 + next_random(rng) % 4;
+    for (size_t round = 0; round < rounds; round++)
+    {
+        const uint64_t r = next_random(rng);
+        const size_t at = (r >> 8) % in->nb;
+        switch (r % 5)
+        {
+        case 0:
+            in->keys[at] = random_keys(rng);
+            break;
+        case 1:
+            in->frames[at] = 1 + (r >> 32) % 120;
+            break;
+        case 2:
+            if (in->nb < FUZZ_RUNS_NB)
+            {
+                memmove(in->frames + at + 1, in->frames + at, (in->nb - at) * sizeof(uint16_t));
+                memmove(in->keys + at + 1, in->keys + at, (in->nb - at) * sizeof(uint16_t));
+                in->frames[at] = 1 + (r >> 32) % 120;
+                in->keys[at] = random_keys(rng);
+                in->nb++;
+            }
+            break;
+        case 3:
+            if (in->nb > 1)
+            {
+                memmove(in->frames + at, in->frames + at + 1, (in->nb - at - 1) * sizeof(uint16_t));
+                memmove(in->keys + at, in->keys + at + 1, (in->nb - at - 1) * sizeof(uint16_t));
+                in->nb--;
+            }
+            break;
+        case 4:
+        {
+            // keep our start, finish like the other one
+            const size_t from = (r >> 32) % other->nb;
+            size_t nb = at + 1;
+            for (size_t i = from; i < other->nb && nb < FUZZ_RUNS_NB; i++, nb++)
+            {
+                in->frames[nb] = other->frames[i];
+                in->keys[nb] = other->keys[i];
+            }
+            in->nb = nb;
+            break;
+        }
+        }
+    }
+}
+
+static void *fuzz_thread(void *arg)
+{
+    struct chip8_fuzz_t *f = arg;
+    uint64_t rng = f->seed + atomic_fetch_add(&f->streams, 1);
+    rng = next_random(&rng);
+
+    struct chip8_fuzz_input_t input;
+    struct chip8_fuzz_input_t other;
+    struct chip8_coverage_t cov;
+    struct chip8_fuzz_crash_t crash;
+    while (atomic_fetch_sub_explicit(&f->left, 1, memory_order_relaxed) > 0)
+    {
+        pthread_mutex_lock(&f->lock);
+        input = f->corpus[next_random(&rng) % f->corpus_nb];
+        other = f->corpus[next_random(&rng) % f->corpus_nb];
+        pthread_mutex_unlock(&f->lock);
+
+        mutate(&input, &other, &rng);
+        memset(&cov, 0, sizeof(cov));
+        const int crashed = chip8_fuzz_t_play(f, &input, &cov, &crash);
+        atomic_fetch_add_explicit(&f->execs, 1, memory_order_relaxed);
+
+        pthread_mutex_lock(&f->lock);
+        add_result(f, &input, &cov, crashed ? &crash : NULL);
+        pthread_mutex_unlock(&f->lock);
+    }
+    return NULL;
+}
+
+void chip8_fuzz_t_run(struct chip8_fuzz_t *f, size_t execs, size_t threads_nb)
+{
+    atomic_store(&f->left, execs);
+
+    pthread_t threads[threads_nb > 1 ? threads_nb - 1 : 1];
+    size_t started = 0;
+    while (started + 1 < threads_nb && pthread_create(threads + started, NULL, fuzz_thread, f) == 0)
+    {
+        started++;
+    }
+    fuzz_thread(f);
+    for (size_t i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
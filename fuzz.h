@@ -0,0 +1,91 @@
+#ifndef CHIP8_FUZZ_H
+#define CHIP8_FUZZ_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "coverage.h"
+#include "predecode.h"
+
+enum fuzz_constants
+{
+    // stretches of held keys in an input
+    FUZZ_RUNS_NB = 64,
+
+    // crashes kept, one per kind and address
+    FUZZ_CRASHES_NB = 64
+};
+
+enum fuzz_crash_kind
+{
+    FUZZ_BAD_PC = 1,    // PC left PROG_START..MEM_NB - 2
+    FUZZ_OVERFLOW = 2,  // call with all 16 stack slots in use
+    FUZZ_UNDERFLOW = 3  // return with an empty stack
+};
+
+// an input sequence: keys[i] held for frames[i] frames, from boot
+struct chip8_fuzz_input_t
+{
+    uint16_t frames[FUZZ_RUNS_NB];
+    uint16_t keys[FUZZ_RUNS_NB];
+    size_t nb;
+};
+
+struct chip8_fuzz_crash_t
+{
+    enum fuzz_crash_kind kind;
+    // of the instruction that crashed, and the frame it was in
+    uint16_t pc;
+    uint32_t frame;
+    struct chip8_fuzz_input_t input;
+};
+
+// coverage guided fuzzer for keypad inputs.
+// every execution takes an input from the corpus, mutates it (changes the
+// keys or length of a stretch, adds or removes one, or splices in the end
+// of another input), and plays it from boot with coverage on. inputs that
+// reach an address or skip outcome nothing else has are added to the
+// corpus. a stack overflow or underflow, or PC leaving the rom, is kept as
+// a crash along with the input that caused it.
+// executions run on any number of threads, only the corpus, the total
+// coverage and the crashes are shared, under one lock
+struct chip8_fuzz_t
+{
+    const struct chip8_predecode_t *pd;
+    size_t max_frames;
+
+    pthread_mutex_t lock;
+    struct chip8_coverage_t coverage;
+
+    struct chip8_fuzz_input_t *corpus;
+    size_t corpus_nb;
+    size_t corpus_cap;
+
+    struct chip8_fuzz_crash_t crashes[FUZZ_CRASHES_NB];
+    size_t crashes_nb;
+
+    // executions so far, and the ones left in the current run
+    atomic_ullong execs;
+    atomic_llong left;
+    // every thread draws from its own stream of random numbers
+    uint64_t seed;
+    atomic_ullong streams;
+};
+
+// start with a corpus of one input holding nothing for max_frames.
+// returns -1 if we're out of memory
+int chip8_fuzz_t_init(struct chip8_fuzz_t *f, const struct chip8_predecode_t *pd, size_t max_frames, uint64_t seed);
+void chip8_fuzz_t_destroy(struct chip8_fuzz_t *f);
+
+// run execs more executions on threads_nb threads
+void chip8_fuzz_t_run(struct chip8_fuzz_t *f, size_t execs, size_t threads_nb);
+
+// play input from boot, adding to cov. returns the crash kind, 0 if none,
+// and fills in crash if it isn't NULL
+int chip8_fuzz_t_play(const struct chip8_fuzz_t *f, const struct chip8_fuzz_input_t *input,
+                      struct chip8_coverage_t *cov, struct chip8_fuzz_crash_t *crash);
+
+#endif
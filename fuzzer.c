@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "coverage.h"
+#include "fuzz.h"
+#include "movie.h"
+#include "predecode.h"
+#include "rom.h"
+
+// coverage guided fuzzer front end: fuzzes the keypad inputs of each rom
+// in turn, printing how much of it was covered and any crashes found.
+// with --out, every crash is also written as a movie that plays up to it,
+// to look at with chip8-movie or the debugger.
+// exits with 0 if no rom crashed, 2 otherwise
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-fuzz [--frames N] [--execs N] [--threads N] [--seed N] [--out DIR] ROM...\n");
+    exit(1);
+}
+
+static const char *crash_name(enum fuzz_crash_kind kind)
+{
+    switch (kind)
+    {
+    case FUZZ_BAD_PC:
+        return "bad PC";
+    case FUZZ_OVERFLOW:
+        return "stack overflow";
+    default:
+        return "stack underflow";
+    }
+}
+
+// the input of crash, up to and including the frame it crashed in
+static int save_crash(const struct chip8_fuzz_crash_t *crash, const struct chip8_predecode_t *pd, const char *path)
+{
+    static struct chip8_movie_t m;
+    chip8_movie_t_init(&m, MOVIE_INTERVAL);
+
+    union chip8_t c8;
+    chip8_rom_t_boot(pd->rom, &c8);
+    size_t frame = 0;
+    for (size_t run = 0; run < crash->input.nb && frame <= crash->frame; run++)
+    {
+        for (size_t i = 0; i < crash->input.frames[run] && frame <= crash->frame; i++, frame++)
+        {
+            if (chip8_movie_t_record(&m, &c8, crash->input.keys[run]) < 0)
+            {
+                chip8_movie_t_destroy(&m);
+                return -1;
+            }
+            chip8_t_set_keys(&c8, crash->input.keys[run]);
+            for (size_t j = 0; j < CYCLES_PER_FRAME; j++)
+            {
+                chip8_t_emulate_cycle_predecoded(&c8, pd);
+            }
+        }
+    }
+    const int status = chip8_movie_t_save(&m, &c8, path);
+    chip8_movie_t_destroy(&m);
+    return status;
+}
+
+static void print_progress(const char *rom_path, struct chip8_fuzz_t *f)
+{
+    pthread_mutex_lock(&f->lock);
+    const struct chip8_coverage_t *cov = &f->coverage;
+    printf("%s: %llu execs, %zu inputs, %zu addresses, %zu skips taken, %zu not taken, %zu crashes\n", rom_path,
+           (unsigned long long)atomic_load(&f->execs), f->corpus_nb, chip8_coverage_t_count(cov, COVERAGE_PC),
+           chip8_coverage_t_count(cov, COVERAGE_SKIPPED), chip8_coverage_t_count(cov, COVERAGE_NOT_SKIPPED),
+           f->crashes_nb);
+    pthread_mutex_unlock(&f->lock);
+    fflush(stdout);
+}
+
+static int fuzz(const char *rom_path, long frames, long execs, long threads, uint64_t seed, const char *out)
+{
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        chip8_rom_t_release(rom);
+        return -1;
+    }
+
+    static struct chip8_fuzz_t f;
+    if (chip8_fuzz_t_init(&f, pd, frames, seed) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    // ten rounds, so there's something to look at on long runs
+    for (long round = 0; round < 10; round++)
+    {
+        chip8_fuzz_t_run(&f, execs / 10 + (round < execs % 10), threads);
+        print_progress(rom_path, &f);
+    }
+
+    const char *name = strrchr(rom_path, '/');
+    name = name ? name + 1 : rom_path;
+    for (size_t i = 0; i < f.crashes_nb; i++)
+    {
+        const struct chip8_fuzz_crash_t *crash = f.crashes + i;
+        printf("  %s at 0x%03X in frame %u\n", crash_name(crash->kind), crash->pc, crash->frame);
+        if (out != NULL)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s-%zu.mov", out, name, i);
+            if (save_crash(crash, pd, path) < 0)
+            {
+                fprintf(stderr, "Could not write %s\n", path);
+            }
+            else
+            {
+                printf("    %s\n", path);
+            }
+        }
+    }
+
+    const size_t crashes_nb = f.crashes_nb;
+    chip8_fuzz_t_destroy(&f);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return crashes_nb > 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 3600;
+    long execs = 100000;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = 1;
+    const char *out = NULL;
+    const char *roms[256];
+    size_t roms_nb = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--execs") == 0 && i + 1 < argc)
+        {
+            execs = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out = argv[++i];
+        }
+        else if (argv[i][0] != '-' && roms_nb < sizeof(roms) / sizeof(roms[0]))
+        {
+            roms[roms_nb++] = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (roms_nb == 0 || frames <= 0 || execs < 0 || threads <= 0)
+    {
+        usage();
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < roms_nb; i++)
+    {
+        const int crashed = fuzz(roms[i], frames, execs, threads, seed, out);
+        if (crashed < 0)
+        {
+            return 1;
+        }
+        if (crashed)
+        {
+            status = 2;
+        }
+    }
+    return status;
+}
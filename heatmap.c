@@ -0,0 +1,165 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "heatmap.h"
+
+_Thread_local struct chip8_heatmap_t *chip8_heatmap;
+
+int chip8_heatmap_t_write_ppm(const struct chip8_heatmap_t *h, const char *path)
+{
+    const size_t side = 64 * HEATMAP_SCALE;
+
+    double scale[HEATMAP_KINDS];
+    for (size_t k = 0; k < HEATMAP_KINDS; k++)
+    {
+        uint32_t max = 0;
+        for (size_t addr = 0; addr < MEM_NB; addr++)
+        {
+            max = h->counts[k][addr] > max ? h->counts[k][addr] : max;
+        }
+        scale[k] = max ? 255 / log1p(max) : 0;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    fprintf(f, "P6\n%zu %zu\n255\n", side, side);
+
+    // red, green and blue from writes, reads and executes
+    static const enum heatmap_kind channels[3] = {HEATMAP_WRITE, HEATMAP_READ, HEATMAP_EXECUTE};
+    uint8_t row[64 * HEATMAP_SCALE * 3];
+    for (size_t y = 0; y < side; y++)
+    {
+        for (size_t x = 0; x < side; x++)
+        {
+            const size_t addr = (y / HEATMAP_SCALE) * 64 + x / HEATMAP_SCALE;
+            for (size_t c = 0; c < 3; c++)
+            {
+                const enum heatmap_kind k = channels[c];
+                row[x * 3 + c] = log1p(h->counts[k][addr]) * scale[k];
+            }
+        }
+        fwrite(row, sizeof(row), 1, f);
+    }
+    const int ok = !ferror(f);
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+struct hot_t
+{
+    uint16_t first;
+    uint16_t last;
+    uint64_t accesses;
+};
+
+static int compare_hot(const void *a, const void *b)
+{
+    const uint64_t x = ((const struct hot_t *)a)->accesses;
+    const uint64_t y = ((const struct hot_t *)b)->accesses;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// print the stretches of addresses from..to where in(h, addr) holds, with
+// how many times they were written. returns the number of addresses
+static size_t print_ranges(const struct chip8_heatmap_t *h, size_t from, size_t to,
+                           int (*in)(const struct chip8_heatmap_t *, size_t), FILE *out)
+{
+    size_t nb = 0;
+    for (size_t addr = from; addr < to; addr++)
+    {
+        if (!in(h, addr))
+        {
+            continue;
+        }
+        const size_t first = addr;
+        uint64_t writes = 0;
+        for (; addr < to && in(h, addr); addr++)
+        {
+            writes += h->counts[HEATMAP_WRITE][addr];
+        }
+        fprintf(out, "  0x%03zX-0x%03zX  %llu writes\n", first, addr - 1, (unsigned long long)writes);
+        nb += addr - first;
+    }
+    return nb;
+}
+
+static int is_modified_code(const struct chip8_heatmap_t *h, size_t addr)
+{
+    return h->counts[HEATMAP_EXECUTE][addr] && h->counts[HEATMAP_WRITE][addr];
+}
+
+static int is_written_data(const struct chip8_heatmap_t *h, size_t addr)
+{
+    return !h->counts[HEATMAP_EXECUTE][addr] && h->counts[HEATMAP_WRITE][addr];
+}
+
+size_t chip8_heatmap_t_report(const struct chip8_heatmap_t *h, size_t rom_size, FILE *out)
+{
+    const size_t rom_end = PROG_START + rom_size < MEM_NB ? PROG_START + rom_size : MEM_NB;
+
+    fprintf(out, "executed bytes written:\n");
+    const size_t modified = print_ranges(h, 0, MEM_NB, is_modified_code, out);
+    if (modified == 0)
+    {
+        fprintf(out, "  none\n");
+    }
+
+    fprintf(out, "rom data written:\n");
+    if (print_ranges(h, PROG_START, rom_end, is_written_data, out) == 0)
+    {
+        fprintf(out, "  none\n");
+    }
+
+    // the pages predecoded execution stops trusting once they're written
+    uint16_t code_pages = 0;
+    uint16_t written_pages = 0;
+    for (size_t addr = PROG_START; addr < MEM_NB; addr++)
+    {
+        code_pages |= (h->counts[HEATMAP_EXECUTE][addr] != 0) << (addr / PAGE_SIZE);
+        written_pages |= (h->counts[HEATMAP_WRITE][addr] != 0) << (addr / PAGE_SIZE);
+    }
+    fprintf(out, "code pages written:");
+    for (size_t p = 0; p < PAGE_NB; p++)
+    {
+        if (code_pages & written_pages & (1 << p))
+        {
+            fprintf(out, " 0x%03zX", p * PAGE_SIZE);
+        }
+    }
+    fprintf(out, (code_pages & written_pages) ? "\n" : " none\n");
+
+    // stretches of bytes read or written but never run, busiest first
+    struct hot_t hot[MEM_NB / 2 + 1];
+    size_t hot_nb = 0;
+    for (size_t addr = 0; addr < MEM_NB; addr++)
+    {
+        const uint64_t accesses = (uint64_t)h->counts[HEATMAP_READ][addr] + h->counts[HEATMAP_WRITE][addr];
+        if (accesses == 0 || h->counts[HEATMAP_EXECUTE][addr])
+        {
+            continue;
+        }
+        if (hot_nb > 0 && (size_t)hot[hot_nb - 1].last + 1 == addr)
+        {
+            hot[hot_nb - 1].last = addr;
+            hot[hot_nb - 1].accesses += accesses;
+        }
+        else
+        {
+            hot[hot_nb++] = (struct hot_t){.first = addr, .last = addr, .accesses = accesses};
+        }
+    }
+    qsort(hot, hot_nb, sizeof(hot[0]), compare_hot);
+    fprintf(out, "hottest data:\n");
+    for (size_t i = 0; i < hot_nb && i < HEATMAP_HOT_NB; i++)
+    {
+        fprintf(out, "  0x%03X-0x%03X  %llu accesses\n", hot[i].first, hot[i].last,
+                (unsigned long long)hot[i].accesses);
+    }
+    if (hot_nb == 0)
+    {
+        fprintf(out, "  none\n");
+    }
+    return modified;
+}
@@ -0,0 +1,70 @@
+#ifndef CHIP8_HEATMAP_H
+#define CHIP8_HEATMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+enum heatmap_kind
+{
+    HEATMAP_READ,    // Dxyn sprites and Fx65
+    HEATMAP_WRITE,   // Fx33 and Fx55
+    HEATMAP_EXECUTE, // both bytes of every instruction fetched
+    HEATMAP_KINDS
+};
+
+enum heatmap_constants
+{
+    // the image is 64 x 64 bytes, each drawn as a square this wide
+    HEATMAP_SCALE = 8,
+
+    // stretches of data listed in the report
+    HEATMAP_HOT_NB = 8
+};
+
+// how many times each byte of memory was accessed, per kind
+struct chip8_heatmap_t
+{
+    uint32_t counts[HEATMAP_KINDS][MEM_NB];
+};
+
+// where a core built with CHIP8_HEATMAP counts the accesses made on this
+// thread. nothing is counted while it's NULL
+extern _Thread_local struct chip8_heatmap_t *chip8_heatmap;
+
+static inline void chip8_heatmap_t_add(enum heatmap_kind kind, uint16_t addr, size_t len)
+{
+    struct chip8_heatmap_t *h = chip8_heatmap;
+    if (h == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        h->counts[kind][(addr + i) % MEM_NB]++;
+    }
+}
+
+// the hooks in chip8.c. without CHIP8_HEATMAP they are nothing at all, so
+// the normal builds of the core don't pay for them
+#ifdef CHIP8_HEATMAP
+#define CHIP8_HEAT(kind, addr, len) chip8_heatmap_t_add(kind, addr, len)
+#else
+#define CHIP8_HEAT(kind, addr, len) ((void)0)
+#endif
+
+// write h as a binary PPM, one square per byte, 64 bytes to a row.
+// writes are red, reads green and executes blue, each on a log scale of
+// its busiest byte. returns -1 if the file can't be written
+int chip8_heatmap_t_write_ppm(const struct chip8_heatmap_t *h, const char *path);
+
+// print which executed bytes were also written, which bytes of the rom
+// image (PROG_START up to rom_size more) were written, and the busiest
+// stretches of data. returns the number of executed bytes that were also
+// written, 0 means the rom never ran code it changed, so decoded
+// instructions could have been cached for the whole run
+size_t chip8_heatmap_t_report(const struct chip8_heatmap_t *h, size_t rom_size, FILE *out);
+
+#endif
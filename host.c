@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rom.h"
+#include "scheduler.h"
+
+// hosts sessions of the roms given on the scheduler's pinned workers, with
+// keys mashed at random, and prints per worker utilization every second.
+// --churn closes that many sessions a second and opens new ones in their
+// place, like players coming and going
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-host [--workers N] [--sessions N] [--capacity N] [--seconds N] [--churn N] ROM...\n");
+    exit(1);
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int main(int argc, char const *argv[])
+{
+    long workers_nb = 0;
+    long sessions_nb = 1000;
+    long capacity = 0;
+    long seconds = 10;
+    long churn = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            workers_nb = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc)
+        {
+            sessions_nb = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+        {
+            capacity = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--churn") == 0 && i + 1 < argc)
+        {
+            churn = strtol(argv[++i], NULL, 0);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (i == argc || workers_nb < 0 || sessions_nb <= 0 || capacity < 0 || seconds < 0 || churn < 0)
+    {
+        usage();
+    }
+
+    const int roms_nb = argc - i;
+    struct chip8_rom_t **roms = calloc(roms_nb, sizeof(*roms));
+    struct chip8_hosted_t **sessions = calloc(sessions_nb, sizeof(*sessions));
+    if (roms == NULL || sessions == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int r = 0; r < roms_nb; r++)
+    {
+        roms[r] = chip8_rom_t_load(argv[i + r]);
+        if (roms[r] == NULL)
+        {
+            fprintf(stderr, "Could not open ROM %s\n", argv[i + r]);
+            return 1;
+        }
+    }
+
+    // by default every worker could take all the sessions on its own
+    static struct chip8_scheduler_t s;
+    if (chip8_scheduler_t_init(&s, workers_nb, capacity ? (size_t)capacity : (size_t)sessions_nb) < 0)
+    {
+        fprintf(stderr, "Could not start the workers\n");
+        return 1;
+    }
+
+    long opened = 0;
+    for (long j = 0; j < sessions_nb; j++)
+    {
+        sessions[j] = chip8_scheduler_t_open(&s, roms[j % roms_nb]);
+        opened += sessions[j] != NULL;
+    }
+    if (opened < sessions_nb)
+    {
+        fprintf(stderr, "%ld sessions didn't fit\n", sessions_nb - opened);
+    }
+
+    uint64_t rng = 1;
+    for (long second = 0; second < seconds; second++)
+    {
+        // players press something new a few times a second
+        for (int tick = 0; tick < 4; tick++)
+        {
+            for (long j = 0; j < sessions_nb; j++)
+            {
+                if (sessions[j] != NULL)
+                {
+                    atomic_store_explicit(&sessions[j]->keys, 1 << (next_random(&rng) & 15), memory_order_relaxed);
+                }
+            }
+            usleep(250000);
+        }
+
+        for (long c = 0; c < churn; c++)
+        {
+            const long j = next_random(&rng) % sessions_nb;
+            if (sessions[j] != NULL)
+            {
+                chip8_scheduler_t_close(&s, sessions[j]);
+            }
+            sessions[j] = chip8_scheduler_t_open(&s, roms[j % roms_nb]);
+        }
+
+        const size_t moving = chip8_scheduler_t_balance(&s);
+        printf("second %ld\n", second + 1);
+        if (moving)
+        {
+            printf("moving %zu sessions\n", moving);
+        }
+        chip8_scheduler_t_report(&s, stdout);
+        fflush(stdout);
+    }
+
+    uint64_t frames = 0;
+    for (long j = 0; j < sessions_nb; j++)
+    {
+        if (sessions[j] != NULL)
+        {
+            frames += atomic_load(&sessions[j]->frames);
+            chip8_scheduler_t_close(&s, sessions[j]);
+        }
+    }
+    printf("%llu frames in the sessions still open\n", (unsigned long long)frames);
+
+    chip8_scheduler_t_destroy(&s);
+    for (int r = 0; r < roms_nb; r++)
+    {
+        chip8_rom_t_release(roms[r]);
+    }
+    free(roms);
+    free(sessions);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "interleave.h"
+
+// the instruction chip8_t_emulate_cycle_predecoded would run next.
+// returns 0 at the very end of memory, which is left to chip8_t_emulate_cycle
+static inline int fetch(const union chip8_t *c8, const struct chip8_predecode_t *pd, struct chip8_insn_t *in)
+{
+    const uint16_t pc = c8->PC;
+    if (pc >= MEM_NB - 1)
+    {
+        return 0;
+    }
+    if (pc >= PROG_START && !(c8->dirty_pages & chip8_page_mask(pc, 2)))
+    {
+        *in = pd->insns[pc];
+    }
+    else
+    {
+        *in = chip8_insn_t_decode((c8->memory[pc] << 8) | c8->memory[pc + 1]);
+    }
+    return 1;
+}
+
+// ways is a constant where this is inlined, so both loops unroll
+static inline void run_ways(union chip8_t *const c8s[], const struct chip8_predecode_t *const pds[], size_t ways,
+                            size_t cycles)
+{
+    struct chip8_insn_t in[INTERLEAVE_WAYS];
+    int fetched[INTERLEAVE_WAYS];
+    for (size_t cycle = 0; cycle < cycles; cycle++)
+    {
+        for (size_t k = 0; k < ways; k++)
+        {
+            fetched[k] = fetch(c8s[k], pds[k], in + k);
+        }
+        for (size_t k = 0; k < ways; k++)
+        {
+            if (fetched[k])
+            {
+                chip8_t_execute(c8s[k], in[k]);
+            }
+            else
+            {
+                chip8_t_emulate_cycle(c8s[k]);
+            }
+        }
+    }
+}
+
+void chip8_t_run_interleaved(union chip8_t *const c8s[], const struct chip8_predecode_t *const pds[], size_t nb,
+                             size_t cycles)
+{
+    size_t i = 0;
+    for (; i + INTERLEAVE_WAYS <= nb; i += INTERLEAVE_WAYS)
+    {
+        run_ways(c8s + i, pds + i, INTERLEAVE_WAYS, cycles);
+    }
+    if (i < nb)
+    {
+        run_ways(c8s + i, pds + i, nb - i, cycles);
+    }
+}
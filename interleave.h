@@ -0,0 +1,26 @@
+#ifndef CHIP8_INTERLEAVE_H
+#define CHIP8_INTERLEAVE_H
+
+#include <stddef.h>
+
+#include "chip8.h"
+#include "predecode.h"
+
+enum interleave_constants
+{
+    // instances stepped together in one loop
+    INTERLEAVE_WAYS = 4
+};
+
+// run cycles cycles on each of nb distinct instances, each with the cache
+// of its own rom. the result is the same as chip8_t_emulate_cycle_predecoded
+// on each instance in turn, but INTERLEAVE_WAYS of them take one step per
+// pass of the loop: all of their instructions are fetched first, then
+// executed one after the other. fetches don't depend on each other, so an
+// out of order core has the next instance's instruction ready while it is
+// still working through the previous one, without the instances having to
+// run the same code like lockstep batches do
+void chip8_t_run_interleaved(union chip8_t *const c8s[], const struct chip8_predecode_t *const pds[], size_t nb,
+                             size_t cycles);
+
+#endif
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "manifest.h"
+#include "movie.h"
+#include "predecode.h"
+#include "rom.h"
+
+long chip8_manifest_load(const char *path, long frames, struct chip8_case_t **cases)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    struct chip8_case_t *list = NULL;
+    long nb = 0;
+    long cap = 0;
+    char line[2 * MANIFEST_PATH_NB + 16];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), f) != NULL)
+    {
+        char rom[MANIFEST_PATH_NB];
+        char movie[MANIFEST_PATH_NB];
+        char extra[2];
+        // %511s matches MANIFEST_PATH_NB
+        const int fields = sscanf(line, "%511s %511s %1s", rom, movie, extra);
+        if (fields <= 0 || rom[0] == '#')
+        {
+            continue;
+        }
+        if (fields == 3 || (strchr(line, '\n') == NULL && !feof(f)))
+        {
+            ok = 0;
+            break;
+        }
+        if (nb == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            struct chip8_case_t *l = realloc(list, cap * sizeof(*l));
+            if (l == NULL)
+            {
+                ok = 0;
+                break;
+            }
+            list = l;
+        }
+        struct chip8_case_t *c = list + nb++;
+        strcpy(c->rom, rom);
+        strcpy(c->movie, fields == 2 ? movie : "");
+        c->frames = frames;
+    }
+    ok = ok && !ferror(f);
+    fclose(f);
+    if (!ok)
+    {
+        free(list);
+        return -1;
+    }
+    *cases = list;
+    return nb;
+}
+
+int chip8_case_t_run(const struct chip8_case_t *c, struct chip8_case_result_t *result)
+{
+    struct chip8_rom_t *rom = chip8_rom_t_load(c->rom);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    struct chip8_movie_t m = {0};
+    if (pd == NULL || (c->movie[0] && chip8_movie_t_load(&m, c->movie) < 0))
+    {
+        chip8_predecode_t_release(pd);
+        chip8_rom_t_release(rom);
+        return -1;
+    }
+
+    // the keyframes aren't used, the point is to emulate the whole way
+    long frames = c->frames;
+    if (c->movie[0] && (long)m.frames_nb < frames)
+    {
+        frames = m.frames_nb;
+    }
+    static _Thread_local union chip8_t c8;
+    chip8_rom_t_boot(rom, &c8);
+    long frame = 0;
+    for (; frame < frames && c8.PC < MEM_NB - 1; frame++)
+    {
+        chip8_t_set_keys(&c8, c->movie[0] ? m.keys[frame] : 0);
+        // the next fetch would read past the state, and whatever lies
+        // there would make the result differ from one run to the next
+        for (size_t i = 0; i < CYCLES_PER_FRAME && c8.PC < MEM_NB - 1; i++)
+        {
+            chip8_t_emulate_cycle_predecoded(&c8, pd);
+        }
+    }
+
+    result->frames = frame;
+    result->pc = c8.PC;
+    result->state_hash = chip8_hash(&c8, sizeof(c8));
+    result->display_hash = chip8_hash(c8.display, sizeof(c8.display));
+
+    chip8_movie_t_destroy(&m);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return 0;
+}
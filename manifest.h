@@ -0,0 +1,41 @@
+#ifndef CHIP8_MANIFEST_H
+#define CHIP8_MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum manifest_constants
+{
+    MANIFEST_PATH_NB = 512
+};
+
+// a rom played from boot for frames frames with no keys held, or with the
+// keys of a movie recorded on it, for the length of the movie if that's
+// shorter. movie is empty without one
+struct chip8_case_t
+{
+    char rom[MANIFEST_PATH_NB];
+    char movie[MANIFEST_PATH_NB];
+    long frames;
+};
+
+// where a case ended up. a case stops early, in the frame it was on, if PC
+// runs into the last byte of memory
+struct chip8_case_result_t
+{
+    long frames;
+    uint16_t pc;
+    uint64_t state_hash;
+    uint64_t display_hash;
+};
+
+// read a manifest: a case per line, "ROM [MOVIE]", paths without spaces.
+// blank lines and lines starting with # are skipped. every case gets frames
+// frames. returns the number of cases in a new array, or -1 if the file
+// can't be read, has a line that isn't a case or we're out of memory
+long chip8_manifest_load(const char *path, long frames, struct chip8_case_t **cases);
+
+// run a case. returns -1 if its rom or movie can't be loaded
+int chip8_case_t_run(const struct chip8_case_t *c, struct chip8_case_result_t *result);
+
+#endif
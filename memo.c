@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memo.h"
+
+int chip8_memo_t_init(struct chip8_memo_t *memo, size_t nb)
+{
+    memset(memo, 0, sizeof(*memo));
+    memo->buckets_nb = 1;
+    while (memo->buckets_nb < nb)
+    {
+        memo->buckets_nb *= 2;
+    }
+
+    memo->entries = malloc(nb * sizeof(struct chip8_memo_entry_t));
+    memo->buckets = malloc(memo->buckets_nb * sizeof(uint32_t));
+    if (nb == 0 || nb >= MEMO_NONE || memo->entries == NULL || memo->buckets == NULL)
+    {
+        chip8_memo_t_destroy(memo);
+        return -1;
+    }
+    memset(memo->buckets, 0xFF, memo->buckets_nb * sizeof(uint32_t));
+    memo->nb = nb;
+    memo->newest = MEMO_NONE;
+    memo->oldest = MEMO_NONE;
+    return 0;
+}
+
+void chip8_memo_t_destroy(struct chip8_memo_t *memo)
+{
+    free(memo->entries);
+    free(memo->buckets);
+    memset(memo, 0, sizeof(*memo));
+}
+
+uint64_t chip8_memo_hash(const struct chip8_rom_t *rom, const union chip8_t *c8)
+{
+    // the interpreter area without the keys, they're part of the cache key.
+    // past that only the pages the instance wrote can differ from the rom
+    uint8_t low[PROG_START];
+    memcpy(low, c8->memory, PROG_START);
+    memset(low + offsetof(union chip8_t, keys), 0, sizeof(c8->keys));
+
+    uint64_t h[2];
+    chip8_hash128(low, PROG_START, h);
+    uint64_t hash = h[0] ^ rom->hash;
+    for (size_t page = PROG_START / PAGE_SIZE; page < PAGE_NB; page++)
+    {
+        if (c8->dirty_pages & (1 << page))
+        {
+            chip8_hash128(c8->memory + page * PAGE_SIZE, PAGE_SIZE, h);
+            hash = hash * 31 + h[0];
+        }
+    }
+    // 0 stands for not known yet
+    return hash | 1;
+}
+
+static inline size_t bucket(const struct chip8_memo_t *memo, uint64_t hash, uint16_t keys)
+{
+    return (hash ^ (keys * 0x9E3779B97F4A7C15ULL)) & (memo->buckets_nb - 1);
+}
+
+static void lru_unlink(struct chip8_memo_t *memo, uint32_t i)
+{
+    struct chip8_memo_entry_t *e = memo->entries + i;
+    if (e->newer != MEMO_NONE)
+    {
+        memo->entries[e->newer].older = e->older;
+    }
+    else
+    {
+        memo->newest = e->older;
+    }
+    if (e->older != MEMO_NONE)
+    {
+        memo->entries[e->older].newer = e->newer;
+    }
+    else
+    {
+        memo->oldest = e->newer;
+    }
+}
+
+static void lru_push(struct chip8_memo_t *memo, uint32_t i)
+{
+    struct chip8_memo_entry_t *e = memo->entries + i;
+    e->newer = MEMO_NONE;
+    e->older = memo->newest;
+    if (memo->newest != MEMO_NONE)
+    {
+        memo->entries[memo->newest].newer = i;
+    }
+    memo->newest = i;
+    if (memo->oldest == MEMO_NONE)
+    {
+        memo->oldest = i;
+    }
+}
+
+// append the bytes that differ between before and after in [from, to) to
+// out as runs, merging runs less than 4 bytes apart since a run header is 3.
+// returns the new length, or more than MEMO_DELTA_NB if it doesn't fit
+static size_t encode(const uint8_t *before, const uint8_t *after, size_t from, size_t to, uint8_t *out, size_t len)
+{
+    size_t i = from;
+    while (i < to)
+    {
+        if (before[i] == after[i])
+        {
+            i++;
+            continue;
+        }
+
+        const size_t start = i;
+        size_t end = i + 1;
+        for (size_t j = i + 1; j < to && j - start < 255 && j - end < 3; j++)
+        {
+            if (before[j] != after[j])
+            {
+                end = j + 1;
+            }
+        }
+
+        const size_t n = end - start;
+        if (len + 3 + n > MEMO_DELTA_NB)
+        {
+            return MEMO_DELTA_NB + 1;
+        }
+        out[len] = start & 0xFF;
+        out[len + 1] = start >> 8;
+        out[len + 2] = n;
+        memcpy(out + len + 3, after + start, n);
+        len += 3 + n;
+        i = end;
+    }
+    return len;
+}
+
+static void apply(union chip8_t *c8, const uint8_t *delta, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        const size_t off = delta[i] | (delta[i + 1] << 8);
+        const size_t n = delta[i + 2];
+        memcpy(c8->memory + off, delta + i + 3, n);
+        i += 3 + n;
+    }
+}
+
+// take the least recently used entry out of its bucket and the list
+static uint32_t evict(struct chip8_memo_t *memo)
+{
+    const uint32_t i = memo->oldest;
+    const struct chip8_memo_entry_t *e = memo->entries + i;
+    uint32_t *link = memo->buckets + bucket(memo, e->hash, e->keys);
+    while (*link != i)
+    {
+        link = &memo->entries[*link].chain;
+    }
+    *link = e->chain;
+    lru_unlink(memo, i);
+    return i;
+}
+
+void chip8_memo_t_frame(struct chip8_memo_t *memo, union chip8_t *c8, const struct chip8_predecode_t *pd,
+                        uint16_t keys, uint64_t *hash)
+{
+    chip8_t_set_keys(c8, keys);
+    if (*hash == 0)
+    {
+        *hash = chip8_memo_hash(pd->rom, c8);
+    }
+
+    const size_t b = bucket(memo, *hash, keys);
+    for (uint32_t i = memo->buckets[b]; i != MEMO_NONE; i = memo->entries[i].chain)
+    {
+        struct chip8_memo_entry_t *e = memo->entries + i;
+        if (e->hash == *hash && e->keys == keys)
+        {
+            apply(c8, e->delta, e->delta_len);
+            *hash = e->next_hash;
+            lru_unlink(memo, i);
+            lru_push(memo, i);
+            memo->hits++;
+            return;
+        }
+    }
+    memo->misses++;
+
+    union chip8_t before;
+    memcpy(&before, c8, sizeof(before));
+    for (size_t i = 0; i < CYCLES_PER_FRAME; i++)
+    {
+        chip8_t_emulate_cycle_predecoded(c8, pd);
+    }
+    const uint64_t prev = *hash;
+    *hash = chip8_memo_hash(pd->rom, c8);
+
+    // the interpreter area, and any page the frame could have written
+    uint8_t delta[MEMO_DELTA_NB];
+    size_t len = encode(before.memory, c8->memory, 0, PROG_START, delta, 0);
+    for (size_t page = PROG_START / PAGE_SIZE; page < PAGE_NB && len <= MEMO_DELTA_NB; page++)
+    {
+        if (c8->dirty_pages & (1 << page))
+        {
+            len = encode(before.memory, c8->memory, page * PAGE_SIZE, (page + 1) * PAGE_SIZE, delta, len);
+        }
+    }
+    if (len > MEMO_DELTA_NB)
+    {
+        memo->too_big++;
+        return;
+    }
+
+    const uint32_t i = memo->used < memo->nb ? memo->used++ : evict(memo);
+    struct chip8_memo_entry_t *e = memo->entries + i;
+    e->hash = prev;
+    e->next_hash = *hash;
+    e->keys = keys;
+    e->delta_len = len;
+    memcpy(e->delta, delta, len);
+    e->chain = memo->buckets[b];
+    memo->buckets[b] = i;
+    lru_push(memo, i);
+}
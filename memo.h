@@ -0,0 +1,78 @@
+#ifndef CHIP8_MEMO_H
+#define CHIP8_MEMO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "predecode.h"
+
+enum memo_constants
+{
+    // encoded delta a frame may produce and still be cached.
+    // a frame that changes more than this is just emulated every time
+    MEMO_DELTA_NB = 232,
+    MEMO_NONE = UINT32_MAX
+};
+
+// one known frame: starting from the state with this hash and holding
+// these keys, the frame changes the bytes in delta and ends up in the
+// state with next_hash
+struct chip8_memo_entry_t
+{
+    uint64_t hash;
+    uint64_t next_hash;
+    uint16_t keys;
+    uint16_t delta_len;
+
+    // next entry in the same bucket, and neighbours in the lru list
+    uint32_t chain;
+    uint32_t newer;
+    uint32_t older;
+
+    // runs of (offset: 2 bytes, length: 1 byte, length new bytes)
+    uint8_t delta[MEMO_DELTA_NB];
+};
+
+// frame level memoization of deterministic execution.
+// an instance's next frame only depends on its state and the keys held
+// (the rng is part of the state), so a frame seen before can be replayed
+// by applying the bytes it changed instead of emulating it. entries also
+// remember the hash of the state they lead to, so a run of known frames
+// never has to hash anything.
+// bounded to a fixed number of entries, the least recently used is
+// replaced first. not thread safe, use one per thread
+struct chip8_memo_t
+{
+    struct chip8_memo_entry_t *entries;
+    size_t nb;
+    size_t used;
+
+    uint32_t *buckets;
+    size_t buckets_nb;
+
+    uint32_t newest;
+    uint32_t oldest;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t too_big;
+};
+
+// room for nb frames. returns -1 if we're out of memory
+int chip8_memo_t_init(struct chip8_memo_t *memo, size_t nb);
+void chip8_memo_t_destroy(struct chip8_memo_t *memo);
+
+// hash of everything in c8 the next frame depends on, apart from the keys.
+// c8 has to be running rom: pages it never wrote to aren't hashed, the
+// rom's hash stands in for them
+uint64_t chip8_memo_hash(const struct chip8_rom_t *rom, const union chip8_t *c8);
+
+// run one frame of c8 with keys held, from the cache if possible.
+// c8 has to be running pd's rom, any number of roms can share a memo.
+// *hash is the hash of c8, carried over from one call to the next. set it
+// to 0 when starting out or after changing c8 some other way
+void chip8_memo_t_frame(struct chip8_memo_t *memo, union chip8_t *c8, const struct chip8_predecode_t *pd,
+                        uint16_t keys, uint64_t *hash);
+
+#endif
@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "heatmap.h"
+#include "movie.h"
+#include "predecode.h"
+#include "rom.h"
+
+// memory access profile: runs a rom with the core's heatmap hooks compiled
+// in (make chip8-heatmap builds the core again with CHIP8_HEATMAP), then
+// prints a report and optionally writes the heatmap as an image.
+// exits with 0 if no executed byte was written, 2 if the rom modified code
+// it ran, so it isn't safe for anything that caches decoded instructions
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-heatmap [--frames N] [--keys MASK] [--movie FILE] [--image FILE] ROM\n");
+    exit(1);
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 3600;
+    long keys = 0;
+    const char *movie_path = NULL;
+    const char *image_path = NULL;
+    const char *rom_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            keys = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc)
+        {
+            movie_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc)
+        {
+            image_path = argv[++i];
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || frames < 0)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    // either the keys of a movie, or the same keys for every frame
+    static struct chip8_movie_t m;
+    if (movie_path != NULL)
+    {
+        if (chip8_movie_t_load(&m, movie_path) < 0)
+        {
+            fprintf(stderr, "Could not read movie %s\n", movie_path);
+            return 1;
+        }
+        frames = m.frames_nb;
+    }
+
+    static struct chip8_heatmap_t heatmap;
+    chip8_heatmap = &heatmap;
+
+    union chip8_t c8;
+    chip8_rom_t_boot(rom, &c8);
+    for (long frame = 0; frame < frames; frame++)
+    {
+        chip8_t_set_keys(&c8, movie_path ? m.keys[frame] : keys);
+        for (size_t i = 0; i < CYCLES_PER_FRAME; i++)
+        {
+            chip8_t_emulate_cycle_predecoded(&c8, pd);
+        }
+    }
+    chip8_heatmap = NULL;
+
+    printf("%s, %ld frames\n", rom_path, frames);
+    const size_t modified = chip8_heatmap_t_report(&heatmap, rom->size, stdout);
+
+    int status = modified ? 2 : 0;
+    if (image_path != NULL && chip8_heatmap_t_write_ppm(&heatmap, image_path) < 0)
+    {
+        fprintf(stderr, "Could not write %s\n", image_path);
+        status = 1;
+    }
+
+    chip8_movie_t_destroy(&m);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return status;
+}
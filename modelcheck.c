@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "explore.h"
+#include "predecode.h"
+#include "rom.h"
+#include "watch.h"
+
+// model checker front end: visits every state the rom can reach, level by
+// level, and stops at the first bad PC, stack overflow or underflow, or
+// state where --bad is true, printing the inputs that lead there.
+// exits with 0 if every reachable state was visited without finding one,
+// 2 on a violation and 3 if it stopped at a limit first
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-explore [--depth N] [--max-states N] [--hold FRAMES] [--threads N]\n");
+    fprintf(stderr, "                       [--actions MASK,MASK,...] [--bad EXPR] ROM\n");
+    exit(1);
+}
+
+int main(int argc, char const *argv[])
+{
+    long depth = 1000;
+    long max_states = 1 << 20;
+    long hold = 1;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *rom_path = NULL;
+
+    struct chip8_watch_t bad;
+    int has_bad = 0;
+
+    // nothing held, or any one key
+    uint16_t actions[64] = {0};
+    size_t actions_nb = 17;
+    for (size_t i = 1; i < actions_nb; i++)
+    {
+        actions[i] = 1 << (i - 1);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            depth = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc)
+        {
+            max_states = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc)
+        {
+            hold = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--actions") == 0 && i + 1 < argc)
+        {
+            const char *p = argv[++i];
+            for (actions_nb = 0; *p != '\0' && actions_nb < 64; actions_nb++)
+            {
+                char *end;
+                actions[actions_nb] = strtol(p, &end, 0);
+                p = *end == ',' ? end + 1 : end;
+                if (end == p && *end != '\0')
+                {
+                    usage();
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--bad") == 0 && i + 1 < argc)
+        {
+            char err[128];
+            if (chip8_watch_t_compile(&bad, argv[++i], err, sizeof(err)) < 0)
+            {
+                fprintf(stderr, "%s\n  %s\n", argv[i], err);
+                return 1;
+            }
+            has_bad = 1;
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || depth <= 0 || max_states <= 0 || hold <= 0 || threads <= 0 || actions_nb == 0)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    static struct chip8_explore_t ex;
+    if (chip8_explore_t_init(&ex, rom, pd, has_bad ? &bad : NULL, actions, actions_nb, hold, max_states) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    enum explore_result result = EXPLORE_DEPTH;
+    while (ex.depth < (size_t)depth)
+    {
+        result = chip8_explore_t_run(&ex, 1, threads);
+        if (result != EXPLORE_DEPTH)
+        {
+            break;
+        }
+        printf("depth %zu: %u states, %u pages\n", ex.depth, atomic_load(&ex.states_nb), atomic_load(&ex.pages_nb));
+        fflush(stdout);
+    }
+
+    int status = 0;
+    if (result == EXPLORE_DONE)
+    {
+        printf("done: all %u reachable states visited, no violations\n", atomic_load(&ex.states_nb));
+    }
+    else if (result == EXPLORE_VIOLATION)
+    {
+        static const char *WHAT[] = {
+            [EXPLORE_BAD_PC] = "PC left the address space",
+            [EXPLORE_OVERFLOW] = "stack overflow",
+            [EXPLORE_UNDERFLOW] = "stack underflow",
+            [EXPLORE_BAD_WATCH] = "--bad is true",
+        };
+        printf("violation at depth %zu: %s, instruction at 0x%03X\n", ex.depth + 1, WHAT[ex.violation], ex.violation_pc);
+
+        uint16_t *keys = malloc((ex.depth + 1) * sizeof(uint16_t));
+        if (keys != NULL)
+        {
+            const size_t nb = chip8_explore_t_trace(&ex, ex.violation_parent, keys);
+            keys[nb] = ex.violation_keys;
+            for (size_t i = 0; i <= nb; i++)
+            {
+                printf("input %zu 0x%04X\n", i * hold, keys[i]);
+            }
+            free(keys);
+        }
+        status = 2;
+    }
+    else
+    {
+        printf("stopped at depth %zu with %u states: %s\n", ex.depth, atomic_load(&ex.states_nb),
+               result == EXPLORE_FULL ? "out of room, raise --max-states" : "depth limit");
+        status = 3;
+    }
+
+    chip8_explore_t_destroy(&ex);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return status;
+}
@@ -0,0 +1,257 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "movie.h"
+
+static const char MOVIE_MAGIC[8] = "CH8MOVIE";
+
+int chip8_movie_t_init(struct chip8_movie_t *m, uint32_t interval)
+{
+    memset(m, 0, sizeof(*m));
+    if (interval == 0)
+    {
+        return -1;
+    }
+    m->interval = interval;
+    return 0;
+}
+
+void chip8_movie_t_destroy(struct chip8_movie_t *m)
+{
+    free(m->keys);
+    free(m->keyframes);
+    memset(m, 0, sizeof(*m));
+}
+
+static int add_keyframe(struct chip8_movie_t *m, const union chip8_t *c8)
+{
+    if (m->keyframes_nb == m->keyframes_cap)
+    {
+        const size_t cap = m->keyframes_cap ? m->keyframes_cap * 2 : 16;
+        struct chip8_movie_keyframe_t *keyframes = realloc(m->keyframes, cap * sizeof(*keyframes));
+        if (keyframes == NULL)
+        {
+            return -1;
+        }
+        m->keyframes = keyframes;
+        m->keyframes_cap = cap;
+    }
+    struct chip8_movie_keyframe_t *k = m->keyframes + m->keyframes_nb++;
+    k->frame = m->frames_nb;
+    k->reserved = 0;
+    k->display_hash = chip8_hash(c8->display, sizeof(c8->display));
+    memcpy(&k->state, c8, sizeof(k->state));
+    return 0;
+}
+
+int chip8_movie_t_record(struct chip8_movie_t *m, const union chip8_t *c8, uint16_t keys)
+{
+    if (m->frames_nb == m->frames_cap)
+    {
+        const size_t cap = m->frames_cap ? m->frames_cap * 2 : 4096;
+        uint16_t *k = realloc(m->keys, cap * sizeof(uint16_t));
+        if (k == NULL)
+        {
+            return -1;
+        }
+        m->keys = k;
+        m->frames_cap = cap;
+    }
+    if (m->frames_nb % m->interval == 0 && add_keyframe(m, c8) < 0)
+    {
+        return -1;
+    }
+    m->keys[m->frames_nb++] = keys;
+    return 0;
+}
+
+int chip8_movie_t_save(struct chip8_movie_t *m, const union chip8_t *c8, const char *path)
+{
+    if ((m->keyframes_nb == 0 || m->keyframes[m->keyframes_nb - 1].frame != m->frames_nb) && add_keyframe(m, c8) < 0)
+    {
+        return -1;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    struct chip8_movie_header_t h;
+    memcpy(h.magic, MOVIE_MAGIC, sizeof(h.magic));
+    h.version = MOVIE_VERSION;
+    h.interval = m->interval;
+    h.frames_nb = m->frames_nb;
+    h.keyframes_nb = m->keyframes_nb;
+    const int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                   fwrite(m->keys, sizeof(uint16_t), m->frames_nb, f) == m->frames_nb &&
+                   fwrite(m->keyframes, sizeof(struct chip8_movie_keyframe_t), m->keyframes_nb, f) == m->keyframes_nb;
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+int chip8_movie_t_load(struct chip8_movie_t *m, const char *path)
+{
+    memset(m, 0, sizeof(*m));
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    struct chip8_movie_header_t h;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, MOVIE_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == MOVIE_VERSION && h.interval > 0 && h.keyframes_nb > 0;
+    if (ok)
+    {
+        m->interval = h.interval;
+        m->frames_nb = m->frames_cap = h.frames_nb;
+        m->keyframes_nb = m->keyframes_cap = h.keyframes_nb;
+        m->keys = malloc((h.frames_nb + 1) * sizeof(uint16_t));
+        m->keyframes = malloc(h.keyframes_nb * sizeof(struct chip8_movie_keyframe_t));
+        ok = m->keys != NULL && m->keyframes != NULL &&
+             fread(m->keys, sizeof(uint16_t), h.frames_nb, f) == h.frames_nb &&
+             fread(m->keyframes, sizeof(struct chip8_movie_keyframe_t), h.keyframes_nb, f) == h.keyframes_nb;
+    }
+    fclose(f);
+
+    // keyframes go from the first frame to the last, in order
+    for (size_t i = 0; ok && i < m->keyframes_nb; i++)
+    {
+        ok = m->keyframes[i].frame <= m->frames_nb && (i == 0 || m->keyframes[i].frame > m->keyframes[i - 1].frame);
+    }
+    if (!ok || m->keyframes[0].frame != 0 || m->keyframes[m->keyframes_nb - 1].frame != m->frames_nb)
+    {
+        chip8_movie_t_destroy(m);
+        return -1;
+    }
+    return 0;
+}
+
+static void run(const struct chip8_movie_t *m, const struct chip8_predecode_t *pd, size_t from, size_t to,
+                union chip8_t *c8)
+{
+    for (size_t frame = from; frame < to; frame++)
+    {
+        chip8_t_set_keys(c8, m->keys[frame]);
+        for (size_t i = 0; i < CYCLES_PER_FRAME; i++)
+        {
+            chip8_t_emulate_cycle_predecoded(c8, pd);
+        }
+    }
+}
+
+int chip8_movie_t_seek(const struct chip8_movie_t *m, const struct chip8_predecode_t *pd, size_t frame,
+                       union chip8_t *c8)
+{
+    if (frame > m->frames_nb)
+    {
+        return -1;
+    }
+    // the last keyframe at or before frame
+    size_t lo = 0;
+    size_t hi = m->keyframes_nb;
+    while (hi - lo > 1)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (m->keyframes[mid].frame <= frame)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    const struct chip8_movie_keyframe_t *k = m->keyframes + lo;
+    memcpy(c8, &k->state, sizeof(*c8));
+    run(m, pd, k->frame, frame, c8);
+    return 0;
+}
+
+// whether c8 is exactly the keyframe. draw_flag belongs to the frontend,
+// which clears it after drawing, so it doesn't count
+static int matches(const struct chip8_movie_keyframe_t *k, union chip8_t *c8)
+{
+    if (chip8_hash(c8->display, sizeof(c8->display)) != k->display_hash)
+    {
+        return 0;
+    }
+    const uint8_t draw_flag = c8->draw_flag;
+    c8->draw_flag = k->state.draw_flag;
+    const int same = memcmp(c8, &k->state, sizeof(*c8)) == 0;
+    c8->draw_flag = draw_flag;
+    return same;
+}
+
+struct verify_t
+{
+    const struct chip8_movie_t *m;
+    const struct chip8_predecode_t *pd;
+    atomic_size_t next;
+    // the first frame found not to match, LONG_MAX while there's none
+    atomic_long bad;
+};
+
+static void *verify_thread(void *arg)
+{
+    struct verify_t *v = arg;
+    const struct chip8_movie_t *m = v->m;
+    union chip8_t c8;
+
+    size_t i;
+    while ((i = atomic_fetch_add_explicit(&v->next, 1, memory_order_relaxed)) + 1 < m->keyframes_nb)
+    {
+        const struct chip8_movie_keyframe_t *end = m->keyframes + i + 1;
+        long bad = atomic_load_explicit(&v->bad, memory_order_relaxed);
+        if ((long)end->frame >= bad)
+        {
+            // stretches are handed out in order, the rest are later still
+            break;
+        }
+
+        memcpy(&c8, &m->keyframes[i].state, sizeof(c8));
+        run(m, v->pd, m->keyframes[i].frame, end->frame, &c8);
+        if (!matches(end, &c8))
+        {
+            while (end->frame < bad && !atomic_compare_exchange_weak_explicit(&v->bad, &bad, end->frame,
+                                                                              memory_order_relaxed, memory_order_relaxed))
+            {
+            }
+        }
+    }
+    return NULL;
+}
+
+long chip8_movie_t_verify(const struct chip8_movie_t *m, const struct chip8_predecode_t *pd, size_t threads_nb)
+{
+    // the movie has to start from a fresh boot of the rom
+    union chip8_t boot;
+    chip8_rom_t_boot(pd->rom, &boot);
+    if (!matches(m->keyframes, &boot))
+    {
+        return 0;
+    }
+
+    struct verify_t v = {.m = m, .pd = pd};
+    atomic_init(&v.next, 0);
+    atomic_init(&v.bad, LONG_MAX);
+
+    pthread_t threads[threads_nb > 1 ? threads_nb - 1 : 1];
+    size_t started = 0;
+    while (started + 1 < threads_nb && pthread_create(threads + started, NULL, verify_thread, &v) == 0)
+    {
+        started++;
+    }
+    verify_thread(&v);
+    for (size_t i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    const long bad = atomic_load(&v.bad);
+    return bad == LONG_MAX ? -1 : bad;
+}
@@ -0,0 +1,83 @@
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+
+enum movie_constants
+{
+    MOVIE_VERSION = 1,
+
+    // 10 seconds between keyframes
+    MOVIE_INTERVAL = 600
+};
+
+// the state before a frame ran, and the hash of its display
+struct chip8_movie_keyframe_t
+{
+    uint32_t frame;
+    uint32_t reserved;
+    uint64_t display_hash;
+    union chip8_t state;
+};
+
+// a movie file is this header, then keys[frames_nb], then the keyframes
+struct chip8_movie_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t interval;
+    uint32_t frames_nb;
+    uint32_t keyframes_nb;
+};
+
+// the keys held for every frame of a run, with a keyframe every interval
+// frames and one at the end. any frame is reached by restoring the
+// keyframe before it and emulating at most interval frames, and the run
+// can be verified one keyframe to the next in parallel: if every stretch
+// ends up exactly at the next keyframe, the whole movie replays from boot
+struct chip8_movie_t
+{
+    uint32_t interval;
+
+    uint16_t *keys;
+    size_t frames_nb;
+    size_t frames_cap;
+
+    struct chip8_movie_keyframe_t *keyframes;
+    size_t keyframes_nb;
+    size_t keyframes_cap;
+};
+
+// start an empty movie. returns -1 if interval is 0
+int chip8_movie_t_init(struct chip8_movie_t *m, uint32_t interval);
+void chip8_movie_t_destroy(struct chip8_movie_t *m);
+
+// note that the next frame of c8 runs with keys held. call it before
+// running the frame. returns -1 if we're out of memory
+int chip8_movie_t_record(struct chip8_movie_t *m, const union chip8_t *c8, uint16_t keys);
+
+// add the keyframe where the run ended and write the movie to path.
+// returns -1 if it can't be written
+int chip8_movie_t_save(struct chip8_movie_t *m, const union chip8_t *c8, const char *path);
+
+// read a movie written by chip8_movie_t_save. returns -1 if it can't be
+// read or isn't a movie
+int chip8_movie_t_load(struct chip8_movie_t *m, const char *path);
+
+// put c8 at the start of a frame, 0 to frames_nb. returns -1 if the movie
+// is shorter
+int chip8_movie_t_seek(const struct chip8_movie_t *m, const struct chip8_predecode_t *pd, size_t frame,
+                       union chip8_t *c8);
+
+// replay the movie between every pair of keyframes on threads_nb threads,
+// checking each stretch ends at the next keyframe, display hash and all.
+// returns the first frame that doesn't match, or -1 if the whole movie
+// replays from rom's boot state
+long chip8_movie_t_verify(const struct chip8_movie_t *m, const struct chip8_predecode_t *pd, size_t threads_nb);
+
+#endif
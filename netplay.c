@@ -0,0 +1,220 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "netplay.h"
+#include "sock.h"
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void chip8_netplay_t_close(struct chip8_netplay_t *np)
+{
+    if (np->fd >= 0)
+    {
+        close(np->fd);
+        np->fd = -1;
+    }
+}
+
+static void chip8_netplay_t_start(struct chip8_netplay_t *np, int fd, const union chip8_t *boot)
+{
+    memset(np, 0, sizeof(struct chip8_netplay_t));
+    np->fd = fd;
+    memcpy(&np->state, boot, sizeof(union chip8_t));
+}
+
+// both sides have to start from the same state, so before anything else
+// we swap hashes of it
+static int chip8_netplay_t_handshake(struct chip8_netplay_t *np)
+{
+    uint64_t hash = chip8_hash(&np->state, sizeof(union chip8_t));
+    uint64_t peer_hash;
+    if (send(np->fd, &hash, sizeof(hash), 0) != sizeof(hash) ||
+        recv(np->fd, &peer_hash, sizeof(peer_hash), 0) != sizeof(peer_hash) ||
+        hash != peer_hash)
+    {
+        chip8_netplay_t_close(np);
+        return -1;
+    }
+    return 0;
+}
+
+int chip8_netplay_t_pair(struct chip8_netplay_t *a, struct chip8_netplay_t *b, const union chip8_t *boot)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+    {
+        return -1;
+    }
+
+    // both ends are in this process and start from the same state,
+    // so there's nothing to check
+    chip8_netplay_t_start(a, fds[0], boot);
+    chip8_netplay_t_start(b, fds[1], boot);
+    return 0;
+}
+
+int chip8_netplay_t_host(struct chip8_netplay_t *np, const char *path, const union chip8_t *boot)
+{
+    int listener = sock_listen_unix(path, SOCK_SEQPACKET);
+    if (listener < 0)
+    {
+        return -1;
+    }
+
+    int fd = accept(listener, NULL, NULL);
+    close(listener);
+    unlink(path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    chip8_netplay_t_start(np, fd, boot);
+    return chip8_netplay_t_handshake(np);
+}
+
+int chip8_netplay_t_join(struct chip8_netplay_t *np, const char *path, const union chip8_t *boot)
+{
+    int fd = sock_connect_unix(path, SOCK_SEQPACKET);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    chip8_netplay_t_start(np, fd, boot);
+    return chip8_netplay_t_handshake(np);
+}
+
+// send every queued packet whose delay is up
+static int chip8_netplay_t_flush(struct chip8_netplay_t *np, int64_t now)
+{
+    while (np->queue_nb > 0 && np->queue_due[np->queue_head] <= now)
+    {
+        const struct chip8_netplay_packet_t *packet = np->queue + np->queue_head;
+        if (send(np->fd, packet, sizeof(*packet), MSG_DONTWAIT) < 0)
+        {
+            // socket buffer is full, try again next frame
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        np->queue_head = (np->queue_head + 1) % NETPLAY_QUEUE_NB;
+        np->queue_nb -= 1;
+    }
+    return 0;
+}
+
+static int chip8_netplay_t_send(struct chip8_netplay_t *np, uint32_t frame, uint16_t keys)
+{
+    int64_t now = now_ns();
+
+    // a full queue means the delay is far longer than the rollback window
+    // can cover anyway, so push the oldest packet out early
+    if (np->queue_nb == NETPLAY_QUEUE_NB && chip8_netplay_t_flush(np, INT64_MAX) < 0)
+    {
+        return -1;
+    }
+    if (np->queue_nb == NETPLAY_QUEUE_NB)
+    {
+        return 0;
+    }
+
+    size_t tail = (np->queue_head + np->queue_nb) % NETPLAY_QUEUE_NB;
+    np->queue[tail].frame = frame;
+    np->queue[tail].keys = keys;
+    np->queue_due[tail] = now + np->delay_ns;
+    np->queue_nb += 1;
+
+    return chip8_netplay_t_flush(np, now);
+}
+
+// read everything the peer sent and return the first frame we guessed
+// its keys wrong for, or np->frame if every guess was right
+static int64_t chip8_netplay_t_receive(struct chip8_netplay_t *np)
+{
+    int64_t rollback = np->frame;
+    struct chip8_netplay_packet_t packet;
+
+    for (;;)
+    {
+        ssize_t size = recv(np->fd, &packet, sizeof(packet), MSG_DONTWAIT);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (size != sizeof(packet) || packet.frame != np->confirmed)
+        {
+            // closed, or out of order which a seqpacket socket never does
+            return -1;
+        }
+
+        const size_t slot = packet.frame % NETPLAY_REMOTE_NB;
+        if (packet.frame < np->frame && np->remote[slot] != packet.keys && packet.frame < rollback)
+        {
+            rollback = packet.frame;
+        }
+        np->remote[slot] = packet.keys;
+        np->last_remote = packet.keys;
+        np->confirmed = packet.frame + 1;
+    }
+    return rollback;
+}
+
+static void chip8_netplay_t_run(struct chip8_netplay_t *np, uint32_t frame)
+{
+    const size_t slot = frame % NETPLAY_FRAMES;
+    const size_t remote = frame % NETPLAY_REMOTE_NB;
+
+    memcpy(np->saved + slot, &np->state, sizeof(union chip8_t));
+    if (frame >= np->confirmed)
+    {
+        // guess the peer is still holding whatever it held last
+        np->remote[remote] = np->last_remote;
+    }
+    chip8_t_set_keys(&np->state, np->local[slot] | np->remote[remote]);
+    chip8_t_run_frames(&np->state, 1);
+}
+
+int chip8_netplay_t_advance(struct chip8_netplay_t *np, uint16_t local_keys)
+{
+    if (chip8_netplay_t_flush(np, now_ns()) < 0)
+    {
+        return -1;
+    }
+
+    int64_t rollback = chip8_netplay_t_receive(np);
+    if (rollback < 0)
+    {
+        return -1;
+    }
+    if (rollback < np->frame)
+    {
+        // go back to the first wrong guess and emulate up to now again.
+        // the window check below guarantees that state is still saved
+        memcpy(&np->state, np->saved + rollback % NETPLAY_FRAMES, sizeof(union chip8_t));
+        for (uint32_t frame = rollback; frame < np->frame; frame++)
+        {
+            chip8_netplay_t_run(np, frame);
+        }
+        np->rollback_frames += np->frame - rollback;
+    }
+
+    // the peer may well be ahead of us, so don't subtract
+    if (np->frame >= np->confirmed + NETPLAY_FRAMES)
+    {
+        return 0;
+    }
+
+    np->local[np->frame % NETPLAY_FRAMES] = local_keys;
+    if (chip8_netplay_t_send(np, np->frame, local_keys) < 0)
+    {
+        return -1;
+    }
+    chip8_netplay_t_run(np, np->frame);
+    np->frame += 1;
+    return 1;
+}
@@ -0,0 +1,88 @@
+#ifndef CHIP8_NETPLAY_H
+#define CHIP8_NETPLAY_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum netplay_constants
+{
+    // how many frames we can run ahead of the last input we got from
+    // the peer. past that we stop and wait for it
+    NETPLAY_FRAMES = 16,
+    // the peer can be NETPLAY_FRAMES ahead of us while we roll back as far
+    // as NETPLAY_FRAMES behind, so remote keys need room for both
+    NETPLAY_REMOTE_NB = 2 * NETPLAY_FRAMES,
+    // outgoing packets held back by the latency shim
+    NETPLAY_QUEUE_NB = 256
+};
+
+// what goes over the wire, one per frame
+struct chip8_netplay_packet_t
+{
+    uint32_t frame;
+    uint16_t keys;
+};
+
+// two players sharing one keypad, each on their own machine.
+// both sides emulate the same rom from the same state, so the only thing
+// they need to exchange is the keys each player holds every frame.
+// instead of waiting for the peer, we guess that it's still holding the
+// same keys as in the last frame we heard about. when the guess turns out
+// to be wrong, we go back to the frame it was wrong for and emulate
+// everything since again with the right keys
+struct chip8_netplay_t
+{
+    // socket to the peer, one packet per message (SOCK_SEQPACKET)
+    int fd;
+
+    // the frame we'll emulate next, and the state it starts from
+    uint32_t frame;
+    union chip8_t state;
+
+    // every frame the peer has sent us keys for is below this,
+    // and these are the last keys it sent
+    uint32_t confirmed;
+    uint16_t last_remote;
+
+    // ring buffers indexed by frame % NETPLAY_FRAMES (remote keys by
+    // frame % NETPLAY_REMOTE_NB): the state each frame started from and
+    // the keys it was emulated with. remote keys past confirmed are guesses
+    union chip8_t saved[NETPLAY_FRAMES];
+    uint16_t local[NETPLAY_FRAMES];
+    uint16_t remote[NETPLAY_REMOTE_NB];
+
+    // latency shim, packets are only sent delay_ns after they're queued
+    long delay_ns;
+    struct chip8_netplay_packet_t queue[NETPLAY_QUEUE_NB];
+    int64_t queue_due[NETPLAY_QUEUE_NB];
+    size_t queue_head;
+    size_t queue_nb;
+
+    // frames emulated again after a wrong guess, for tuning the delay
+    uint64_t rollback_frames;
+};
+
+// set up both sides in one process, connected by a socketpair
+int chip8_netplay_t_pair(struct chip8_netplay_t *a, struct chip8_netplay_t *b, const union chip8_t *boot);
+
+// host a game on a unix socket and wait for the other player to join
+int chip8_netplay_t_host(struct chip8_netplay_t *np, const char *path, const union chip8_t *boot);
+
+// join a game hosted on a unix socket
+int chip8_netplay_t_join(struct chip8_netplay_t *np, const char *path, const union chip8_t *boot);
+
+void chip8_netplay_t_close(struct chip8_netplay_t *np);
+
+// delay every packet we send by this many milliseconds
+static inline void chip8_netplay_t_set_delay(struct chip8_netplay_t *np, long delay_ms)
+{
+    np->delay_ns = delay_ms * 1000000;
+}
+
+// emulate one frame with the local player's keys.
+// returns 1 if a frame was emulated, 0 if we're NETPLAY_FRAMES ahead of
+// the peer and have to wait, and -1 if the peer went away
+int chip8_netplay_t_advance(struct chip8_netplay_t *np, uint16_t local_keys);
+
+#endif
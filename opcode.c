@@ -0,0 +1,143 @@
+#include <string.h>
+
+#include "opcode.h"
+
+static const char *const NAMES[OPCODES_NB] = {
+    "00E0", "00EE", "0nnn", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk", "8xy0", "8xy1",
+    "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE", "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn",
+    "Ex9E", "ExA1", "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65", "????"};
+
+enum chip8_opcode chip8_insn_t_opcode(struct chip8_insn_t in)
+{
+    // the same tests as chip8_t_execute
+    switch (in.op)
+    {
+    case 0x0:
+        return in.n == 0x0 ? OPCODE_CLS : in.n == 0xE ? OPCODE_RET : OPCODE_SYS;
+    case 0x1:
+        return OPCODE_JP;
+    case 0x2:
+        return OPCODE_CALL;
+    case 0x3:
+        return OPCODE_SE_BYTE;
+    case 0x4:
+        return OPCODE_SNE_BYTE;
+    case 0x5:
+        return OPCODE_SE;
+    case 0x6:
+        return OPCODE_LD_BYTE;
+    case 0x7:
+        return OPCODE_ADD_BYTE;
+    case 0x8:
+        if (in.n <= 0x7)
+        {
+            return OPCODE_LD + in.n;
+        }
+        return in.n == 0xE ? OPCODE_SHL : OPCODE_INVALID;
+    case 0x9:
+        return OPCODE_SNE;
+    case 0xA:
+        return OPCODE_LD_I;
+    case 0xB:
+        return OPCODE_JP_V0;
+    case 0xC:
+        return OPCODE_RND;
+    case 0xD:
+        return OPCODE_DRW;
+    case 0xE:
+        return in.kk == 0x9E ? OPCODE_SKP : in.kk == 0xA1 ? OPCODE_SKNP : OPCODE_INVALID;
+    default:
+        switch (in.kk)
+        {
+        case 0x07:
+            return OPCODE_LD_DT_TO;
+        case 0x0A:
+            return OPCODE_LD_K;
+        case 0x15:
+            return OPCODE_LD_DT;
+        case 0x18:
+            return OPCODE_LD_ST;
+        case 0x1E:
+            return OPCODE_ADD_I;
+        case 0x29:
+            return OPCODE_LD_F;
+        case 0x33:
+            return OPCODE_LD_B;
+        case 0x55:
+            return OPCODE_LD_MEM;
+        case 0x65:
+            return OPCODE_LD_REGS;
+        default:
+            return OPCODE_INVALID;
+        }
+    }
+}
+
+const char *chip8_opcode_name(enum chip8_opcode op)
+{
+    return op < OPCODES_NB ? NAMES[op] : NAMES[OPCODE_INVALID];
+}
+
+size_t chip8_rom_t_reachable(const struct chip8_rom_t *rom, uint8_t reachable[MEM_NB])
+{
+    memset(reachable, 0, MEM_NB);
+
+    // every address is pushed at most once, when it's first marked
+    uint16_t stack[MEM_NB];
+    size_t stack_nb = 0;
+    size_t nb = 0;
+    stack[stack_nb++] = PROG_START;
+    reachable[PROG_START] = 1;
+
+    while (stack_nb > 0)
+    {
+        const uint16_t pc = stack[--stack_nb];
+        nb++;
+        if (pc >= MEM_NB - 1)
+        {
+            continue;
+        }
+
+        const struct chip8_insn_t in = chip8_insn_t_decode((rom->image[pc] << 8) | rom->image[pc + 1]);
+        uint16_t next[2];
+        size_t next_nb = 0;
+        switch (chip8_insn_t_opcode(in))
+        {
+        case OPCODE_JP:
+            next[next_nb++] = in.nnn;
+            break;
+        case OPCODE_CALL:
+            // and where it returns to
+            next[next_nb++] = in.nnn;
+            next[next_nb++] = pc + 2;
+            break;
+        case OPCODE_RET:
+        case OPCODE_JP_V0:
+        case OPCODE_SYS:
+        case OPCODE_INVALID:
+            break;
+        case OPCODE_SE_BYTE:
+        case OPCODE_SNE_BYTE:
+        case OPCODE_SE:
+        case OPCODE_SNE:
+        case OPCODE_SKP:
+        case OPCODE_SKNP:
+            next[next_nb++] = pc + 2;
+            next[next_nb++] = pc + 4;
+            break;
+        default:
+            next[next_nb++] = pc + 2;
+            break;
+        }
+
+        for (size_t i = 0; i < next_nb; i++)
+        {
+            if (next[i] >= PROG_START && next[i] < MEM_NB && !reachable[next[i]])
+            {
+                reachable[next[i]] = 1;
+                stack[stack_nb++] = next[i];
+            }
+        }
+    }
+    return nb;
+}
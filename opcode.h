@@ -0,0 +1,66 @@
+#ifndef CHIP8_OPCODE_H
+#define CHIP8_OPCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "rom.h"
+
+// the handlers chip8_t_execute picks between, in the order it tests them.
+// an instruction it doesn't recognise (like 8xy8 or E000) is OPCODE_INVALID,
+// which like OPCODE_SYS only ticks the timers and leaves PC where it is
+enum chip8_opcode
+{
+    OPCODE_CLS,      // 00E0, and every 0nn0
+    OPCODE_RET,      // 00EE, and every 0nnE
+    OPCODE_SYS,      // the rest of 0nnn, ignored
+    OPCODE_JP,       // 1nnn
+    OPCODE_CALL,     // 2nnn
+    OPCODE_SE_BYTE,  // 3xkk
+    OPCODE_SNE_BYTE, // 4xkk
+    OPCODE_SE,       // 5xy0, and 5xyn
+    OPCODE_LD_BYTE,  // 6xkk
+    OPCODE_ADD_BYTE, // 7xkk
+    OPCODE_LD,       // 8xy0
+    OPCODE_OR,       // 8xy1
+    OPCODE_AND,      // 8xy2
+    OPCODE_XOR,      // 8xy3
+    OPCODE_ADD,      // 8xy4
+    OPCODE_SUB,      // 8xy5
+    OPCODE_SHR,      // 8xy6
+    OPCODE_SUBN,     // 8xy7
+    OPCODE_SHL,      // 8xyE
+    OPCODE_SNE,      // 9xy0, and 9xyn
+    OPCODE_LD_I,     // Annn
+    OPCODE_JP_V0,    // Bnnn
+    OPCODE_RND,      // Cxkk
+    OPCODE_DRW,      // Dxyn
+    OPCODE_SKP,      // Ex9E
+    OPCODE_SKNP,     // ExA1
+    OPCODE_LD_DT_TO, // Fx07
+    OPCODE_LD_K,     // Fx0A
+    OPCODE_LD_DT,    // Fx15
+    OPCODE_LD_ST,    // Fx18
+    OPCODE_ADD_I,    // Fx1E
+    OPCODE_LD_F,     // Fx29
+    OPCODE_LD_B,     // Fx33
+    OPCODE_LD_MEM,   // Fx55
+    OPCODE_LD_REGS,  // Fx65
+    OPCODE_INVALID,
+    OPCODES_NB
+};
+
+// the opcode of an instruction decoded by chip8_insn_t_decode
+enum chip8_opcode chip8_insn_t_opcode(struct chip8_insn_t in);
+
+// the pattern of an opcode as in the comments of chip8.c, "8xy4"
+const char *chip8_opcode_name(enum chip8_opcode op);
+
+// mark every address that control flow can reach from PROG_START without
+// running the rom: jumps, calls, both sides of skips and falling through
+// to the next instruction. Bnnn and RET end a path since where they go
+// depends on the state, and so do the instructions that never move PC. returns the number of addresses marked
+size_t chip8_rom_t_reachable(const struct chip8_rom_t *rom, uint8_t reachable[MEM_NB]);
+
+#endif
@@ -0,0 +1,380 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "opcode.h"
+#include "predecode.h"
+#include "rom.h"
+
+// opcode statistics over a corpus of roms, to pick the sequences worth
+// fusing into one handler. for every rom it counts
+//   sites  reachable instructions (see chip8_rom_t_reachable), and pairs and
+//          triples of them that follow each other in straight line code
+//   share  the instructions run in a headless run of --frames frames, and
+//          pairs and triples run one after the other, as a fraction of
+//          that rom's run so every rom weighs the same
+// and prints the opcodes, pairs and triples with the biggest share over
+// all the roms, which can be files or directories of them
+
+enum opstats_constants
+{
+    PAIRS_NB = OPCODES_NB * OPCODES_NB,
+    TRIPLES_NB = PAIRS_NB * OPCODES_NB,
+
+    // opcodes, then pairs, then triples
+    ENTRIES_NB = OPCODES_NB + PAIRS_NB + TRIPLES_NB,
+
+    // frames each key is held for in the headless runs
+    HOLD_FRAMES = 30
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-opstats [--frames N] [--top N] [--threads N] ROM|DIR...\n");
+    exit(1);
+}
+
+struct stats_t
+{
+    double share[ENTRIES_NB];
+    uint64_t sites[ENTRIES_NB];
+    // roms that ran it at all
+    uint32_t roms[ENTRIES_NB];
+    size_t roms_nb;
+    uint64_t cycles;
+};
+
+struct corpus_t
+{
+    char **paths;
+    size_t paths_nb;
+    size_t paths_cap;
+
+    long frames;
+    atomic_size_t next;
+
+    pthread_mutex_t lock;
+    struct stats_t *total;
+};
+
+static size_t pair(enum chip8_opcode a, enum chip8_opcode b)
+{
+    return OPCODES_NB + a * OPCODES_NB + b;
+}
+
+static size_t triple(enum chip8_opcode a, enum chip8_opcode b, enum chip8_opcode c)
+{
+    return OPCODES_NB + PAIRS_NB + (a * OPCODES_NB + b) * OPCODES_NB + c;
+}
+
+static enum chip8_opcode opcode_at(const uint8_t *memory, uint16_t addr)
+{
+    return chip8_insn_t_opcode(chip8_insn_t_decode((memory[addr] << 8) | memory[addr + 1]));
+}
+
+// whether the instruction after this one in memory can run right after it
+static int falls_through(enum chip8_opcode op)
+{
+    return op != OPCODE_JP && op != OPCODE_CALL && op != OPCODE_RET && op != OPCODE_JP_V0 && op != OPCODE_SYS &&
+           op != OPCODE_INVALID;
+}
+
+static void count_sites(const struct chip8_rom_t *rom, struct stats_t *s)
+{
+    uint8_t reachable[MEM_NB];
+    chip8_rom_t_reachable(rom, reachable);
+    for (size_t addr = PROG_START; addr < MEM_NB - 1; addr++)
+    {
+        if (!reachable[addr])
+        {
+            continue;
+        }
+        const enum chip8_opcode a = opcode_at(rom->image, addr);
+        s->sites[a]++;
+        if (addr + 3 >= MEM_NB || !falls_through(a) || !reachable[addr + 2])
+        {
+            continue;
+        }
+        const enum chip8_opcode b = opcode_at(rom->image, addr + 2);
+        s->sites[pair(a, b)]++;
+        if (addr + 5 >= MEM_NB || !falls_through(b) || !reachable[addr + 4])
+        {
+            continue;
+        }
+        s->sites[triple(a, b, opcode_at(rom->image, addr + 4))]++;
+    }
+}
+
+// a short headless run, pressing each key in turn to get through menus
+static void count_run(const struct chip8_predecode_t *pd, long frames, uint32_t *counts, struct stats_t *s)
+{
+    memset(counts, 0, ENTRIES_NB * sizeof(uint32_t));
+
+    union chip8_t c8;
+    chip8_rom_t_boot(pd->rom, &c8);
+    enum chip8_opcode prev[2] = {OPCODES_NB, OPCODES_NB};
+    uint64_t cycles = 0;
+    for (long frame = 0; frame < frames; frame++)
+    {
+        const size_t hold = frame / HOLD_FRAMES;
+        chip8_t_set_keys(&c8, hold % 2 ? 1 << (hold / 2 % 16) : 0);
+        for (size_t i = 0; i < CYCLES_PER_FRAME; i++)
+        {
+            if (c8.PC >= MEM_NB - 1)
+            {
+                // ran off the end, there's nothing more to count
+                frame = frames;
+                break;
+            }
+            const enum chip8_opcode op = opcode_at(c8.memory, c8.PC);
+            counts[op]++;
+            if (prev[1] != OPCODES_NB)
+            {
+                counts[pair(prev[1], op)]++;
+                if (prev[0] != OPCODES_NB)
+                {
+                    counts[triple(prev[0], prev[1], op)]++;
+                }
+            }
+            prev[0] = prev[1];
+            prev[1] = op;
+            cycles++;
+            chip8_t_emulate_cycle_predecoded(&c8, pd);
+        }
+    }
+
+    // each of the three tables adds up to one
+    uint64_t totals[3] = {0};
+    for (size_t e = 0; e < ENTRIES_NB; e++)
+    {
+        totals[(e >= OPCODES_NB) + (e >= OPCODES_NB + PAIRS_NB)] += counts[e];
+    }
+    for (size_t e = 0; e < ENTRIES_NB; e++)
+    {
+        if (counts[e] != 0)
+        {
+            s->share[e] += (double)counts[e] / totals[(e >= OPCODES_NB) + (e >= OPCODES_NB + PAIRS_NB)];
+            s->roms[e]++;
+        }
+    }
+    s->cycles += cycles;
+}
+
+static void *scan_thread(void *arg)
+{
+    struct corpus_t *c = arg;
+    struct stats_t *s = calloc(1, sizeof(struct stats_t));
+    uint32_t *counts = malloc(ENTRIES_NB * sizeof(uint32_t));
+    if (s == NULL || counts == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    size_t i;
+    while ((i = atomic_fetch_add_explicit(&c->next, 1, memory_order_relaxed)) < c->paths_nb)
+    {
+        struct chip8_rom_t *rom = chip8_rom_t_load(c->paths[i]);
+        struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+        if (pd == NULL)
+        {
+            fprintf(stderr, "Could not open ROM %s\n", c->paths[i]);
+            chip8_rom_t_release(rom);
+            continue;
+        }
+        count_sites(rom, s);
+        count_run(pd, c->frames, counts, s);
+        s->roms_nb++;
+        chip8_predecode_t_release(pd);
+        chip8_rom_t_release(rom);
+    }
+
+    pthread_mutex_lock(&c->lock);
+    for (size_t e = 0; e < ENTRIES_NB; e++)
+    {
+        c->total->share[e] += s->share[e];
+        c->total->sites[e] += s->sites[e];
+        c->total->roms[e] += s->roms[e];
+    }
+    c->total->roms_nb += s->roms_nb;
+    c->total->cycles += s->cycles;
+    pthread_mutex_unlock(&c->lock);
+
+    free(counts);
+    free(s);
+    return NULL;
+}
+
+static void add_path(struct corpus_t *c, const char *path)
+{
+    if (c->paths_nb == c->paths_cap)
+    {
+        c->paths_cap = c->paths_cap ? c->paths_cap * 2 : 256;
+        c->paths = realloc(c->paths, c->paths_cap * sizeof(char *));
+    }
+    if (c->paths == NULL || (c->paths[c->paths_nb++] = strdup(path)) == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+}
+
+// a rom, or every file in a directory and the directories below it
+static void add_roms(struct corpus_t *c, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        add_path(c, path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        char child[4096];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        add_roms(c, child);
+    }
+    closedir(dir);
+}
+
+static struct stats_t *sort_stats;
+
+static int compare_share(const void *a, const void *b)
+{
+    const double x = sort_stats->share[*(const size_t *)a];
+    const double y = sort_stats->share[*(const size_t *)b];
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void print_table(const char *title, struct stats_t *s, size_t from, size_t nb, size_t top)
+{
+    static size_t order[TRIPLES_NB];
+    for (size_t i = 0; i < nb; i++)
+    {
+        order[i] = from + i;
+    }
+    sort_stats = s;
+    qsort(order, nb, sizeof(order[0]), compare_share);
+
+    printf("\n%s\n  %-16s %8s %10s %6s\n", title, "", "share", "sites", "roms");
+    for (size_t i = 0; i < nb && i < top && s->share[order[i]] > 0; i++)
+    {
+        // back to the opcodes the entry is made of
+        size_t e = order[i] - from;
+        const size_t len = from == 0 ? 1 : from == OPCODES_NB ? 2 : 3;
+        enum chip8_opcode ops[3];
+        for (size_t j = len; j-- > 0;)
+        {
+            ops[j] = e % OPCODES_NB;
+            e /= OPCODES_NB;
+        }
+        char name[16] = "";
+        for (size_t j = 0; j < len; j++)
+        {
+            strcat(name, j ? " " : "");
+            strcat(name, chip8_opcode_name(ops[j]));
+        }
+        printf("  %-16s %7.3f%% %10llu %6u\n", name, 100 * s->share[order[i]] / s->roms_nb,
+               (unsigned long long)s->sites[order[i]], s->roms[order[i]]);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 600;
+    long top = 20;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    static struct corpus_t c;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+        {
+            top = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (argv[i][0] != '-')
+        {
+            add_roms(&c, argv[i]);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (c.paths_nb == 0 || frames < 0 || top <= 0 || threads <= 0)
+    {
+        usage();
+    }
+
+    c.frames = frames;
+    c.total = calloc(1, sizeof(struct stats_t));
+    if (c.total == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    atomic_init(&c.next, 0);
+    pthread_mutex_init(&c.lock, NULL);
+
+    pthread_t workers[threads > 1 ? threads - 1 : 1];
+    long started = 0;
+    while (started + 1 < threads && pthread_create(workers + started, NULL, scan_thread, &c) == 0)
+    {
+        started++;
+    }
+    scan_thread(&c);
+    for (long i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    struct stats_t *s = c.total;
+    if (s->roms_nb == 0)
+    {
+        return 1;
+    }
+    printf("%zu roms, %llu instructions run\n", s->roms_nb, (unsigned long long)s->cycles);
+    print_table("opcodes", s, 0, OPCODES_NB, top);
+    print_table("pairs", s, OPCODES_NB, PAIRS_NB, top);
+    print_table("triples", s, OPCODES_NB + PAIRS_NB, TRIPLES_NB, top);
+
+    for (size_t i = 0; i < c.paths_nb; i++)
+    {
+        free(c.paths[i]);
+    }
+    free(c.paths);
+    free(s);
+    return 0;
+}
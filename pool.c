@@ -0,0 +1,45 @@
+#include <string.h>
+
+#include "pool.h"
+
+int chip8_pool_t_init(struct chip8_pool_t *pool, struct chip8_rom_t *rom, size_t nb, int flags)
+{
+    pool->pd = chip8_predecode_t_acquire(rom);
+    if (pool->pd == NULL)
+    {
+        return -1;
+    }
+    if (chip8_slab_t_init(&pool->slab, nb, flags) < 0)
+    {
+        chip8_predecode_t_release(pool->pd);
+        return -1;
+    }
+    pool->rom = chip8_rom_t_retain(rom);
+    chip8_rom_t_boot(rom, &pool->boot);
+
+    // writing every instance now also faults its page in, so the
+    // first session on it doesn't pay for that either
+    for (size_t i = 0; i < nb; i++)
+    {
+        memcpy(pool->slab.states + i, &pool->boot, sizeof(union chip8_t));
+    }
+    return 0;
+}
+
+void chip8_pool_t_destroy(struct chip8_pool_t *pool)
+{
+    chip8_slab_t_destroy(&pool->slab);
+    chip8_predecode_t_release(pool->pd);
+    chip8_rom_t_release(pool->rom);
+}
+
+union chip8_t *chip8_pool_t_acquire(struct chip8_pool_t *pool)
+{
+    return chip8_slab_t_alloc(&pool->slab);
+}
+
+void chip8_pool_t_release(struct chip8_pool_t *pool, union chip8_t *c8)
+{
+    memcpy(c8, &pool->boot, sizeof(union chip8_t));
+    chip8_slab_t_free(&pool->slab, c8);
+}
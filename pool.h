@@ -0,0 +1,35 @@
+#ifndef CHIP8_POOL_H
+#define CHIP8_POOL_H
+
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+#include "slab.h"
+
+// instances of one rom kept ready to run.
+// every free instance already holds the boot state (fonts and rom loaded,
+// PC at PROG_START) and the rom is predecoded, so starting a session is
+// just popping one off the slab. the 4 KB reset happens when a session
+// ends instead, off the latency-critical path
+struct chip8_pool_t
+{
+    struct chip8_rom_t *rom;
+    struct chip8_predecode_t *pd;
+    struct chip8_slab_t slab;
+
+    // what every instance is reset to
+    union chip8_t boot;
+};
+
+// make nb warm instances of rom, flags are passed on to the slab.
+// takes a reference to rom. returns 0 on success, -1 on failure
+int chip8_pool_t_init(struct chip8_pool_t *pool, struct chip8_rom_t *rom, size_t nb, int flags);
+void chip8_pool_t_destroy(struct chip8_pool_t *pool);
+
+// a ready to run instance, or NULL if all of them are in use
+union chip8_t *chip8_pool_t_acquire(struct chip8_pool_t *pool);
+
+// reset the instance to the boot state and make it available again
+void chip8_pool_t_release(struct chip8_pool_t *pool, union chip8_t *c8);
+
+#endif
@@ -0,0 +1,131 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "predecode.h"
+
+enum predecode_constants
+{
+    REGISTRY_NB = 64
+};
+
+// caches currently in use, chained by rom hash.
+// only touched when an instance starts or stops, so one lock is enough
+static struct chip8_predecode_t *registry[REGISTRY_NB];
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct chip8_predecode_t *chip8_predecode_t_build(struct chip8_rom_t *rom)
+{
+    struct chip8_predecode_t *pd = malloc(sizeof(struct chip8_predecode_t));
+    if (pd == NULL)
+    {
+        return NULL;
+    }
+
+    pd->rom = chip8_rom_t_retain(rom);
+    atomic_init(&pd->refs, 1);
+    pd->next = NULL;
+
+    memset(pd->insns, 0, sizeof(pd->insns));
+    for (size_t addr = PROG_START; addr < MEM_NB - 1; addr++)
+    {
+        const uint16_t instruction = (rom->image[addr] << 8) | rom->image[addr + 1];
+        pd->insns[addr] = chip8_insn_t_decode(instruction);
+    }
+    return pd;
+}
+
+struct chip8_predecode_t *chip8_predecode_t_acquire(struct chip8_rom_t *rom)
+{
+    const size_t bucket = rom->hash % REGISTRY_NB;
+
+    pthread_mutex_lock(&registry_lock);
+
+    struct chip8_predecode_t *pd = registry[bucket];
+    while (pd != NULL)
+    {
+        // same hash isn't enough, make sure it's really the same program
+        if (pd->rom == rom ||
+            (pd->rom->hash == rom->hash &&
+             memcmp(pd->rom->image + PROG_START, rom->image + PROG_START, MEM_NB - PROG_START) == 0))
+        {
+            atomic_fetch_add_explicit(&pd->refs, 1, memory_order_relaxed);
+            break;
+        }
+        pd = pd->next;
+    }
+
+    if (pd == NULL)
+    {
+        pd = chip8_predecode_t_build(rom);
+        if (pd != NULL)
+        {
+            pd->next = registry[bucket];
+            registry[bucket] = pd;
+        }
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return pd;
+}
+
+void chip8_predecode_t_release(struct chip8_predecode_t *pd)
+{
+    if (pd == NULL)
+    {
+        return;
+    }
+
+    // dropping the last reference has to happen under the lock,
+    // otherwise acquire could hand out a cache that's being freed
+    pthread_mutex_lock(&registry_lock);
+    if (atomic_fetch_sub_explicit(&pd->refs, 1, memory_order_acq_rel) == 1)
+    {
+        struct chip8_predecode_t **link = &registry[pd->rom->hash % REGISTRY_NB];
+        while (*link != pd)
+        {
+            link = &(*link)->next;
+        }
+        *link = pd->next;
+    }
+    else
+    {
+        pd = NULL;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (pd != NULL)
+    {
+        chip8_rom_t_release(pd->rom);
+        free(pd);
+    }
+}
+
+void chip8_t_emulate_cycle_predecoded(union chip8_t *c8, const struct chip8_predecode_t *pd)
+{
+    const uint16_t pc = c8->PC;
+
+    if (pc >= PROG_START && pc < MEM_NB - 1 && !(c8->dirty_pages & chip8_page_mask(pc, 2)))
+    {
+        chip8_t_execute(c8, pd->insns[pc]);
+    }
+    else
+    {
+        // self-modified or outside the rom, decode it the usual way
+        chip8_t_emulate_cycle(c8);
+    }
+}
+
+void chip8_cow_t_emulate_cycle_predecoded(struct chip8_cow_t *cow, const struct chip8_predecode_t *pd)
+{
+    const uint16_t pc = chip8_cow_t_regs(cow)->PC;
+
+    if (pc >= PROG_START && pc < MEM_NB - 1 && !(cow->private_pages & chip8_page_mask(pc, 2)))
+    {
+        chip8_cow_t_execute(cow, pd->insns[pc]);
+    }
+    else
+    {
+        chip8_cow_t_emulate_cycle(cow);
+    }
+}
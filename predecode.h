@@ -0,0 +1,43 @@
+#ifndef CHIP8_PREDECODE_H
+#define CHIP8_PREDECODE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cow.h"
+#include "rom.h"
+
+// every address of a rom, decoded once and shared read-only by all the
+// instances running it.
+// caches are looked up by rom hash, so the decode work and the memory
+// it takes scale with the number of distinct roms rather than instances
+struct chip8_predecode_t
+{
+    // the image this was decoded from, also used to rule out hash collisions
+    struct chip8_rom_t *rom;
+    atomic_uint refs;
+
+    // next cache in the same registry bucket
+    struct chip8_predecode_t *next;
+
+    // one entry per address since PC doesn't have to be even.
+    // only PROG_START and up are filled in, the interpreter area below
+    // it differs between instances
+    struct chip8_insn_t insns[MEM_NB];
+};
+
+// find the cache for rom, decoding it if no other instance has yet.
+// returns NULL if we're out of memory
+struct chip8_predecode_t *chip8_predecode_t_acquire(struct chip8_rom_t *rom);
+void chip8_predecode_t_release(struct chip8_predecode_t *pd);
+
+// like chip8_t_emulate_cycle, but takes the instruction from the cache
+// unless PC is outside the rom or the instance has written to that page
+void chip8_t_emulate_cycle_predecoded(union chip8_t *c8, const struct chip8_predecode_t *pd);
+
+// same for an instance with shared rom pages, where any private page
+// may have been written to
+void chip8_cow_t_emulate_cycle_predecoded(struct chip8_cow_t *cow, const struct chip8_predecode_t *pd);
+
+#endif
@@ -0,0 +1,805 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../chip8.h"
+#include "../predecode.h"
+#include "../rom.h"
+#include "../watch.h"
+
+// Python bindings for the core.
+// every buffer handed to Python (memory, display, unpacked pixels) points
+// straight into the instances, so memoryview and numpy.asarray never copy.
+// the unpacked pixels are only recomputed when a view of them is requested
+// after the instance ran
+
+enum module_constants
+{
+    DISPLAY_NB = 32 * 64 / 8,
+    PIXELS_NB = 32 * 64,
+    DISPLAY_OFFSET = offsetof(union chip8_t, display)
+};
+
+// every page a program can be in. stepping runs the rom's predecoded
+// instructions on pages that aren't dirty, so anything Python may have
+// written to marks all of them
+static const uint16_t PROGRAM_PAGES = (uint16_t)(0xFFFF << (PROG_START / PAGE_SIZE));
+
+static void unpack_pixels(uint8_t *pixels, const uint8_t *display)
+{
+    for (size_t i = 0; i < PIXELS_NB; i++)
+    {
+        pixels[i] = (display[i / 8] >> (7 - (i % 8))) & 1;
+    }
+}
+
+// rom from either bytes or a path
+static struct chip8_rom_t *rom_from_object(PyObject *obj)
+{
+    struct chip8_rom_t *rom;
+    if (PyUnicode_Check(obj))
+    {
+        PyObject *path;
+        if (!PyUnicode_FSConverter(obj, &path))
+        {
+            return NULL;
+        }
+        rom = chip8_rom_t_load(PyBytes_AS_STRING(path));
+        Py_DECREF(path);
+        if (rom == NULL)
+        {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, obj);
+        }
+        return rom;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0)
+    {
+        return NULL;
+    }
+    rom = chip8_rom_t_from_bytes(view.buf, view.len);
+    PyBuffer_Release(&view);
+    if (rom == NULL)
+    {
+        PyErr_NoMemory();
+    }
+    return rom;
+}
+
+/*
+ * View: exports part of an instance (or of every instance in a batch)
+ * through the buffer protocol
+ */
+
+typedef void (*refresh_fn)(PyObject *owner);
+
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *owner;
+    refresh_fn refresh;
+    void *buf;
+    int readonly;
+    int ndim;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+} ViewObject;
+
+static int View_getbuffer(ViewObject *self, Py_buffer *view, int flags)
+{
+    if (self->readonly && (flags & PyBUF_WRITABLE))
+    {
+        PyErr_SetString(PyExc_BufferError, "view is read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    if (self->refresh != NULL)
+    {
+        self->refresh(self->owner);
+    }
+
+    Py_ssize_t len = 1;
+    for (int i = 0; i < self->ndim; i++)
+    {
+        len *= self->shape[i];
+    }
+
+    view->obj = Py_NewRef(self);
+    view->buf = self->buf;
+    view->len = len;
+    view->readonly = self->readonly;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    // without strides the consumer assumes the data is contiguous
+    if (!(flags & PyBUF_STRIDES) && self->ndim > 1 && self->strides[0] != self->shape[1] * self->strides[1])
+    {
+        Py_CLEAR(view->obj);
+        PyErr_SetString(PyExc_BufferError, "view is not contiguous");
+        return -1;
+    }
+    return 0;
+}
+
+static void View_dealloc(ViewObject *self)
+{
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyBufferProcs View_as_buffer = {
+    .bf_getbuffer = (getbufferproc)View_getbuffer,
+};
+
+static PyTypeObject ViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "chip8.View",
+    .tp_basicsize = sizeof(ViewObject),
+    .tp_dealloc = (destructor)View_dealloc,
+    .tp_as_buffer = &View_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Zero-copy buffer over emulator state.",
+};
+
+// a memoryview over part of owner
+static PyObject *view_new(PyObject *owner, refresh_fn refresh, void *buf, int readonly,
+                          int ndim, const Py_ssize_t *shape, const Py_ssize_t *strides)
+{
+    ViewObject *view = PyObject_New(ViewObject, &ViewType);
+    if (view == NULL)
+    {
+        return NULL;
+    }
+    view->owner = Py_NewRef(owner);
+    view->refresh = refresh;
+    view->buf = buf;
+    view->readonly = readonly;
+    view->ndim = ndim;
+    for (int i = 0; i < ndim; i++)
+    {
+        view->shape[i] = shape[i];
+        view->strides[i] = strides[i];
+    }
+
+    PyObject *memoryview = PyMemoryView_FromObject((PyObject *)view);
+    Py_DECREF(view);
+    return memoryview;
+}
+
+/*
+ * Chip8: a single instance
+ */
+
+typedef struct
+{
+    PyObject_HEAD
+    struct chip8_rom_t *rom;
+    struct chip8_predecode_t *pd;
+    // bumped whenever the instance may have changed,
+    // pixels are unpacked again when it differs from unpacked
+    uint64_t version;
+    uint64_t unpacked;
+    uint8_t pixels[PIXELS_NB];
+    // a writable view of memory was handed out, Python can write through
+    // it any time, even after a reset
+    int exposed;
+    union chip8_t c8;
+} Chip8Object;
+
+static void Chip8_dealloc(Chip8Object *self)
+{
+    chip8_predecode_t_release(self->pd);
+    chip8_rom_t_release(self->rom);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Chip8_init(Chip8Object *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"rom", NULL};
+    PyObject *rom_obj;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &rom_obj))
+    {
+        return -1;
+    }
+
+    struct chip8_rom_t *rom = rom_from_object(rom_obj);
+    if (rom == NULL)
+    {
+        return -1;
+    }
+    struct chip8_predecode_t *pd = chip8_predecode_t_acquire(rom);
+    if (pd == NULL)
+    {
+        chip8_rom_t_release(rom);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    chip8_predecode_t_release(self->pd);
+    chip8_rom_t_release(self->rom);
+    self->rom = rom;
+    self->pd = pd;
+    chip8_rom_t_boot(rom, &self->c8);
+    self->version = 1;
+    self->unpacked = 0;
+    return 0;
+}
+
+static void Chip8_run(Chip8Object *self, size_t cycles)
+{
+    for (size_t i = 0; i < cycles; i++)
+    {
+        chip8_t_emulate_cycle_predecoded(&self->c8, self->pd);
+    }
+    self->version += 1;
+}
+
+static PyObject *Chip8_reset(Chip8Object *self, PyObject *Py_UNUSED(ignored))
+{
+    chip8_rom_t_boot(self->rom, &self->c8);
+    if (self->exposed)
+    {
+        self->c8.dirty_pages |= PROGRAM_PAGES;
+    }
+    self->version += 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Chip8_step(Chip8Object *self, PyObject *args)
+{
+    Py_ssize_t cycles = 1;
+    if (!PyArg_ParseTuple(args, "|n", &cycles))
+    {
+        return NULL;
+    }
+    if (cycles < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "cycles must not be negative");
+        return NULL;
+    }
+    Chip8_run(self, cycles);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Chip8_run_frames(Chip8Object *self, PyObject *args)
+{
+    Py_ssize_t frames = 1;
+    if (!PyArg_ParseTuple(args, "|n", &frames))
+    {
+        return NULL;
+    }
+    if (frames < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "frames must not be negative");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    Chip8_run(self, (size_t)frames * CYCLES_PER_FRAME);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Chip8_save_state(Chip8Object *self, PyObject *Py_UNUSED(ignored))
+{
+    return PyBytes_FromStringAndSize((const char *)self->c8.memory, sizeof(union chip8_t));
+}
+
+static int load_state(union chip8_t *c8, PyObject *state)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(state, &view, PyBUF_SIMPLE) < 0)
+    {
+        return -1;
+    }
+    if (view.len != sizeof(union chip8_t))
+    {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "state must be %zu bytes", sizeof(union chip8_t));
+        return -1;
+    }
+    memcpy(c8, view.buf, sizeof(union chip8_t));
+    PyBuffer_Release(&view);
+    // it may have been saved from another rom
+    c8->dirty_pages |= PROGRAM_PAGES;
+    return 0;
+}
+
+static PyObject *Chip8_load_state(Chip8Object *self, PyObject *state)
+{
+    if (load_state(&self->c8, state) < 0)
+    {
+        return NULL;
+    }
+    self->version += 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Chip8_get_keys(Chip8Object *self, void *Py_UNUSED(closure))
+{
+    return PyLong_FromUnsignedLong(chip8_t_get_keys(&self->c8));
+}
+
+static int Chip8_set_keys(Chip8Object *self, PyObject *value, void *Py_UNUSED(closure))
+{
+    unsigned long mask = value == NULL ? (unsigned long)-1 : PyLong_AsUnsignedLong(value);
+    if (mask > 0xFFFF)
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, "keys is a 16-bit mask");
+        }
+        return -1;
+    }
+    chip8_t_set_keys(&self->c8, mask);
+    return 0;
+}
+
+static PyObject *Chip8_get_memory(Chip8Object *self, void *Py_UNUSED(closure))
+{
+    // writable, so the caller is trusted to know what it's poking
+    const Py_ssize_t shape[1] = {sizeof(union chip8_t)};
+    const Py_ssize_t strides[1] = {1};
+    self->exposed = 1;
+    self->c8.dirty_pages |= PROGRAM_PAGES;
+    self->version += 1;
+    return view_new((PyObject *)self, NULL, self->c8.memory, 0, 1, shape, strides);
+}
+
+static PyObject *Chip8_get_display(Chip8Object *self, void *Py_UNUSED(closure))
+{
+    const Py_ssize_t shape[1] = {DISPLAY_NB};
+    const Py_ssize_t strides[1] = {1};
+    return view_new((PyObject *)self, NULL, self->c8.display, 1, 1, shape, strides);
+}
+
+static void Chip8_unpack(PyObject *obj)
+{
+    Chip8Object *self = (Chip8Object *)obj;
+    if (self->unpacked != self->version)
+    {
+        unpack_pixels(self->pixels, self->c8.display);
+        self->unpacked = self->version;
+    }
+}
+
+static PyObject *Chip8_get_pixels(Chip8Object *self, void *Py_UNUSED(closure))
+{
+    const Py_ssize_t shape[2] = {32, 64};
+    const Py_ssize_t strides[2] = {64, 1};
+    return view_new((PyObject *)self, Chip8_unpack, self->pixels, 1, 2, shape, strides);
+}
+
+static PyObject *Chip8_get_pc(Chip8Object *self, void *Py_UNUSED(closure))
+{
+    return PyLong_FromLong(self->c8.PC);
+}
+
+static PyMethodDef Chip8_methods[] = {
+    {"reset", (PyCFunction)Chip8_reset, METH_NOARGS, "Go back to the boot state."},
+    {"step", (PyCFunction)Chip8_step, METH_VARARGS, "step(cycles=1): run that many instructions."},
+    {"run_frames", (PyCFunction)Chip8_run_frames, METH_VARARGS, "run_frames(frames=1): run whole frames without holding the GIL."},
+    {"save_state", (PyCFunction)Chip8_save_state, METH_NOARGS, "The whole machine state as bytes."},
+    {"load_state", (PyCFunction)Chip8_load_state, METH_O, "Restore a state returned by save_state."},
+    {NULL},
+};
+
+static PyGetSetDef Chip8_getset[] = {
+    {"keys", (getter)Chip8_get_keys, (setter)Chip8_set_keys, "Held keys as a 16-bit mask, bit i is key i.", NULL},
+    {"memory", (getter)Chip8_get_memory, NULL, "Writable memoryview of the 4 KB address space.", NULL},
+    {"display", (getter)Chip8_get_display, NULL, "memoryview of the 256 byte packed display.", NULL},
+    {"pixels", (getter)Chip8_get_pixels, NULL, "memoryview of the display unpacked to uint8 [32, 64].", NULL},
+    {"pc", (getter)Chip8_get_pc, NULL, "The program counter.", NULL},
+    {NULL},
+};
+
+static PyTypeObject Chip8Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "chip8.Chip8",
+    .tp_basicsize = sizeof(Chip8Object),
+    .tp_dealloc = (destructor)Chip8_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Chip8(rom): one emulator instance, rom is a path or bytes.",
+    .tp_methods = Chip8_methods,
+    .tp_getset = Chip8_getset,
+    .tp_init = (initproc)Chip8_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/*
+ * Batch: n instances of one rom, stepped together
+ */
+
+typedef struct
+{
+    PyObject_HEAD
+    struct chip8_rom_t *rom;
+    struct chip8_predecode_t *pd;
+    Py_ssize_t nb;
+    union chip8_t *states;
+    union chip8_t boot;
+    uint64_t version;
+    uint64_t unpacked;
+    uint8_t *pixels;
+} BatchObject;
+
+static void Batch_dealloc(BatchObject *self)
+{
+    free(self->states);
+    free(self->pixels);
+    chip8_predecode_t_release(self->pd);
+    chip8_rom_t_release(self->rom);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Batch_init(BatchObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"rom", "n", NULL};
+    PyObject *rom_obj;
+    Py_ssize_t nb;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "On", kwlist, &rom_obj, &nb))
+    {
+        return -1;
+    }
+    if (nb <= 0 || self->states != NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, nb <= 0 ? "n must be positive" : "already initialized");
+        return -1;
+    }
+
+    self->rom = rom_from_object(rom_obj);
+    if (self->rom == NULL)
+    {
+        return -1;
+    }
+    self->pd = chip8_predecode_t_acquire(self->rom);
+    self->states = aligned_alloc(sizeof(union chip8_t), nb * sizeof(union chip8_t));
+    self->pixels = malloc(nb * PIXELS_NB);
+    if (self->pd == NULL || self->states == NULL || self->pixels == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    self->nb = nb;
+    chip8_rom_t_boot(self->rom, &self->boot);
+    for (Py_ssize_t i = 0; i < nb; i++)
+    {
+        memcpy(self->states + i, &self->boot, sizeof(union chip8_t));
+    }
+    self->version = 1;
+    self->unpacked = 0;
+    return 0;
+}
+
+static Py_ssize_t Batch_len(BatchObject *self)
+{
+    return self->nb;
+}
+
+static int Batch_index(BatchObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= self->nb)
+    {
+        PyErr_SetString(PyExc_IndexError, "instance index out of range");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Batch_reset(BatchObject *self, PyObject *args)
+{
+    Py_ssize_t i = -1;
+    if (!PyArg_ParseTuple(args, "|n", &i))
+    {
+        return NULL;
+    }
+    if (i == -1)
+    {
+        for (Py_ssize_t j = 0; j < self->nb; j++)
+        {
+            memcpy(self->states + j, &self->boot, sizeof(union chip8_t));
+        }
+    }
+    else
+    {
+        if (Batch_index(self, i) < 0)
+        {
+            return NULL;
+        }
+        memcpy(self->states + i, &self->boot, sizeof(union chip8_t));
+    }
+    self->version += 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Batch_run_frames(BatchObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"frames", "keys", NULL};
+    Py_ssize_t frames = 1;
+    PyObject *keys = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nO", kwlist, &frames, &keys))
+    {
+        return NULL;
+    }
+    if (frames < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "frames must not be negative");
+        return NULL;
+    }
+
+    // keys is one mask for everyone, or a buffer of n uint16 masks
+    if (PyLong_Check(keys))
+    {
+        unsigned long mask = PyLong_AsUnsignedLong(keys);
+        if (mask > 0xFFFF)
+        {
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "keys is a 16-bit mask");
+            }
+            return NULL;
+        }
+        for (Py_ssize_t i = 0; i < self->nb; i++)
+        {
+            chip8_t_set_keys(self->states + i, mask);
+        }
+    }
+    else if (keys != Py_None)
+    {
+        Py_buffer view;
+        if (PyObject_GetBuffer(keys, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        {
+            return NULL;
+        }
+        if (view.itemsize != 2 || view.len != self->nb * 2)
+        {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "keys must be n 16-bit masks");
+            return NULL;
+        }
+        const uint16_t *masks = view.buf;
+        for (Py_ssize_t i = 0; i < self->nb; i++)
+        {
+            chip8_t_set_keys(self->states + i, masks[i]);
+        }
+        PyBuffer_Release(&view);
+    }
+
+    // one instance at a time, its state stays in L1 for the whole run
+    Py_BEGIN_ALLOW_THREADS
+    const size_t cycles = (size_t)frames * CYCLES_PER_FRAME;
+    for (Py_ssize_t i = 0; i < self->nb; i++)
+    {
+        for (size_t j = 0; j < cycles; j++)
+        {
+            chip8_t_emulate_cycle_predecoded(self->states + i, self->pd);
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    self->version += 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Batch_save_state(BatchObject *self, PyObject *args)
+{
+    Py_ssize_t i;
+    if (!PyArg_ParseTuple(args, "n", &i) || Batch_index(self, i) < 0)
+    {
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize((const char *)self->states[i].memory, sizeof(union chip8_t));
+}
+
+static PyObject *Batch_load_state(BatchObject *self, PyObject *args)
+{
+    Py_ssize_t i;
+    PyObject *state;
+    if (!PyArg_ParseTuple(args, "nO", &i, &state) || Batch_index(self, i) < 0)
+    {
+        return NULL;
+    }
+    if (load_state(self->states + i, state) < 0)
+    {
+        return NULL;
+    }
+    self->version += 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Batch_get_states(BatchObject *self, void *Py_UNUSED(closure))
+{
+    const Py_ssize_t shape[2] = {self->nb, sizeof(union chip8_t)};
+    const Py_ssize_t strides[2] = {sizeof(union chip8_t), 1};
+    // the view outlives resets, which copy boot
+    self->boot.dirty_pages |= PROGRAM_PAGES;
+    for (Py_ssize_t i = 0; i < self->nb; i++)
+    {
+        self->states[i].dirty_pages |= PROGRAM_PAGES;
+    }
+    self->version += 1;
+    return view_new((PyObject *)self, NULL, self->states, 0, 2, shape, strides);
+}
+
+static PyObject *Batch_get_displays(BatchObject *self, void *Py_UNUSED(closure))
+{
+    // strided straight over the instances, no gathering
+    const Py_ssize_t shape[2] = {self->nb, DISPLAY_NB};
+    const Py_ssize_t strides[2] = {sizeof(union chip8_t), 1};
+    return view_new((PyObject *)self, NULL, self->states[0].memory + DISPLAY_OFFSET, 1, 2, shape, strides);
+}
+
+static void Batch_unpack(PyObject *obj)
+{
+    BatchObject *self = (BatchObject *)obj;
+    if (self->unpacked != self->version)
+    {
+        for (Py_ssize_t i = 0; i < self->nb; i++)
+        {
+            unpack_pixels(self->pixels + i * PIXELS_NB, self->states[i].display);
+        }
+        self->unpacked = self->version;
+    }
+}
+
+static PyObject *Batch_get_pixels(BatchObject *self, void *Py_UNUSED(closure))
+{
+    const Py_ssize_t shape[3] = {self->nb, 32, 64};
+    const Py_ssize_t strides[3] = {PIXELS_NB, 64, 1};
+    return view_new((PyObject *)self, Batch_unpack, self->pixels, 1, 3, shape, strides);
+}
+
+static PyMethodDef Batch_methods[] = {
+    {"reset", (PyCFunction)Batch_reset, METH_VARARGS, "reset(i=-1): boot instance i, or all of them."},
+    {"run_frames", (PyCFunction)(void (*)(void))Batch_run_frames, METH_VARARGS | METH_KEYWORDS,
+     "run_frames(frames=1, keys=None): run every instance without holding the GIL.\n"
+     "keys is a 16-bit mask for all instances or a buffer of n uint16 masks."},
+    {"save_state", (PyCFunction)Batch_save_state, METH_VARARGS, "save_state(i): state of instance i as bytes."},
+    {"load_state", (PyCFunction)Batch_load_state, METH_VARARGS, "load_state(i, state): restore instance i."},
+    {NULL},
+};
+
+static PyGetSetDef Batch_getset[] = {
+    {"states", (getter)Batch_get_states, NULL, "Writable memoryview of every state, uint8 [n, 4096].", NULL},
+    {"displays", (getter)Batch_get_displays, NULL, "memoryview of every packed display, uint8 [n, 256].", NULL},
+    {"pixels", (getter)Batch_get_pixels, NULL, "memoryview of every display unpacked, uint8 [n, 32, 64].", NULL},
+    {NULL},
+};
+
+static PySequenceMethods Batch_as_sequence = {
+    .sq_length = (lenfunc)Batch_len,
+};
+
+static PyTypeObject BatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "chip8.Batch",
+    .tp_basicsize = sizeof(BatchObject),
+    .tp_dealloc = (destructor)Batch_dealloc,
+    .tp_as_sequence = &Batch_as_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Batch(rom, n): n instances of one rom, stepped together.",
+    .tp_methods = Batch_methods,
+    .tp_getset = Batch_getset,
+    .tp_init = (initproc)Batch_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/*
+ * Watch: a compiled expression over an instance (see watch.h)
+ */
+
+typedef struct
+{
+    PyObject_HEAD
+    struct chip8_watch_t w;
+} WatchObject;
+
+static int Watch_init(WatchObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"expr", NULL};
+    const char *src;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &src))
+    {
+        return -1;
+    }
+
+    char err[128];
+    if (chip8_watch_t_compile(&self->w, src, err, sizeof(err)) < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, err);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Watch_eval(WatchObject *self, PyObject *args)
+{
+    PyObject *target;
+    unsigned long long frame = 0;
+    if (!PyArg_ParseTuple(args, "O|K", &target, &frame))
+    {
+        return NULL;
+    }
+
+    if (PyObject_TypeCheck(target, &Chip8Type))
+    {
+        return PyLong_FromLongLong(chip8_watch_t_eval(&self->w, &((Chip8Object *)target)->c8, frame));
+    }
+    if (PyObject_TypeCheck(target, &BatchType))
+    {
+        BatchObject *batch = (BatchObject *)target;
+        PyObject *values = PyList_New(batch->nb);
+        for (Py_ssize_t i = 0; values != NULL && i < batch->nb; i++)
+        {
+            PyObject *value = PyLong_FromLongLong(chip8_watch_t_eval(&self->w, batch->states + i, frame));
+            if (value == NULL)
+            {
+                Py_CLEAR(values);
+                break;
+            }
+            PyList_SET_ITEM(values, i, value);
+        }
+        return values;
+    }
+
+    PyErr_SetString(PyExc_TypeError, "can only evaluate a Chip8 or a Batch");
+    return NULL;
+}
+
+static PyMethodDef Watch_methods[] = {
+    {"eval", (PyCFunction)Watch_eval, METH_VARARGS,
+     "eval(target, frame=0): the value for a Chip8, or a list of values for a Batch."},
+    {NULL},
+};
+
+static PyTypeObject WatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "chip8.Watch",
+    .tp_basicsize = sizeof(WatchObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Watch(expr): e.g. Watch(\"V[3] == 0 && frame > 60\"), compiled once.",
+    .tp_methods = Watch_methods,
+    .tp_init = (initproc)Watch_init,
+    .tp_new = PyType_GenericNew,
+};
+
+static struct PyModuleDef chip8_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "chip8",
+    .m_doc = "CHIP-8 emulator core.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_chip8(void)
+{
+    if (PyType_Ready(&ViewType) < 0 || PyType_Ready(&Chip8Type) < 0 || PyType_Ready(&BatchType) < 0 ||
+        PyType_Ready(&WatchType) < 0)
+    {
+        return NULL;
+    }
+
+    PyObject *module = PyModule_Create(&chip8_module);
+    if (module == NULL)
+    {
+        return NULL;
+    }
+    if (PyModule_AddObjectRef(module, "Chip8", (PyObject *)&Chip8Type) < 0 ||
+        PyModule_AddObjectRef(module, "Batch", (PyObject *)&BatchType) < 0 ||
+        PyModule_AddObjectRef(module, "Watch", (PyObject *)&WatchType) < 0 ||
+        PyModule_AddIntConstant(module, "CYCLES_PER_FRAME", CYCLES_PER_FRAME) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
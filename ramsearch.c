@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+#include "search.h"
+
+// interactive ram search, reads commands from stdin:
+//   run FRAMES [KEYS]  run with the KEYS mask held, then take a snapshot
+//   snap               take a snapshot without running
+//   eq|ne|inc|dec [N]  keep what was unchanged/changed/increased/decreased
+//                      between each of the last N snapshots (default 2)
+//   val VALUE [N]      keep what equals VALUE in each of the last N (default 1)
+//   list               print the candidates and their latest values
+//   reset              every address is a candidate again
+//   quit
+
+enum ramsearch_constants
+{
+    LIST_NB = 32
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-search [--history SNAPSHOTS] ROM\n");
+    exit(1);
+}
+
+int main(int argc, char const *argv[])
+{
+    long history = 256;
+    const char *rom_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            history = strtol(argv[++i], NULL, 10);
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || history < 2)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    static struct chip8_search_t s;
+    if (chip8_search_t_init(&s, history) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    union chip8_t c8;
+    chip8_rom_t_boot(rom, &c8);
+    chip8_search_t_snapshot(&s, &c8);
+    long frame = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char cmd[16];
+        long a = -1;
+        long b = -1;
+        if (sscanf(line, "%15s %li %li", cmd, &a, &b) < 1)
+        {
+            continue;
+        }
+
+        static const struct
+        {
+            const char *name;
+            enum search_predicate pred;
+        } FILTERS[] = {
+            {"eq", SEARCH_EQUAL},
+            {"ne", SEARCH_CHANGED},
+            {"inc", SEARCH_INCREASED},
+            {"dec", SEARCH_DECREASED},
+        };
+        int filter = -1;
+        for (size_t i = 0; i < sizeof(FILTERS) / sizeof(FILTERS[0]); i++)
+        {
+            if (strcmp(cmd, FILTERS[i].name) == 0)
+            {
+                filter = i;
+            }
+        }
+
+        if (filter >= 0)
+        {
+            printf("%zu candidates\n", chip8_search_t_filter(&s, FILTERS[filter].pred, 0, a < 2 ? 2 : a));
+        }
+        else if (strcmp(cmd, "run") == 0 && a >= 0)
+        {
+            chip8_t_set_keys(&c8, b < 0 ? 0 : b);
+            for (long i = 0; i < a * CYCLES_PER_FRAME; i++)
+            {
+                chip8_t_emulate_cycle_predecoded(&c8, pd);
+            }
+            frame += a;
+            chip8_search_t_snapshot(&s, &c8);
+            printf("frame %ld\n", frame);
+        }
+        else if (strcmp(cmd, "snap") == 0)
+        {
+            chip8_search_t_snapshot(&s, &c8);
+        }
+        else if (strcmp(cmd, "val") == 0 && a >= 0 && a <= 0xFF)
+        {
+            printf("%zu candidates\n", chip8_search_t_filter(&s, SEARCH_VALUE, a, b < 1 ? 1 : b));
+        }
+        else if (strcmp(cmd, "list") == 0)
+        {
+            const uint8_t *last = chip8_search_t_snap(&s, 0);
+            size_t shown = 0;
+            for (size_t addr = chip8_search_t_next(&s, 0); addr < MEM_NB && shown < LIST_NB; addr = chip8_search_t_next(&s, addr + 1))
+            {
+                printf("0x%03zX = %u\n", addr, last[addr]);
+                shown++;
+            }
+            const size_t count = chip8_search_t_count(&s);
+            if (count > shown)
+            {
+                printf("... %zu more\n", count - shown);
+            }
+        }
+        else if (strcmp(cmd, "reset") == 0)
+        {
+            chip8_search_t_reset(&s);
+            chip8_search_t_snapshot(&s, &c8);
+        }
+        else if (strcmp(cmd, "quit") == 0)
+        {
+            break;
+        }
+        else
+        {
+            printf("?\n");
+        }
+        fflush(stdout);
+    }
+
+    chip8_search_t_destroy(&s);
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return 0;
+}
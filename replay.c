@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "movie.h"
+#include "predecode.h"
+#include "rom.h"
+
+// input movies:
+//   --record FILE   read lines of "FRAMES MASK" from stdin, holding the keys
+//                   in MASK for that many frames, and save them as a movie
+//   --verify FILE   replay the movie between keyframes on every core and
+//                   report the first frame that doesn't match
+//   --seek FRAME FILE  print the state at the start of FRAME
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-movie --record FILE [--interval FRAMES] ROM\n");
+    fprintf(stderr, "       ./chip8-movie --verify FILE [--threads N] ROM\n");
+    fprintf(stderr, "       ./chip8-movie --seek FRAME FILE ROM\n");
+    exit(1);
+}
+
+static int record(const char *path, long interval, const struct chip8_predecode_t *pd)
+{
+    static struct chip8_movie_t m;
+    if (chip8_movie_t_init(&m, interval) < 0)
+    {
+        usage();
+    }
+
+    union chip8_t c8;
+    chip8_rom_t_boot(pd->rom, &c8);
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        long frames;
+        long keys;
+        if (sscanf(line, "%li %li", &frames, &keys) != 2)
+        {
+            continue;
+        }
+        for (long i = 0; i < frames; i++)
+        {
+            if (chip8_movie_t_record(&m, &c8, keys) < 0)
+            {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+            chip8_t_set_keys(&c8, keys);
+            for (size_t j = 0; j < CYCLES_PER_FRAME; j++)
+            {
+                chip8_t_emulate_cycle_predecoded(&c8, pd);
+            }
+        }
+    }
+
+    const int status = chip8_movie_t_save(&m, &c8, path);
+    printf("%zu frames, %zu keyframes\n", m.frames_nb, m.keyframes_nb);
+    chip8_movie_t_destroy(&m);
+    if (status < 0)
+    {
+        fprintf(stderr, "Could not write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    const char *record_path = NULL;
+    const char *verify_path = NULL;
+    const char *seek_path = NULL;
+    long seek = -1;
+    long interval = MOVIE_INTERVAL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *rom_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc)
+        {
+            verify_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seek") == 0 && i + 2 < argc)
+        {
+            seek = strtol(argv[++i], NULL, 10);
+            seek_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (rom_path == NULL && argv[i][0] != '-')
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rom_path == NULL || (record_path != NULL) + (verify_path != NULL) + (seek_path != NULL) != 1 ||
+        interval <= 0 || threads <= 0)
+    {
+        usage();
+    }
+
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    struct chip8_predecode_t *pd = rom ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+
+    int status = 0;
+    if (record_path != NULL)
+    {
+        status = record(record_path, interval, pd);
+    }
+    else
+    {
+        const char *path = verify_path ? verify_path : seek_path;
+        static struct chip8_movie_t m;
+        if (chip8_movie_t_load(&m, path) < 0)
+        {
+            fprintf(stderr, "Could not read movie %s\n", path);
+            return 1;
+        }
+
+        if (verify_path != NULL)
+        {
+            const long bad = chip8_movie_t_verify(&m, pd, threads);
+            if (bad < 0)
+            {
+                printf("%zu frames match\n", m.frames_nb);
+            }
+            else
+            {
+                printf("desync by frame %ld\n", bad);
+                status = 2;
+            }
+        }
+        else
+        {
+            union chip8_t c8;
+            if (seek < 0 || chip8_movie_t_seek(&m, pd, seek, &c8) < 0)
+            {
+                fprintf(stderr, "The movie is %zu frames long\n", m.frames_nb);
+                status = 1;
+            }
+            else
+            {
+                printf("frame %ld PC=0x%03X I=0x%03X display %016llX\n", seek, c8.PC, c8.I,
+                       (unsigned long long)chip8_hash(c8.display, sizeof(c8.display)));
+            }
+        }
+        chip8_movie_t_destroy(&m);
+    }
+
+    chip8_predecode_t_release(pd);
+    chip8_rom_t_release(rom);
+    return status;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rom.h"
+
+struct chip8_rom_t *chip8_rom_t_from_bytes(const uint8_t *data, size_t size)
+{
+    struct chip8_rom_t *rom = aligned_alloc(64, sizeof(struct chip8_rom_t));
+    if (rom == NULL)
+    {
+        return NULL;
+    }
+
+    if (size > MEM_NB - PROG_START)
+    {
+        size = MEM_NB - PROG_START;
+    }
+
+    // everything outside of the program is zero, just like a freshly
+    // initialized chip8_t
+    memset(rom->image, 0, MEM_NB);
+    memcpy(rom->image + PROG_START, data, size);
+    rom->size = size;
+    rom->hash = chip8_hash(data, size);
+    atomic_init(&rom->refs, 1);
+    return rom;
+}
+
+struct chip8_rom_t *chip8_rom_t_load(const char *path)
+{
+    uint8_t data[MEM_NB - PROG_START];
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    size_t size = fread(data, sizeof(uint8_t), sizeof(data), file);
+    fclose(file);
+
+    return chip8_rom_t_from_bytes(data, size);
+}
+
+void chip8_rom_t_boot(const struct chip8_rom_t *rom, union chip8_t *c8)
+{
+    chip8_t_init(c8);
+    memcpy(c8->memory + PROG_START, rom->image + PROG_START, MEM_NB - PROG_START);
+}
+
+struct chip8_rom_t *chip8_rom_t_retain(struct chip8_rom_t *rom)
+{
+    atomic_fetch_add_explicit(&rom->refs, 1, memory_order_relaxed);
+    return rom;
+}
+
+void chip8_rom_t_release(struct chip8_rom_t *rom)
+{
+    if (rom == NULL)
+    {
+        return;
+    }
+    // the last owner frees the image
+    if (atomic_fetch_sub_explicit(&rom->refs, 1, memory_order_acq_rel) == 1)
+    {
+        free(rom);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef CHIP8_ROM_H
+#define CHIP8_ROM_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// an immutable rom image shared by every instance running the same rom.
+// the image covers the whole address space so a page of it can be
+// mapped straight into an instance's page table (see cow.h)
+struct chip8_rom_t
+{
+    // FNV-1a of the loaded bytes, used to key caches shared between instances
+    uint64_t hash;
+    // number of bytes loaded at PROG_START
+    size_t size;
+    // number of owners, the image is freed when this reaches zero
+    atomic_uint refs;
+
+    // aligned so each 256 byte page starts on a cache line
+    _Alignas(64) uint8_t image[MEM_NB];
+};
+
+// load a rom file into a new shared image with one reference.
+// returns NULL if the file can't be opened or we're out of memory
+struct chip8_rom_t *chip8_rom_t_load(const char *path);
+
+// same as chip8_rom_t_load, but from bytes that are already in memory
+struct chip8_rom_t *chip8_rom_t_from_bytes(const uint8_t *data, size_t size);
+
+// reset a flat instance and copy the rom into it
+void chip8_rom_t_boot(const struct chip8_rom_t *rom, union chip8_t *c8);
+
+struct chip8_rom_t *chip8_rom_t_retain(struct chip8_rom_t *rom);
+void chip8_rom_t_release(struct chip8_rom_t *rom);
+
+#endif
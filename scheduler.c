@@ -0,0 +1,479 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+size_t chip8_cpus(int *cpus, size_t nb)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0)
+    {
+        return 0;
+    }
+    size_t found = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && found < nb; cpu++)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            cpus[found++] = cpu;
+        }
+    }
+    return found;
+}
+
+int chip8_cpu_node(int cpu)
+{
+    // sysfs links every cpu to its node as cpuN/nodeM
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+    {
+        return 0;
+    }
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (sscanf(entry->d_name, "node%d", &node) == 1)
+        {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+int chip8_pin_thread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+static int push(struct chip8_hosted_t ***list, size_t *nb, size_t *cap, struct chip8_hosted_t *h)
+{
+    if (*nb == *cap)
+    {
+        const size_t new_cap = *cap ? *cap * 2 : 64;
+        struct chip8_hosted_t **l = realloc(*list, new_cap * sizeof(*l));
+        if (l == NULL)
+        {
+            return -1;
+        }
+        *list = l;
+        *cap = new_cap;
+    }
+    (*list)[(*nb)++] = h;
+    return 0;
+}
+
+// give a session that just arrived an instance in our slab. new sessions
+// boot there, moved ones are copied out of their old worker's slab, which
+// gets its instance and its load back. returns -1 if a new session has to
+// wait for room, which its reservation in our load should rule out
+static int start(struct chip8_worker_t *w, struct chip8_hosted_t *h)
+{
+    struct chip8_scheduler_t *s = w->s;
+    pthread_mutex_lock(&w->lock);
+    union chip8_t *c8 = chip8_slab_t_alloc(&w->slab);
+    pthread_mutex_unlock(&w->lock);
+
+    if (c8 == NULL)
+    {
+        if (h->c8 == NULL)
+        {
+            return -1;
+        }
+        // no room after all, keep running it in its old worker's slab,
+        // which still counts it
+        atomic_fetch_sub(&w->load, 1);
+        return 0;
+    }
+    if (h->c8 == NULL)
+    {
+        chip8_rom_t_boot(h->rom, c8);
+    }
+    else
+    {
+        struct chip8_worker_t *old = s->workers + h->worker;
+        memcpy(c8, h->c8, sizeof(union chip8_t));
+        pthread_mutex_lock(&old->lock);
+        chip8_slab_t_free(&old->slab, h->c8);
+        pthread_mutex_unlock(&old->lock);
+        atomic_fetch_sub(&old->load, 1);
+    }
+    h->c8 = c8;
+    h->worker = w - s->workers;
+    return 0;
+}
+
+// the worker whose slab holds the session's instance gets it and its load
+// back, which isn't us if it couldn't move
+static void finish(struct chip8_worker_t *w, struct chip8_hosted_t *h)
+{
+    struct chip8_worker_t *owner = w->s->workers + h->worker;
+    pthread_mutex_lock(&owner->lock);
+    chip8_slab_t_free(&owner->slab, h->c8);
+    pthread_mutex_unlock(&owner->lock);
+    atomic_fetch_sub(&owner->load, 1);
+
+    chip8_predecode_t_release(h->pd);
+    chip8_rom_t_release(h->rom);
+    free(h);
+}
+
+// hand sessions over to another worker, as the balancer asked
+static void give(struct chip8_worker_t *w)
+{
+    const uint64_t give = atomic_exchange(&w->give, 0);
+    if (give == 0)
+    {
+        return;
+    }
+    struct chip8_worker_t *dst = w->s->workers + (give >> 32) - 1;
+    const size_t asked = give & 0xFFFFFFFF;
+    size_t given = 0;
+
+    pthread_mutex_lock(&dst->lock);
+    while (given < asked && w->sessions_nb > 0 &&
+           push(&dst->inbox, &dst->inbox_nb, &dst->inbox_cap, w->sessions[w->sessions_nb - 1]) == 0)
+    {
+        w->sessions_nb--;
+        given++;
+    }
+    pthread_mutex_unlock(&dst->lock);
+
+    // the balancer reserved room for all of them. ours stay in our load
+    // until dst has copied them out of our slab
+    atomic_fetch_sub(&dst->load, asked - given);
+    atomic_fetch_add(&w->s->migrations, given);
+}
+
+static void *worker_thread(void *arg)
+{
+    struct chip8_worker_t *w = arg;
+    struct chip8_scheduler_t *s = w->s;
+
+    chip8_pin_thread(w->cpu);
+    const int ok = chip8_slab_t_init(&w->slab, s->capacity, SLAB_HUGE_PAGES) == 0;
+    if (ok)
+    {
+        // fault every instance in from here, on this node
+        memset(w->slab.states, 0, s->capacity * sizeof(union chip8_t));
+    }
+    pthread_mutex_lock(&s->ready_lock);
+    s->ready_nb++;
+    s->failed_nb += !ok;
+    pthread_cond_signal(&s->ready_cond);
+    pthread_mutex_unlock(&s->ready_lock);
+    if (!ok)
+    {
+        return NULL;
+    }
+
+    const uint64_t period = 1000000000ULL / SCHEDULER_HZ;
+    uint64_t next = now_ns();
+    uint64_t second = next;
+    struct chip8_hosted_t **arrived = NULL;
+    size_t arrived_cap = 0;
+    while (!atomic_load(&s->stop))
+    {
+        // swap the inbox for an empty one, then start what was in it
+        pthread_mutex_lock(&w->lock);
+        struct chip8_hosted_t **inbox = w->inbox;
+        const size_t inbox_nb = w->inbox_nb;
+        const size_t inbox_cap = w->inbox_cap;
+        w->inbox = arrived;
+        w->inbox_nb = 0;
+        w->inbox_cap = arrived_cap;
+        pthread_mutex_unlock(&w->lock);
+        arrived = inbox;
+        arrived_cap = inbox_cap;
+        for (size_t i = 0; i < inbox_nb; i++)
+        {
+            if (start(w, arrived[i]) < 0)
+            {
+                // try again next tick
+                pthread_mutex_lock(&w->lock);
+                push(&w->inbox, &w->inbox_nb, &w->inbox_cap, arrived[i]);
+                pthread_mutex_unlock(&w->lock);
+            }
+            else if (push(&w->sessions, &w->sessions_nb, &w->sessions_cap, arrived[i]) < 0)
+            {
+                finish(w, arrived[i]);
+            }
+        }
+
+        give(w);
+
+        const uint64_t begin = now_ns();
+        for (size_t i = 0; i < w->sessions_nb;)
+        {
+            struct chip8_hosted_t *h = w->sessions[i];
+            if (atomic_load_explicit(&h->closing, memory_order_acquire))
+            {
+                finish(w, h);
+                w->sessions[i] = w->sessions[--w->sessions_nb];
+                continue;
+            }
+            chip8_t_set_keys(h->c8, atomic_load_explicit(&h->keys, memory_order_relaxed));
+            for (size_t j = 0; j < CYCLES_PER_FRAME; j++)
+            {
+                chip8_t_emulate_cycle_predecoded(h->c8, h->pd);
+            }
+            atomic_fetch_add_explicit(&h->frames, 1, memory_order_relaxed);
+            i++;
+        }
+        const uint64_t end = now_ns();
+
+        w->busy_ns += end - begin;
+        if (end - second >= 1000000000ULL)
+        {
+            atomic_store(&w->utilization, w->busy_ns * 100 / (end - second));
+            w->busy_ns = 0;
+            second = end;
+        }
+
+        // wait for the next tick. a worker that's behind drops the ticks
+        // it missed rather than running frames back to back
+        next += period;
+        if (next < end)
+        {
+            next = end;
+            continue;
+        }
+        const struct timespec ts = {.tv_sec = next / 1000000000ULL, .tv_nsec = next % 1000000000ULL};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    free(arrived);
+    return NULL;
+}
+
+int chip8_scheduler_t_init(struct chip8_scheduler_t *s, size_t workers_nb, size_t capacity)
+{
+    memset(s, 0, sizeof(*s));
+    static int cpus[SCHEDULER_CPUS_NB];
+    const size_t cpus_nb = chip8_cpus(cpus, SCHEDULER_CPUS_NB);
+    if (cpus_nb == 0)
+    {
+        return -1;
+    }
+    if (workers_nb == 0 || workers_nb > cpus_nb)
+    {
+        workers_nb = cpus_nb;
+    }
+
+    s->workers = calloc(workers_nb, sizeof(struct chip8_worker_t));
+    if (s->workers == NULL)
+    {
+        return -1;
+    }
+    s->capacity = capacity;
+    atomic_init(&s->next_id, 1);
+    pthread_mutex_init(&s->ready_lock, NULL);
+    pthread_cond_init(&s->ready_cond, NULL);
+
+    for (size_t i = 0; i < workers_nb; i++)
+    {
+        struct chip8_worker_t *w = s->workers + i;
+        w->s = s;
+        w->cpu = cpus[i];
+        w->node = chip8_cpu_node(w->cpu);
+        pthread_mutex_init(&w->lock, NULL);
+        if (pthread_create(&w->thread, NULL, worker_thread, w) != 0)
+        {
+            break;
+        }
+        s->workers_nb++;
+    }
+
+    pthread_mutex_lock(&s->ready_lock);
+    while (s->ready_nb < s->workers_nb)
+    {
+        pthread_cond_wait(&s->ready_cond, &s->ready_lock);
+    }
+    pthread_mutex_unlock(&s->ready_lock);
+
+    if (s->workers_nb < workers_nb || s->failed_nb > 0)
+    {
+        chip8_scheduler_t_destroy(s);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_scheduler_t_destroy(struct chip8_scheduler_t *s)
+{
+    atomic_store(&s->stop, 1);
+    for (size_t i = 0; i < s->workers_nb; i++)
+    {
+        pthread_join(s->workers[i].thread, NULL);
+    }
+
+    // sessions the host didn't close, started or not
+    for (size_t i = 0; i < s->workers_nb; i++)
+    {
+        struct chip8_worker_t *w = s->workers + i;
+        for (size_t j = 0; j < w->sessions_nb + w->inbox_nb; j++)
+        {
+            struct chip8_hosted_t *h = j < w->sessions_nb ? w->sessions[j] : w->inbox[j - w->sessions_nb];
+            chip8_predecode_t_release(h->pd);
+            chip8_rom_t_release(h->rom);
+            free(h);
+        }
+        free(w->sessions);
+        free(w->inbox);
+        if (w->slab.states != NULL)
+        {
+            chip8_slab_t_destroy(&w->slab);
+        }
+        pthread_mutex_destroy(&w->lock);
+    }
+    free(s->workers);
+    pthread_mutex_destroy(&s->ready_lock);
+    pthread_cond_destroy(&s->ready_cond);
+    memset(s, 0, sizeof(*s));
+}
+
+struct chip8_hosted_t *chip8_scheduler_t_open(struct chip8_scheduler_t *s, struct chip8_rom_t *rom)
+{
+    struct chip8_worker_t *w = s->workers;
+    for (size_t i = 1; i < s->workers_nb; i++)
+    {
+        if (atomic_load(&s->workers[i].load) < atomic_load(&w->load))
+        {
+            w = s->workers + i;
+        }
+    }
+    if (atomic_fetch_add(&w->load, 1) >= s->capacity)
+    {
+        atomic_fetch_sub(&w->load, 1);
+        return NULL;
+    }
+
+    struct chip8_hosted_t *h = calloc(1, sizeof(struct chip8_hosted_t));
+    struct chip8_predecode_t *pd = h ? chip8_predecode_t_acquire(rom) : NULL;
+    if (pd == NULL)
+    {
+        free(h);
+        atomic_fetch_sub(&w->load, 1);
+        return NULL;
+    }
+    h->id = atomic_fetch_add(&s->next_id, 1);
+    h->rom = chip8_rom_t_retain(rom);
+    h->pd = pd;
+    h->worker = w - s->workers;
+
+    pthread_mutex_lock(&w->lock);
+    const int pushed = push(&w->inbox, &w->inbox_nb, &w->inbox_cap, h);
+    pthread_mutex_unlock(&w->lock);
+    if (pushed < 0)
+    {
+        chip8_predecode_t_release(pd);
+        chip8_rom_t_release(rom);
+        free(h);
+        atomic_fetch_sub(&w->load, 1);
+        return NULL;
+    }
+    return h;
+}
+
+void chip8_scheduler_t_close(struct chip8_scheduler_t *s, struct chip8_hosted_t *h)
+{
+    (void)s;
+    atomic_store_explicit(&h->closing, 1, memory_order_release);
+}
+
+// the idlest worker with room, on node if that's not -1
+static struct chip8_worker_t *idlest(struct chip8_scheduler_t *s, const struct chip8_worker_t *busiest, int node)
+{
+    struct chip8_worker_t *best = NULL;
+    for (size_t i = 0; i < s->workers_nb; i++)
+    {
+        struct chip8_worker_t *w = s->workers + i;
+        if (w == busiest || (node >= 0 && w->node != node) || atomic_load(&w->load) >= s->capacity)
+        {
+            continue;
+        }
+        if (best == NULL || atomic_load(&w->utilization) < atomic_load(&best->utilization))
+        {
+            best = w;
+        }
+    }
+    return best;
+}
+
+size_t chip8_scheduler_t_balance(struct chip8_scheduler_t *s)
+{
+    struct chip8_worker_t *busiest = s->workers;
+    for (size_t i = 1; i < s->workers_nb; i++)
+    {
+        if (atomic_load(&s->workers[i].utilization) > atomic_load(&busiest->utilization))
+        {
+            busiest = s->workers + i;
+        }
+    }
+    const unsigned busy = atomic_load(&busiest->utilization);
+
+    // crossing sockets is a last resort
+    struct chip8_worker_t *dst = idlest(s, busiest, busiest->node);
+    if (dst == NULL || busy < atomic_load(&dst->utilization) + SCHEDULER_IMBALANCE)
+    {
+        dst = idlest(s, busiest, -1);
+    }
+    if (dst == NULL || busy < atomic_load(&dst->utilization) + SCHEDULER_IMBALANCE)
+    {
+        s->imbalanced = 0;
+        return 0;
+    }
+    if (++s->imbalanced < SCHEDULER_SUSTAINED)
+    {
+        return 0;
+    }
+    s->imbalanced = 0;
+
+    // sessions cost about the same, move enough to meet halfway
+    const size_t load = atomic_load(&busiest->load);
+    size_t nb = load * (busy - atomic_load(&dst->utilization)) / 2 / (busy ? busy : 1);
+    const size_t room = s->capacity - atomic_load(&dst->load);
+    nb = nb < room ? nb : room;
+    if (nb == 0)
+    {
+        return 0;
+    }
+
+    atomic_fetch_add(&dst->load, nb);
+    unsigned long long none = 0;
+    const uint64_t give = (uint64_t)(dst - s->workers + 1) << 32 | nb;
+    if (!atomic_compare_exchange_strong(&busiest->give, &none, give))
+    {
+        // still handing over the last batch
+        atomic_fetch_sub(&dst->load, nb);
+        return 0;
+    }
+    return nb;
+}
+
+void chip8_scheduler_t_report(struct chip8_scheduler_t *s, FILE *out)
+{
+    for (size_t i = 0; i < s->workers_nb; i++)
+    {
+        struct chip8_worker_t *w = s->workers + i;
+        fprintf(out, "cpu %3d node %d: %6zu sessions %3u%% busy\n", w->cpu, w->node, atomic_load(&w->load),
+                atomic_load(&w->utilization));
+    }
+    fprintf(out, "%llu sessions moved\n", (unsigned long long)atomic_load(&s->migrations));
+}
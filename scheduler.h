@@ -0,0 +1,136 @@
+#ifndef CHIP8_SCHEDULER_H
+#define CHIP8_SCHEDULER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "predecode.h"
+#include "rom.h"
+#include "slab.h"
+
+enum scheduler_constants
+{
+    SCHEDULER_HZ = 60,
+
+    // a session moves when the busiest worker has been this many percent
+    // busier than the idlest for this many balance calls in a row
+    SCHEDULER_IMBALANCE = 20,
+    SCHEDULER_SUSTAINED = 3,
+
+    SCHEDULER_CPUS_NB = 1024
+};
+
+// the cpus this thread may run on, at most nb of them. returns how many
+size_t chip8_cpus(int *cpus, size_t nb);
+
+// the NUMA node a cpu belongs to, 0 if the system doesn't say
+int chip8_cpu_node(int cpu);
+
+// pin the calling thread to cpu. returns -1 if it can't be
+int chip8_pin_thread(int cpu);
+
+// a session run by the scheduler. the host sets keys and reads frames, the
+// state belongs to whichever worker runs it
+struct chip8_hosted_t
+{
+    uint64_t id;
+    struct chip8_rom_t *rom;
+    struct chip8_predecode_t *pd;
+
+    // in the slab of the worker running it, NULL until it has started
+    union chip8_t *c8;
+    size_t worker;
+
+    atomic_ushort keys;
+    atomic_ullong frames;
+    atomic_int closing;
+};
+
+// a thread pinned to one cpu, running its sessions a frame each per tick
+struct chip8_worker_t
+{
+    struct chip8_scheduler_t *s;
+    pthread_t thread;
+    int cpu;
+    int node;
+
+    // the slab is mapped and touched by the worker once it's pinned, so
+    // with the kernel's first touch policy its instances are on the
+    // worker's node. the lock covers the slab and the inbox
+    pthread_mutex_t lock;
+    struct chip8_slab_t slab;
+    struct chip8_hosted_t **inbox;
+    size_t inbox_nb;
+    size_t inbox_cap;
+
+    // only touched by the worker
+    struct chip8_hosted_t **sessions;
+    size_t sessions_nb;
+    size_t sessions_cap;
+    uint64_t busy_ns;
+
+    // instances its slab holds plus those reserved for sessions on their
+    // way to it, so never more than capacity
+    atomic_size_t load;
+    // sessions to hand over at the next tick, as (worker + 1) << 32 | count,
+    // or 0. one word, so a balance call that finds a hand-off still pending
+    // can't change its count
+    atomic_ullong give;
+    // percent of the last second spent emulating
+    atomic_uint utilization;
+};
+
+// runs sessions on workers pinned one per cpu. a session stays on the
+// worker it started on, where its state is warm in cache and on the
+// local node, and only moves when one worker stays much busier than
+// another: the move copies its state into the new worker's slab.
+// session lists are private to their worker, everything else goes
+// through a worker's inbox
+struct chip8_scheduler_t
+{
+    struct chip8_worker_t *workers;
+    size_t workers_nb;
+    // instances each worker has room for
+    size_t capacity;
+
+    atomic_int stop;
+    atomic_ullong next_id;
+    atomic_ullong migrations;
+
+    // balance calls in a row that found an imbalance
+    size_t imbalanced;
+
+    // workers that have set up their slab, and those that couldn't
+    pthread_mutex_t ready_lock;
+    pthread_cond_t ready_cond;
+    size_t ready_nb;
+    size_t failed_nb;
+};
+
+// start a worker on each of the first workers_nb cpus this thread may run
+// on (all of them if workers_nb is 0), each with room for capacity
+// sessions. returns -1 if a worker can't be started
+int chip8_scheduler_t_init(struct chip8_scheduler_t *s, size_t workers_nb, size_t capacity);
+void chip8_scheduler_t_destroy(struct chip8_scheduler_t *s);
+
+// start a session of rom on the least loaded worker.
+// returns NULL if every worker is full or we're out of memory
+struct chip8_hosted_t *chip8_scheduler_t_open(struct chip8_scheduler_t *s, struct chip8_rom_t *rom);
+
+// end a session. its worker frees it, the host can't use it afterwards
+void chip8_scheduler_t_close(struct chip8_scheduler_t *s, struct chip8_hosted_t *h);
+
+// move sessions away from the busiest worker if it has been
+// SCHEDULER_IMBALANCE percent busier than another for long enough,
+// preferring a worker on the same node, enough of them to close half the
+// gap. call it about once a second. returns the number of sessions moving
+size_t chip8_scheduler_t_balance(struct chip8_scheduler_t *s);
+
+// a line per worker: cpu, node, sessions and utilization
+void chip8_scheduler_t_report(struct chip8_scheduler_t *s, FILE *out);
+
+#endif
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+// gcc vector extensions, one SSE2 (or NEON) register.
+// the compiler picks the instructions so this builds anywhere
+typedef uint8_t vec_t __attribute__((vector_size(16)));
+
+enum search_constants
+{
+    VEC_NB = sizeof(vec_t)
+};
+
+static inline vec_t load(const uint8_t *p)
+{
+    vec_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int chip8_search_t_init(struct chip8_search_t *s, size_t cap)
+{
+    s->snaps = aligned_alloc(64, cap * MEM_NB);
+    if (s->snaps == NULL || cap == 0)
+    {
+        free(s->snaps);
+        return -1;
+    }
+    s->cap = cap;
+    chip8_search_t_reset(s);
+    return 0;
+}
+
+void chip8_search_t_destroy(struct chip8_search_t *s)
+{
+    free(s->snaps);
+    s->snaps = NULL;
+}
+
+void chip8_search_t_reset(struct chip8_search_t *s)
+{
+    s->nb = 0;
+    memset(s->candidates, 0xFF, MEM_NB);
+}
+
+void chip8_search_t_snapshot(struct chip8_search_t *s, const union chip8_t *c8)
+{
+    memcpy(s->snaps[s->nb % s->cap], c8->memory, MEM_NB);
+    s->nb += 1;
+}
+
+// 0xFF in every lane where pred holds going from older to newer.
+// always inlined with a constant pred so the switch disappears from
+// the inner loop
+static inline __attribute__((always_inline)) vec_t compare(enum search_predicate pred, vec_t older, vec_t newer)
+{
+    switch (pred)
+    {
+    case SEARCH_CHANGED:
+        return (vec_t)(newer != older);
+    case SEARCH_INCREASED:
+        return (vec_t)(newer > older);
+    case SEARCH_DECREASED:
+        return (vec_t)(newer < older);
+    default: // SEARCH_EQUAL
+        return (vec_t)(newer == older);
+    }
+}
+
+// one pass over the address space, each block of candidates is checked
+// against all n snapshots before moving on to the next
+static inline __attribute__((always_inline)) void filter(struct chip8_search_t *s, enum search_predicate pred, uint8_t value, size_t n)
+{
+    const vec_t splat = value - (vec_t){0};
+    for (size_t off = 0; off < MEM_NB; off += VEC_NB)
+    {
+        vec_t keep = load(s->candidates + off);
+        vec_t newer = load(chip8_search_t_snap(s, 0) + off);
+        if (pred == SEARCH_VALUE)
+        {
+            keep &= (vec_t)(newer == splat);
+        }
+        for (size_t k = 1; k < n; k++)
+        {
+            const vec_t older = load(chip8_search_t_snap(s, k) + off);
+            keep &= pred == SEARCH_VALUE ? (vec_t)(older == splat) : compare(pred, older, newer);
+            newer = older;
+        }
+        memcpy(s->candidates + off, &keep, sizeof(keep));
+    }
+}
+
+size_t chip8_search_t_filter(struct chip8_search_t *s, enum search_predicate pred, uint8_t value, size_t n)
+{
+    if (n > s->nb)
+    {
+        n = s->nb;
+    }
+    if (n > s->cap)
+    {
+        n = s->cap;
+    }
+    // comparing snapshots needs at least two of them
+    if (n == 0 || (n == 1 && pred != SEARCH_VALUE))
+    {
+        return chip8_search_t_count(s);
+    }
+
+    switch (pred)
+    {
+    case SEARCH_EQUAL:
+        filter(s, SEARCH_EQUAL, value, n);
+        break;
+    case SEARCH_CHANGED:
+        filter(s, SEARCH_CHANGED, value, n);
+        break;
+    case SEARCH_INCREASED:
+        filter(s, SEARCH_INCREASED, value, n);
+        break;
+    case SEARCH_DECREASED:
+        filter(s, SEARCH_DECREASED, value, n);
+        break;
+    case SEARCH_VALUE:
+        filter(s, SEARCH_VALUE, value, n);
+        break;
+    }
+    return chip8_search_t_count(s);
+}
+
+size_t chip8_search_t_intersect(struct chip8_search_t *s, const struct chip8_search_t *other)
+{
+    for (size_t off = 0; off < MEM_NB; off += VEC_NB)
+    {
+        const vec_t keep = load(s->candidates + off) & load(other->candidates + off);
+        memcpy(s->candidates + off, &keep, sizeof(keep));
+    }
+    return chip8_search_t_count(s);
+}
+
+size_t chip8_search_t_count(const struct chip8_search_t *s)
+{
+    // every candidate is a 0xFF byte, so 8 set bits
+    size_t bits = 0;
+    for (size_t off = 0; off < MEM_NB; off += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, s->candidates + off, sizeof(word));
+        bits += __builtin_popcountll(word);
+    }
+    return bits / 8;
+}
+
+size_t chip8_search_t_next(const struct chip8_search_t *s, size_t addr)
+{
+    while (addr < MEM_NB && s->candidates[addr] == 0)
+    {
+        addr++;
+    }
+    return addr;
+}
@@ -0,0 +1,65 @@
+#ifndef CHIP8_SEARCH_H
+#define CHIP8_SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum search_predicate
+{
+    SEARCH_EQUAL,     // same as in the previous snapshot
+    SEARCH_CHANGED,   // different from the previous snapshot
+    SEARCH_INCREASED, // greater than in the previous snapshot
+    SEARCH_DECREASED, // less than in the previous snapshot
+    SEARCH_VALUE      // equal to a given value
+};
+
+// ram search, for finding where a rom keeps things like the score or the
+// number of lives.
+// takes snapshots of memory as the game runs and narrows down a set of
+// candidate addresses with predicates over them. the candidates are a
+// byte mask (0xFF for still a candidate) so every filter is a handful of
+// vector compares over the whole address space, and a filter over many
+// snapshots streams through them with the mask held in registers
+struct chip8_search_t
+{
+    // ring buffer of the last cap snapshots
+    uint8_t (*snaps)[MEM_NB];
+    size_t cap;
+    // snapshots taken so far, the newest is at (nb - 1) % cap
+    size_t nb;
+
+    _Alignas(64) uint8_t candidates[MEM_NB];
+};
+
+// keep up to cap snapshots. returns -1 if we're out of memory
+int chip8_search_t_init(struct chip8_search_t *s, size_t cap);
+void chip8_search_t_destroy(struct chip8_search_t *s);
+
+// start over with every address as a candidate, forgetting the snapshots
+void chip8_search_t_reset(struct chip8_search_t *s);
+
+void chip8_search_t_snapshot(struct chip8_search_t *s, const union chip8_t *c8);
+
+// keep the candidates for which pred held between each pair of consecutive
+// snapshots among the last n (or, for SEARCH_VALUE, in each of them).
+// n is clamped to the snapshots we have, returns the candidates left
+size_t chip8_search_t_filter(struct chip8_search_t *s, enum search_predicate pred, uint8_t value, size_t n);
+
+// keep only the candidates that are also candidates in other, e.g. the
+// same search run on another instance with different inputs
+size_t chip8_search_t_intersect(struct chip8_search_t *s, const struct chip8_search_t *other);
+
+size_t chip8_search_t_count(const struct chip8_search_t *s);
+
+// the first candidate at or after addr, or MEM_NB if there is none
+size_t chip8_search_t_next(const struct chip8_search_t *s, size_t addr);
+
+// the k-th newest snapshot, 0 being the latest
+static inline const uint8_t *chip8_search_t_snap(const struct chip8_search_t *s, size_t k)
+{
+    return s->snaps[(s->nb - 1 - k) % s->cap];
+}
+
+#endif
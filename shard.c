@@ -0,0 +1,627 @@
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "manifest.h"
+#include "scheduler.h"
+#include "sock.h"
+
+// runs a manifest of cases (see manifest.h) on worker processes, so a rom
+// that takes a worker down only costs that worker. the coordinator listens
+// on a unix socket. a worker says hello with its pid and the build id of
+// its core (see cache.h):
+//   worker PID CORE_ID
+// and is handed a shard of cases at a time, a line each:
+//   case INDEX FRAMES ROM MOVIE          (MOVIE is - without one)
+// and the worker answers each case as soon as it's done:
+//   result INDEX FRAMES PC STATE_HASH DISPLAY_HASH
+//   error INDEX                          (the rom or movie can't be loaded)
+// a worker runs its cases in order, so one that disconnects, dies or goes
+// --timeout seconds without an answer was on the oldest case it hadn't
+// answered. that case is run on its own from then on, --retries more times
+// at most, and the rest of the shard goes back in the queue. --spawn starts local
+// workers and replaces the ones that die, workers elsewhere run --connect.
+// with --cache, cases whose result is already in the cache (see cache.h)
+// aren't run at all, and new results are added to it if the worker that
+// ran them has the same core as the coordinator.
+// results are printed in manifest order, as
+//   ROM MOVIE FRAMES PC STATE_HASH DISPLAY_HASH
+// or ROM MOVIE error|failed
+
+enum shard_constants
+{
+    WORKERS_NB = 256,
+    SHARD_NB = 64,
+    LINE_NB = 2 * MANIFEST_PATH_NB + 64
+};
+
+enum task_status
+{
+    TASK_PENDING,
+    TASK_RUNNING,
+    TASK_DONE,
+    TASK_ERROR,
+    TASK_FAILED
+};
+
+struct task_t
+{
+    struct chip8_case_t c;
+    int status;
+    long attempts;
+    struct chip8_case_result_t result;
+    // with --cache, set if the rom and movie could be read
+    int keyed;
+    struct chip8_cache_key_t key;
+};
+
+// a connected worker and the cases it hasn't answered yet
+struct worker_t
+{
+    int fd;
+    // the pid it says it has, and whether it's one of ours we can kill
+    pid_t pid;
+    int ours;
+    // whether its core is ours, so its results can go in the cache
+    int same_core;
+    char buf[LINE_NB];
+    size_t buf_nb;
+    // in the order they were sent
+    long shard[SHARD_NB];
+    size_t shard_nb;
+    time_t deadline;
+};
+
+struct coordinator_t
+{
+    struct task_t *tasks;
+    long tasks_nb;
+    // cases not done yet
+    long left;
+    long retried;
+    struct chip8_cache_t *cache;
+
+    // pending cases, the next one to hand out last
+    long *pending;
+    long pending_nb;
+
+    long shard_nb;
+    long retries;
+    long timeout;
+
+    struct worker_t *workers[WORKERS_NB];
+    size_t workers_nb;
+    pid_t children[WORKERS_NB];
+    size_t children_nb;
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-shard [--frames N] [--shard N] [--spawn N] [--retries N] [--timeout SECONDS] "
+                    "[--cache DIR] --listen PATH MANIFEST\n"
+                    "       ./chip8-shard [--cpu N] --connect PATH\n");
+    exit(1);
+}
+
+static time_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// the worker side: run cases until the coordinator hangs up
+static int work(const char *path)
+{
+    const int fd = sock_connect_unix(path, SOCK_STREAM);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fdopen(dup(fd), "w");
+    if (in == NULL || out == NULL)
+    {
+        return -1;
+    }
+    fprintf(out, "worker %d %llx\n", (int)getpid(), (unsigned long long)chip8_core_id());
+    fflush(out);
+
+    char line[LINE_NB];
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        long index;
+        struct chip8_case_t c;
+        if (sscanf(line, "case %ld %ld %511s %511s", &index, &c.frames, c.rom, c.movie) != 4)
+        {
+            continue;
+        }
+        if (strcmp(c.movie, "-") == 0)
+        {
+            c.movie[0] = '\0';
+        }
+        struct chip8_case_result_t r;
+        if (chip8_case_t_run(&c, &r) < 0)
+        {
+            fprintf(out, "error %ld\n", index);
+        }
+        else
+        {
+            fprintf(out, "result %ld %ld %u %llx %llx\n", index, r.frames, r.pc, (unsigned long long)r.state_hash,
+                    (unsigned long long)r.display_hash);
+        }
+        if (fflush(out) != 0)
+        {
+            break;
+        }
+    }
+    fclose(in);
+    fclose(out);
+    return 0;
+}
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return -1;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+static void requeue(struct coordinator_t *co, long index)
+{
+    co->tasks[index].status = TASK_PENDING;
+    co->pending[co->pending_nb++] = index;
+}
+
+// only the case it was running counts as an attempt, the ones queued
+// behind it go back as they were, to be handed out first
+static void drop_worker(struct coordinator_t *co, size_t i, const char *why)
+{
+    struct worker_t *w = co->workers[i];
+    size_t requeued = 0;
+    if (w->shard_nb > 0)
+    {
+        struct task_t *t = co->tasks + w->shard[0];
+        if (++t->attempts > co->retries)
+        {
+            t->status = TASK_FAILED;
+            co->left--;
+        }
+        else
+        {
+            requeue(co, w->shard[0]);
+            requeued++;
+        }
+    }
+    for (size_t j = w->shard_nb; j-- > 1;)
+    {
+        requeue(co, w->shard[j]);
+        requeued++;
+    }
+    if (w->shard_nb > 0)
+    {
+        fprintf(stderr, "worker %d %s, %zu cases back in the queue, %zu failed\n", (int)w->pid, why, requeued,
+                w->shard_nb - requeued);
+    }
+    co->retried += requeued;
+    if (w->ours)
+    {
+        kill(w->pid, SIGKILL);
+    }
+    close(w->fd);
+    free(w);
+    co->workers[i] = co->workers[--co->workers_nb];
+}
+
+// hand an idle worker its next shard. a case that was running when a worker
+// went down gets a shard of its own, so it can't take innocent ones with it
+// again. returns -1 if the worker can't be reached
+static int dispatch(struct coordinator_t *co, struct worker_t *w)
+{
+    while (w->shard_nb < (size_t)co->shard_nb && co->pending_nb > 0)
+    {
+        const long index = co->pending[co->pending_nb - 1];
+        struct task_t *t = co->tasks + index;
+        if (t->attempts > 0 && w->shard_nb > 0)
+        {
+            break;
+        }
+        co->pending_nb--;
+        t->status = TASK_RUNNING;
+        w->shard[w->shard_nb++] = index;
+
+        char line[LINE_NB];
+        const int len = snprintf(line, sizeof(line), "case %ld %ld %s %s\n", index, t->c.frames, t->c.rom,
+                                 t->c.movie[0] ? t->c.movie : "-");
+        if (send_all(w->fd, line, len) < 0)
+        {
+            return -1;
+        }
+        if (t->attempts > 0)
+        {
+            break;
+        }
+    }
+    w->deadline = now() + co->timeout;
+    return 0;
+}
+
+// a line from a worker. returns -1 if it makes no sense
+static int handle_line(struct coordinator_t *co, struct worker_t *w, const char *line)
+{
+    int pid;
+    unsigned long long core_id;
+    long index;
+    struct chip8_case_result_t r;
+    unsigned pc;
+    unsigned long long state_hash;
+    unsigned long long display_hash;
+
+    const int hello = sscanf(line, "worker %d %llx", &pid, &core_id);
+    if (hello >= 1)
+    {
+        w->pid = pid;
+        w->same_core = hello == 2 && core_id == chip8_core_id();
+        for (size_t i = 0; i < co->children_nb; i++)
+        {
+            w->ours = w->ours || co->children[i] == pid;
+        }
+        return 0;
+    }
+    const int ok = sscanf(line, "result %ld %ld %u %llx %llx", &index, &r.frames, &pc, &state_hash, &display_hash) == 5;
+    if (!ok && sscanf(line, "error %ld", &index) != 1)
+    {
+        return -1;
+    }
+
+    // answers for cases it doesn't hold any more are dropped
+    for (size_t j = 0; j < w->shard_nb; j++)
+    {
+        if (w->shard[j] != index)
+        {
+            continue;
+        }
+        struct task_t *t = co->tasks + index;
+        t->status = ok ? TASK_DONE : TASK_ERROR;
+        r.pc = pc;
+        r.state_hash = state_hash;
+        r.display_hash = display_hash;
+        t->result = r;
+        co->left--;
+        if (ok && co->cache != NULL && t->keyed && w->same_core && chip8_cache_t_put(co->cache, &t->key, &r) < 0)
+        {
+            fprintf(stderr, "Could not write to the cache in %s\n", co->cache->dir);
+        }
+        w->shard_nb--;
+        memmove(w->shard + j, w->shard + j + 1, (w->shard_nb - j) * sizeof(long));
+        w->deadline = now() + co->timeout;
+        break;
+    }
+    return 0;
+}
+
+// read what a worker sent. returns -1 if it's gone
+static int receive(struct coordinator_t *co, struct worker_t *w)
+{
+    const ssize_t got = read(w->fd, w->buf + w->buf_nb, sizeof(w->buf) - w->buf_nb - 1);
+    if (got <= 0)
+    {
+        return -1;
+    }
+    w->buf_nb += got;
+    w->buf[w->buf_nb] = '\0';
+
+    char *line = w->buf;
+    char *end;
+    while ((end = strchr(line, '\n')) != NULL)
+    {
+        *end = '\0';
+        if (handle_line(co, w, line) < 0)
+        {
+            return -1;
+        }
+        line = end + 1;
+    }
+    w->buf_nb -= line - w->buf;
+    memmove(w->buf, line, w->buf_nb);
+    // a line longer than the buffer isn't from a worker
+    return w->buf_nb < sizeof(w->buf) - 1 ? 0 : -1;
+}
+
+// returns -1 if fork fails
+static int spawn(struct coordinator_t *co, int listen_fd, const char *path, const int *cpus, size_t cpus_nb)
+{
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(listen_fd);
+        for (size_t i = 0; i < co->workers_nb; i++)
+        {
+            close(co->workers[i]->fd);
+        }
+        if (cpus_nb > 0)
+        {
+            chip8_pin_thread(cpus[co->children_nb % cpus_nb]);
+        }
+        _exit(work(path) < 0);
+    }
+    if (pid < 0)
+    {
+        return -1;
+    }
+    co->children[co->children_nb++] = pid;
+    return 0;
+}
+
+static void reap(struct coordinator_t *co, int options)
+{
+    pid_t pid;
+    while (co->children_nb > 0 && (pid = waitpid(-1, NULL, options)) > 0)
+    {
+        for (size_t i = 0; i < co->children_nb; i++)
+        {
+            if (co->children[i] == pid)
+            {
+                co->children[i] = co->children[--co->children_nb];
+                break;
+            }
+        }
+    }
+}
+
+static int coordinate(struct coordinator_t *co, const char *path, long spawn_nb)
+{
+    const int listen_fd = sock_listen_unix(path, SOCK_STREAM);
+    if (listen_fd < 0)
+    {
+        fprintf(stderr, "Could not listen on %s\n", path);
+        return -1;
+    }
+    static int cpus[SCHEDULER_CPUS_NB];
+    const size_t cpus_nb = chip8_cpus(cpus, SCHEDULER_CPUS_NB);
+
+    struct pollfd fds[WORKERS_NB + 1];
+    while (co->left > 0)
+    {
+        // replace local workers that died, while there's work left for them
+        reap(co, WNOHANG);
+        while ((long)co->children_nb < spawn_nb && spawn(co, listen_fd, path, cpus, cpus_nb) == 0)
+        {
+        }
+
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < co->workers_nb; i++)
+        {
+            fds[i + 1].fd = co->workers[i]->fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        const size_t nb = co->workers_nb;
+        if (poll(fds, nb + 1, 1000) < 0)
+        {
+            continue;
+        }
+
+        const time_t t = now();
+        for (size_t i = nb; i-- > 0;)
+        {
+            struct worker_t *w = co->workers[i];
+            if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) && receive(co, w) < 0)
+            {
+                drop_worker(co, i, "disconnected");
+            }
+            else if (w->shard_nb > 0 && t > w->deadline)
+            {
+                drop_worker(co, i, "timed out");
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            const int fd = accept(listen_fd, NULL, NULL);
+            struct worker_t *w = fd >= 0 && co->workers_nb < WORKERS_NB ? calloc(1, sizeof(struct worker_t)) : NULL;
+            if (w != NULL)
+            {
+                w->fd = fd;
+                co->workers[co->workers_nb++] = w;
+            }
+            else if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+
+        // cases that came back go to whoever is idle
+        for (size_t i = co->workers_nb; i-- > 0;)
+        {
+            if (co->workers[i]->shard_nb == 0 && dispatch(co, co->workers[i]) < 0)
+            {
+                drop_worker(co, i, "disconnected");
+            }
+        }
+    }
+
+    // workers exit once they see the socket close
+    while (co->workers_nb > 0)
+    {
+        struct worker_t *w = co->workers[--co->workers_nb];
+        close(w->fd);
+        free(w);
+    }
+    close(listen_fd);
+    unlink(path);
+    reap(co, 0);
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    long frames = 600;
+    static int cpus[SCHEDULER_CPUS_NB];
+    long spawn_nb = chip8_cpus(cpus, SCHEDULER_CPUS_NB);
+    long cpu = -1;
+    const char *listen_path = NULL;
+    const char *connect_path = NULL;
+    const char *cache_dir = NULL;
+
+    static struct coordinator_t co;
+    co.shard_nb = 16;
+    co.retries = 2;
+    co.timeout = 60;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc)
+        {
+            co.shard_nb = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--spawn") == 0 && i + 1 < argc)
+        {
+            spawn_nb = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc)
+        {
+            co.retries = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+        {
+            co.timeout = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cache_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)
+        {
+            cpu = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc)
+        {
+            listen_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+        {
+            connect_path = argv[++i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+
+    if (connect_path != NULL)
+    {
+        if (i != argc || listen_path != NULL)
+        {
+            usage();
+        }
+        if (cpu >= 0 && chip8_pin_thread(cpu) < 0)
+        {
+            fprintf(stderr, "Could not pin to cpu %ld\n", cpu);
+            return 1;
+        }
+        if (work(connect_path) < 0)
+        {
+            fprintf(stderr, "Could not connect to %s\n", connect_path);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (listen_path == NULL || i + 1 != argc || frames < 0 || co.shard_nb <= 0 || co.shard_nb > SHARD_NB ||
+        spawn_nb < 0 || spawn_nb > WORKERS_NB || co.retries < 0 || co.timeout <= 0)
+    {
+        usage();
+    }
+    struct chip8_case_t *cases;
+    co.tasks_nb = chip8_manifest_load(argv[i], frames, &cases);
+    if (co.tasks_nb < 0)
+    {
+        fprintf(stderr, "Could not read manifest %s\n", argv[i]);
+        return 1;
+    }
+    co.tasks = calloc(co.tasks_nb + 1, sizeof(struct task_t));
+    co.pending = malloc((co.tasks_nb + 1) * sizeof(long));
+    if (co.tasks == NULL || co.pending == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    static struct chip8_cache_t cache;
+    if (cache_dir != NULL)
+    {
+        if (chip8_cache_t_open(&cache, cache_dir) < 0)
+        {
+            fprintf(stderr, "Could not use %s as a cache\n", cache_dir);
+            return 1;
+        }
+        co.cache = &cache;
+    }
+    co.left = co.tasks_nb;
+    for (long t = co.tasks_nb; t-- > 0;)
+    {
+        struct task_t *task = co.tasks + t;
+        task->c = cases[t];
+        // unreadable files are left to a worker to report
+        task->keyed = co.cache != NULL && chip8_cache_key_t_make(&task->key, &task->c) == 0;
+        if (task->keyed && chip8_cache_t_get(co.cache, &task->key, &task->result) == 0)
+        {
+            task->status = TASK_DONE;
+            co.left--;
+            continue;
+        }
+        co.pending[co.pending_nb++] = t;
+    }
+    free(cases);
+
+    if (coordinate(&co, listen_path, spawn_nb) < 0)
+    {
+        return 1;
+    }
+
+    int status = 0;
+    long failed = 0;
+    for (long t = 0; t < co.tasks_nb; t++)
+    {
+        const struct task_t *task = co.tasks + t;
+        printf("%s %s", task->c.rom, task->c.movie[0] ? task->c.movie : "-");
+        if (task->status == TASK_DONE)
+        {
+            printf(" %ld 0x%03X %016llx %016llx\n", task->result.frames, task->result.pc,
+                   (unsigned long long)task->result.state_hash, (unsigned long long)task->result.display_hash);
+            continue;
+        }
+        printf(" %s\n", task->status == TASK_ERROR ? "error" : "failed");
+        failed++;
+        status = 2;
+    }
+    fprintf(stderr, "%ld cases, %llu from the cache, %ld run again, %ld failed or unreadable\n", co.tasks_nb,
+            (unsigned long long)cache.hits, co.retried, failed);
+    free(co.tasks);
+    free(co.pending);
+    return status;
+}
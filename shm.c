@@ -0,0 +1,121 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm.h"
+
+static int chip8_shm_t_map(struct chip8_shm_t *shm, const char *name, int flags)
+{
+    if (strlen(name) >= sizeof(shm->name))
+    {
+        return -1;
+    }
+    strcpy(shm->name, name);
+
+    int fd = shm_open(name, flags, 0600);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof(struct chip8_shm_block_t)) < 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void *map = mmap(NULL, sizeof(struct chip8_shm_block_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        if (flags & O_CREAT)
+        {
+            shm_unlink(name);
+        }
+        return -1;
+    }
+    shm->block = map;
+    shm->owner = (flags & O_CREAT) != 0;
+    return 0;
+}
+
+int chip8_shm_t_create(struct chip8_shm_t *shm, const char *name)
+{
+    if (chip8_shm_t_map(shm, name, O_RDWR | O_CREAT | O_TRUNC) < 0)
+    {
+        return -1;
+    }
+    memset(shm->block, 0, sizeof(struct chip8_shm_block_t));
+    shm->block->version = SHM_VERSION;
+    // set last, readers check it to see the segment is ready
+    atomic_thread_fence(memory_order_release);
+    shm->block->magic = SHM_MAGIC;
+    return 0;
+}
+
+int chip8_shm_t_open(struct chip8_shm_t *shm, const char *name)
+{
+    if (chip8_shm_t_map(shm, name, O_RDWR) < 0)
+    {
+        return -1;
+    }
+    if (shm->block->magic != SHM_MAGIC || shm->block->version != SHM_VERSION)
+    {
+        munmap(shm->block, sizeof(struct chip8_shm_block_t));
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_shm_t_close(struct chip8_shm_t *shm)
+{
+    munmap(shm->block, sizeof(struct chip8_shm_block_t));
+    if (shm->owner)
+    {
+        shm_unlink(shm->name);
+    }
+    shm->block = NULL;
+}
+
+void chip8_shm_t_publish(struct chip8_shm_t *shm, const union chip8_t *c8, uint64_t frame)
+{
+    struct chip8_shm_block_t *block = shm->block;
+
+    // odd: a frame is being written
+    unsigned seq = atomic_load_explicit(&block->seq, memory_order_relaxed);
+    atomic_store_explicit(&block->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    block->frame = frame;
+    block->keys = chip8_t_get_keys(c8);
+    memcpy(block->display, c8->display, sizeof(block->display));
+
+    // even again: the frame is complete
+    atomic_store_explicit(&block->seq, seq + 2, memory_order_release);
+}
+
+void chip8_shm_t_read(const struct chip8_shm_t *shm, struct chip8_shm_frame_t *out)
+{
+    struct chip8_shm_block_t *block = shm->block;
+
+    for (;;)
+    {
+        unsigned before = atomic_load_explicit(&block->seq, memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+
+        out->frame = block->frame;
+        out->keys = block->keys;
+        memcpy(out->display, block->display, sizeof(out->display));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&block->seq, memory_order_relaxed) == before)
+        {
+            return;
+        }
+    }
+}
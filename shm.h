@@ -0,0 +1,74 @@
+#ifndef CHIP8_SHM_H
+#define CHIP8_SHM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum shm_constants
+{
+    SHM_MAGIC = 0x4D533843, // "C8SM"
+    SHM_VERSION = 1
+};
+
+// what the emulator shares with other processes.
+// the frame fields are written under a seqlock: seq is odd while a frame
+// is being written, so a reader copies them out and retries if seq was
+// odd or changed in the meantime. keys_in goes the other way, other
+// processes store keys in it that are held on top of the keyboard
+struct chip8_shm_block_t
+{
+    uint32_t magic;
+    uint32_t version;
+
+    atomic_uint seq;
+    uint16_t keys; // keys the last frame ran with
+    uint16_t reserved;
+    uint64_t frame;
+    uint8_t display[32 * 64 / 8];
+
+    _Alignas(64) atomic_uint keys_in;
+};
+
+// a consistent copy of the frame fields
+struct chip8_shm_frame_t
+{
+    uint64_t frame;
+    uint16_t keys;
+    uint8_t display[32 * 64 / 8];
+};
+
+struct chip8_shm_t
+{
+    struct chip8_shm_block_t *block;
+    char name[256];
+    int owner;
+};
+
+// create the named segment (e.g. "/chip8") for the emulator to publish to
+int chip8_shm_t_create(struct chip8_shm_t *shm, const char *name);
+
+// map a segment created by a running emulator
+int chip8_shm_t_open(struct chip8_shm_t *shm, const char *name);
+
+// unmap, and remove the segment if we created it
+void chip8_shm_t_close(struct chip8_shm_t *shm);
+
+// emulator side, called once per frame
+void chip8_shm_t_publish(struct chip8_shm_t *shm, const union chip8_t *c8, uint64_t frame);
+
+static inline uint16_t chip8_shm_t_injected(const struct chip8_shm_t *shm)
+{
+    return atomic_load_explicit(&shm->block->keys_in, memory_order_relaxed);
+}
+
+// reader side
+void chip8_shm_t_read(const struct chip8_shm_t *shm, struct chip8_shm_frame_t *out);
+
+static inline void chip8_shm_t_inject(struct chip8_shm_t *shm, uint16_t keys)
+{
+    atomic_store_explicit(&shm->block->keys_in, keys, memory_order_relaxed);
+}
+
+#endif
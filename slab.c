@@ -0,0 +1,94 @@
+#include <string.h>
+#include <sys/mman.h>
+
+#include "slab.h"
+
+enum slab_constants
+{
+    HUGE_PAGE_SIZE = 2 * 1024 * 1024
+};
+
+static size_t round_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+int chip8_slab_t_init(struct chip8_slab_t *slab, size_t nb, int flags)
+{
+    // states first so they start on a page, then the sessions,
+    // then the free list
+    const size_t states_size = nb * sizeof(union chip8_t);
+    const size_t sessions_size = nb * sizeof(struct chip8_session_t);
+    const size_t free_size = nb * sizeof(uint32_t);
+    size_t size = states_size + sessions_size + free_size;
+
+    slab->map = MAP_FAILED;
+    slab->huge = 0;
+#ifdef MAP_HUGETLB
+    if (flags & SLAB_HUGE_PAGES)
+    {
+        slab->map_size = round_up(size, HUGE_PAGE_SIZE);
+        slab->map = mmap(NULL, slab->map_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        slab->huge = slab->map != MAP_FAILED;
+    }
+#endif
+    if (slab->map == MAP_FAILED)
+    {
+        slab->map_size = round_up(size, sizeof(union chip8_t));
+        slab->map = mmap(NULL, slab->map_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab->map == MAP_FAILED)
+        {
+            return -1;
+        }
+#ifdef MADV_HUGEPAGE
+        // no reserved huge pages, transparent ones are the next best thing
+        if (flags & SLAB_HUGE_PAGES)
+        {
+            madvise(slab->map, slab->map_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    slab->states = slab->map;
+    slab->sessions = (struct chip8_session_t *)((uint8_t *)slab->map + states_size);
+    slab->free_slots = (uint32_t *)((uint8_t *)slab->map + states_size + sessions_size);
+    slab->nb = nb;
+    slab->next_id = 1;
+
+    // push the slots in reverse so the first allocations come out in order
+    slab->free_nb = nb;
+    for (size_t i = 0; i < nb; i++)
+    {
+        slab->free_slots[i] = nb - 1 - i;
+    }
+    return 0;
+}
+
+void chip8_slab_t_destroy(struct chip8_slab_t *slab)
+{
+    munmap(slab->map, slab->map_size);
+    slab->map = NULL;
+    slab->nb = 0;
+    slab->free_nb = 0;
+}
+
+union chip8_t *chip8_slab_t_alloc(struct chip8_slab_t *slab)
+{
+    if (slab->free_nb == 0)
+    {
+        return NULL;
+    }
+
+    const uint32_t slot = slab->free_slots[--slab->free_nb];
+    struct chip8_session_t *session = slab->sessions + slot;
+    memset(session, 0, sizeof(struct chip8_session_t));
+    session->id = slab->next_id++;
+    return slab->states + slot;
+}
+
+void chip8_slab_t_free(struct chip8_slab_t *slab, union chip8_t *c8)
+{
+    slab->free_slots[slab->free_nb++] = chip8_slab_t_slot(slab, c8);
+}
@@ -0,0 +1,68 @@
+#ifndef CHIP8_SLAB_H
+#define CHIP8_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum slab_flags
+{
+    // try to back the slab with huge pages, falls back to normal pages
+    SLAB_HUGE_PAGES = 1
+};
+
+// host side bookkeeping that goes with every instance.
+// padded to a cache line so sessions stepped on different threads
+// never share one
+struct chip8_session_t
+{
+    _Alignas(64) uint64_t id;
+    uint64_t frames; // frames emulated so far
+    void *user;      // whatever the host wants to attach
+};
+
+// a fixed number of instances and their sessions, carved out of a single
+// mapping made up front.
+// allocating and freeing only push and pop a free list, so session churn
+// never reaches malloc and can't fragment the heap over a long uptime.
+// a slab isn't thread safe, use one per thread or lock around it
+struct chip8_slab_t
+{
+    // one page per instance (sizeof(union chip8_t) == 4096)
+    union chip8_t *states;
+    struct chip8_session_t *sessions;
+
+    // stack of free slot indices, the most recently freed slot is
+    // handed out first since it's the most likely to still be cached
+    uint32_t *free_slots;
+    size_t free_nb;
+    size_t nb;
+
+    uint64_t next_id;
+
+    void *map;
+    size_t map_size;
+    int huge; // whether the mapping ended up on huge pages
+};
+
+// map room for nb instances. returns 0 on success, -1 if mmap fails
+int chip8_slab_t_init(struct chip8_slab_t *slab, size_t nb, int flags);
+void chip8_slab_t_destroy(struct chip8_slab_t *slab);
+
+// take a free instance, or NULL if the slab is full.
+// the instance isn't reset, its session is zeroed apart from the id
+union chip8_t *chip8_slab_t_alloc(struct chip8_slab_t *slab);
+void chip8_slab_t_free(struct chip8_slab_t *slab, union chip8_t *c8);
+
+static inline size_t chip8_slab_t_slot(const struct chip8_slab_t *slab, const union chip8_t *c8)
+{
+    return (size_t)(c8 - slab->states);
+}
+
+static inline struct chip8_session_t *chip8_slab_t_session(struct chip8_slab_t *slab, const union chip8_t *c8)
+{
+    return slab->sessions + chip8_slab_t_slot(slab, c8);
+}
+
+#endif
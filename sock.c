@@ -0,0 +1,61 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "sock.h"
+
+static int unix_address(struct sockaddr_un *addr, const char *path)
+{
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int sock_listen_unix(const char *path, int type)
+{
+    struct sockaddr_un addr;
+    if (unix_address(&addr, path) < 0)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int sock_connect_unix(const char *path, int type)
+{
+    struct sockaddr_un addr;
+    if (unix_address(&addr, path) < 0)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
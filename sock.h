@@ -0,0 +1,12 @@
+#ifndef CHIP8_SOCK_H
+#define CHIP8_SOCK_H
+
+// listen on a unix socket of the given type (SOCK_STREAM, SOCK_SEQPACKET),
+// replacing whatever was left at path by an earlier run.
+// returns the listening socket, or -1
+int sock_listen_unix(const char *path, int type);
+
+// returns the connected socket, or -1
+int sock_connect_unix(const char *path, int type);
+
+#endif
@@ -0,0 +1,156 @@
+#include <pthread.h>
+
+#include "heatmap.h"
+#include "specialize.h"
+
+// a handler for one instruction, or a family of them
+typedef void (*handler_t)(union chip8_t *c8, uint16_t instruction);
+
+// every register index, and every pair of them
+#define EACH_X(m, y)                                                                                                   \
+    m(0, y) m(1, y) m(2, y) m(3, y) m(4, y) m(5, y) m(6, y) m(7, y) m(8, y) m(9, y) m(10, y) m(11, y) m(12, y)       \
+        m(13, y) m(14, y) m(15, y)
+#define EACH_XY(m)                                                                                                     \
+    EACH_X(m, 0) EACH_X(m, 1) EACH_X(m, 2) EACH_X(m, 3) EACH_X(m, 4) EACH_X(m, 5) EACH_X(m, 6) EACH_X(m, 7)           \
+        EACH_X(m, 8) EACH_X(m, 9) EACH_X(m, 10) EACH_X(m, 11) EACH_X(m, 12) EACH_X(m, 13) EACH_X(m, 14)              \
+            EACH_X(m, 15)
+
+// the same statements as chip8_t_execute, with x and y as constants
+#define HANDLER(name, body)                                                                                            \
+    static void name(union chip8_t *c8, uint16_t instruction)                                                          \
+    {                                                                                                                  \
+        (void)instruction;                                                                                             \
+        CHIP8_HEAT(HEATMAP_EXECUTE, c8->PC, 2);                                                                        \
+        body;                                                                                                          \
+        chip8_t_update_timers(c8);                                                                                     \
+    }
+
+#define ALU(x, y)                                                                                                      \
+    HANDLER(ld_##x##_##y, c8->V[x] = c8->V[y]; c8->PC += 2)                                                            \
+    HANDLER(or_##x##_##y, c8->V[x] |= c8->V[y]; c8->PC += 2)                                                           \
+    HANDLER(and_##x##_##y, c8->V[x] &= c8->V[y]; c8->PC += 2)                                                          \
+    HANDLER(xor_##x##_##y, c8->V[x] ^= c8->V[y]; c8->PC += 2)                                                          \
+    HANDLER(add_##x##_##y, c8->V[0xF] = (c8->V[x] + c8->V[y] > 255) ? 1 : 0; c8->V[x] += c8->V[y]; c8->PC += 2)       \
+    HANDLER(sub_##x##_##y, c8->V[0xF] = (c8->V[x] > c8->V[y]) ? 1 : 0; c8->V[x] -= c8->V[y]; c8->PC += 2)             \
+    HANDLER(shr_##x##_##y, c8->V[0xF] = c8->V[x] & 1; c8->V[x] >>= 1; c8->PC += 2)                                    \
+    HANDLER(subn_##x##_##y, c8->V[0xF] = (c8->V[y] > c8->V[x]) ? 1 : 0; c8->V[x] = c8->V[y] - c8->V[x]; c8->PC += 2)  \
+    HANDLER(shl_##x##_##y, c8->V[0xF] = c8->V[x] >> 7; c8->V[x] <<= 1; c8->PC += 2)                                   \
+    HANDLER(se_##x##_##y, c8->PC += (c8->V[x] == c8->V[y]) ? 4 : 2)                                                    \
+    HANDLER(sne_##x##_##y, c8->PC += (c8->V[x] != c8->V[y]) ? 4 : 2)
+
+// kk stays in the instruction, only x is baked in
+#define SKIP_BYTE(x, y)                                                                                                \
+    HANDLER(se_byte_##x, c8->PC += (c8->V[x] == (instruction & 0xFF)) ? 4 : 2)                                         \
+    HANDLER(sne_byte_##x, c8->PC += (c8->V[x] != (instruction & 0xFF)) ? 4 : 2)
+
+EACH_XY(ALU)
+EACH_X(SKIP_BYTE, 0)
+
+static void generic(union chip8_t *c8, uint16_t instruction)
+{
+    chip8_t_execute(c8, chip8_insn_t_decode(instruction));
+}
+
+// indexed by the whole instruction
+static handler_t handlers[1 << 16];
+
+// indexed by the low 12 bits of 8xyN, x of 3xkk and 4xkk, and xy of 5xy0
+// and 9xy0, which like chip8_t_execute don't look at their last nibble
+static handler_t alu[1 << 12];
+static handler_t se_byte[16];
+static handler_t sne_byte[16];
+static handler_t se[256];
+static handler_t sne[256];
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void init(void)
+{
+    for (size_t i = 0; i < sizeof(alu) / sizeof(alu[0]); i++)
+    {
+        alu[i] = generic;
+    }
+
+#define SET_ALU(x, y)                                                                                                  \
+    alu[x << 8 | y << 4 | 0x0] = ld_##x##_##y;                                                                         \
+    alu[x << 8 | y << 4 | 0x1] = or_##x##_##y;                                                                         \
+    alu[x << 8 | y << 4 | 0x2] = and_##x##_##y;                                                                        \
+    alu[x << 8 | y << 4 | 0x3] = xor_##x##_##y;                                                                        \
+    alu[x << 8 | y << 4 | 0x4] = add_##x##_##y;                                                                        \
+    alu[x << 8 | y << 4 | 0x5] = sub_##x##_##y;                                                                        \
+    alu[x << 8 | y << 4 | 0x6] = shr_##x##_##y;                                                                        \
+    alu[x << 8 | y << 4 | 0x7] = subn_##x##_##y;                                                                       \
+    alu[x << 8 | y << 4 | 0xE] = shl_##x##_##y;                                                                        \
+    se[x << 4 | y] = se_##x##_##y;                                                                                     \
+    sne[x << 4 | y] = sne_##x##_##y;
+#define SET_SKIP_BYTE(x, y)                                                                                            \
+    se_byte[x] = se_byte_##x;                                                                                          \
+    sne_byte[x] = sne_byte_##x;
+
+    EACH_XY(SET_ALU)
+    EACH_X(SET_SKIP_BYTE, 0)
+
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++)
+    {
+        const uint16_t instruction = i;
+        switch (instruction >> 12)
+        {
+        case 0x3:
+            handlers[i] = se_byte[(instruction >> 8) & 0xF];
+            break;
+        case 0x4:
+            handlers[i] = sne_byte[(instruction >> 8) & 0xF];
+            break;
+        case 0x5:
+            handlers[i] = se[(instruction >> 4) & 0xFF];
+            break;
+        case 0x8:
+            handlers[i] = alu[instruction & 0xFFF];
+            break;
+        case 0x9:
+            handlers[i] = sne[(instruction >> 4) & 0xFF];
+            break;
+        default:
+            handlers[i] = generic;
+            break;
+        }
+    }
+}
+
+void chip8_specialize_init(void)
+{
+    pthread_once(&once, init);
+}
+
+void chip8_t_emulate_cycle_specialized(union chip8_t *c8)
+{
+    // instructions are two bytes long
+    const uint16_t instruction = (c8->memory[c8->PC] << 8) | c8->memory[c8->PC + 1];
+    handlers[instruction](c8, instruction);
+}
+
+void chip8_t_emulate_cycle_specialized_small(union chip8_t *c8)
+{
+    const uint16_t instruction = (c8->memory[c8->PC] << 8) | c8->memory[c8->PC + 1];
+    switch (instruction >> 12)
+    {
+    case 0x3:
+        se_byte[(instruction >> 8) & 0xF](c8, instruction);
+        break;
+    case 0x4:
+        sne_byte[(instruction >> 8) & 0xF](c8, instruction);
+        break;
+    case 0x5:
+        se[(instruction >> 4) & 0xFF](c8, instruction);
+        break;
+    case 0x8:
+        alu[instruction & 0xFFF](c8, instruction);
+        break;
+    case 0x9:
+        sne[(instruction >> 4) & 0xFF](c8, instruction);
+        break;
+    default:
+        chip8_t_execute(c8, chip8_insn_t_decode(instruction));
+        break;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef CHIP8_SPECIALIZE_H
+#define CHIP8_SPECIALIZE_H
+
+#include "chip8.h"
+
+// operand specialized interpreter.
+// 8xyN, 3xkk, 4xkk, 5xy0 and 9xy0 get one handler per register (or pair of
+// registers), generated with the preprocessor, so x and y are constants
+// and there is nothing to extract: 8xy4 for V3 and V5 is a load, an add
+// and a compare. every other instruction goes through chip8_t_execute.
+// there are two ways to find the handler:
+//   chip8_t_emulate_cycle_specialized        a table of all 64K instructions
+//   chip8_t_emulate_cycle_specialized_small  a switch on the opcode, then
+//                                            4096 entries for 8xyN and 16
+//                                            or 256 for the skips
+// the big table takes no decoding at all but 512 KB of cache, the small
+// ones take 40 KB. chip8-bench tells which is faster on a host
+
+// fill in the tables. call it once before either of the functions below,
+// any number of threads may call it
+void chip8_specialize_init(void);
+
+void chip8_t_emulate_cycle_specialized(union chip8_t *c8);
+void chip8_t_emulate_cycle_specialized_small(union chip8_t *c8);
+
+#endif
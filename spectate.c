@@ -0,0 +1,478 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "sock.h"
+#include "spectate.h"
+
+static struct chip8_spectate_buf_t *buf_new(uint32_t frame, uint8_t type, size_t len)
+{
+    struct chip8_spectate_buf_t *buf = malloc(sizeof(struct chip8_spectate_buf_t) + sizeof(struct chip8_spectate_header_t) + len);
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+    atomic_init(&buf->refs, 1);
+
+    struct chip8_spectate_header_t header = {frame, len, type, 0};
+    memcpy(buf->data, &header, sizeof(header));
+    buf->len = sizeof(header) + len;
+    return buf;
+}
+
+static struct chip8_spectate_buf_t *buf_retain(struct chip8_spectate_buf_t *buf)
+{
+    atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+    return buf;
+}
+
+static void buf_release(struct chip8_spectate_buf_t *buf)
+{
+    if (buf != NULL && atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) == 1)
+    {
+        free(buf);
+    }
+}
+
+static struct chip8_spectate_buf_t *encode_keyframe(uint32_t frame, const uint8_t *display)
+{
+    struct chip8_spectate_buf_t *buf = buf_new(frame, SPECTATE_KEYFRAME, SPECTATE_DISPLAY_NB);
+    if (buf != NULL)
+    {
+        memcpy(buf->data + sizeof(struct chip8_spectate_header_t), display, SPECTATE_DISPLAY_NB);
+    }
+    return buf;
+}
+
+static struct chip8_spectate_buf_t *encode_delta(uint32_t frame, const uint8_t *last, const uint8_t *display)
+{
+    uint8_t payload[3 * SPECTATE_DISPLAY_NB];
+    size_t len = 0;
+
+    size_t pos = 0;
+    while (pos < SPECTATE_DISPLAY_NB)
+    {
+        // bytes that didn't change
+        size_t skip = 0;
+        while (pos < SPECTATE_DISPLAY_NB && last[pos] == display[pos] && skip < 255)
+        {
+            skip++;
+            pos++;
+        }
+        if (pos == SPECTATE_DISPLAY_NB)
+        {
+            break;
+        }
+
+        // followed by bytes that did
+        size_t count = 0;
+        payload[len++] = skip;
+        uint8_t *count_at = payload + len++;
+        while (pos < SPECTATE_DISPLAY_NB && last[pos] != display[pos] && count < 255)
+        {
+            payload[len++] = last[pos] ^ display[pos];
+            count++;
+            pos++;
+        }
+        *count_at = count;
+    }
+
+    struct chip8_spectate_buf_t *buf = buf_new(frame, SPECTATE_DELTA, len);
+    if (buf != NULL)
+    {
+        memcpy(buf->data + sizeof(struct chip8_spectate_header_t), payload, len);
+    }
+    return buf;
+}
+
+// drop everything queued for a viewer except a message that's already
+// partly written, which has to be finished or the stream is corrupt
+static void viewer_drop(struct chip8_spectate_viewer_t *viewer)
+{
+    size_t keep = viewer->sent > 0 ? 1 : 0;
+    for (size_t i = keep; i < viewer->nb; i++)
+    {
+        buf_release(viewer->queue[(viewer->head + i) % SPECTATE_QUEUE_NB]);
+    }
+    viewer->nb = keep;
+}
+
+static void viewer_push(struct chip8_spectate_viewer_t *viewer, struct chip8_spectate_buf_t *buf)
+{
+    viewer->queue[(viewer->head + viewer->nb) % SPECTATE_QUEUE_NB] = buf_retain(buf);
+    viewer->nb += 1;
+}
+
+static void viewer_free(struct chip8_spectate_viewer_t *viewer)
+{
+    viewer->sent = 0;
+    viewer_drop(viewer);
+    close(viewer->fd);
+    free(viewer);
+}
+
+// write as much of the queue as the socket takes without blocking.
+// returns -1 if the viewer went away
+static int viewer_flush(struct chip8_spectate_viewer_t *viewer)
+{
+    while (viewer->nb > 0)
+    {
+        // the queue is far shorter than any IOV_MAX
+        struct iovec iov[SPECTATE_QUEUE_NB];
+        size_t iov_nb = viewer->nb;
+        for (size_t i = 0; i < iov_nb; i++)
+        {
+            const struct chip8_spectate_buf_t *buf = viewer->queue[(viewer->head + i) % SPECTATE_QUEUE_NB];
+            size_t offset = i == 0 ? viewer->sent : 0;
+            iov[i].iov_base = (void *)(buf->data + offset);
+            iov[i].iov_len = buf->len - offset;
+        }
+
+        // a viewer that hung up mustn't take the host down with SIGPIPE
+        const struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iov_nb};
+        ssize_t written = sendmsg(viewer->fd, &msg, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        // pop every message that went out completely
+        size_t left = written;
+        while (viewer->nb > 0)
+        {
+            struct chip8_spectate_buf_t *buf = viewer->queue[viewer->head];
+            size_t remaining = buf->len - viewer->sent;
+            if (left < remaining)
+            {
+                viewer->sent += left;
+                break;
+            }
+            left -= remaining;
+            viewer->sent = 0;
+            buf_release(buf);
+            viewer->head = (viewer->head + 1) % SPECTATE_QUEUE_NB;
+            viewer->nb -= 1;
+        }
+        if (viewer->nb > 0 && viewer->sent > 0)
+        {
+            // short write, the socket is full
+            return 0;
+        }
+    }
+    return 0;
+}
+
+static void accept_viewer(struct chip8_spectate_t *sp)
+{
+    int fd = accept(sp->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct chip8_spectate_viewer_t *viewer = calloc(1, sizeof(struct chip8_spectate_viewer_t));
+    if (viewer == NULL)
+    {
+        close(fd);
+        return;
+    }
+    viewer->fd = fd;
+    // late joiners start from a keyframe of the next frame
+    viewer->need_keyframe = 1;
+
+    pthread_mutex_lock(&sp->lock);
+    if (sp->viewers_nb < SPECTATE_VIEWERS_NB)
+    {
+        sp->viewers[sp->viewers_nb++] = viewer;
+        viewer = NULL;
+    }
+    pthread_mutex_unlock(&sp->lock);
+
+    if (viewer != NULL)
+    {
+        viewer_free(viewer);
+    }
+}
+
+static void *spectate_thread(void *arg)
+{
+    struct chip8_spectate_t *sp = arg;
+    struct pollfd fds[SPECTATE_VIEWERS_NB + 2];
+
+    while (atomic_load(&sp->running))
+    {
+        // only this thread adds or removes viewers, so the list can't
+        // change between building the poll set and using it
+        fds[0].fd = sp->wake[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = sp->listen_fd;
+        fds[1].events = POLLIN;
+
+        pthread_mutex_lock(&sp->lock);
+        size_t nb = sp->viewers_nb;
+        for (size_t i = 0; i < nb; i++)
+        {
+            fds[i + 2].fd = sp->viewers[i]->fd;
+            fds[i + 2].events = sp->viewers[i]->nb > 0 ? POLLOUT : 0;
+            fds[i + 2].revents = 0;
+        }
+        pthread_mutex_unlock(&sp->lock);
+
+        if (poll(fds, nb + 2, -1) < 0)
+        {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            char drain[64];
+            while (read(sp->wake[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+
+        // lock per viewer, so publish only ever waits for one sendmsg
+        for (size_t i = nb; i-- > 0;)
+        {
+            pthread_mutex_lock(&sp->lock);
+            struct chip8_spectate_viewer_t *viewer = sp->viewers[i];
+            int gone = (fds[i + 2].revents & (POLLERR | POLLHUP)) != 0;
+            if (!gone && viewer->nb > 0)
+            {
+                gone = viewer_flush(viewer) < 0;
+            }
+            if (gone)
+            {
+                sp->viewers[i] = sp->viewers[--sp->viewers_nb];
+            }
+            pthread_mutex_unlock(&sp->lock);
+
+            if (gone)
+            {
+                viewer_free(viewer);
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            accept_viewer(sp);
+        }
+    }
+    return NULL;
+}
+
+int chip8_spectate_t_start(struct chip8_spectate_t *sp, const char *path)
+{
+    memset(sp, 0, sizeof(struct chip8_spectate_t));
+
+    sp->listen_fd = sock_listen_unix(path, SOCK_STREAM);
+    if (sp->listen_fd < 0)
+    {
+        return -1;
+    }
+    if (pipe(sp->wake) < 0)
+    {
+        close(sp->listen_fd);
+        return -1;
+    }
+    fcntl(sp->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(sp->wake[1], F_SETFL, O_NONBLOCK);
+
+    pthread_mutex_init(&sp->lock, NULL);
+    atomic_store(&sp->running, 1);
+    if (pthread_create(&sp->thread, NULL, spectate_thread, sp) != 0)
+    {
+        close(sp->listen_fd);
+        close(sp->wake[0]);
+        close(sp->wake[1]);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_spectate_t_stop(struct chip8_spectate_t *sp)
+{
+    atomic_store(&sp->running, 0);
+    if (write(sp->wake[1], "", 1) < 0)
+    {
+        // the pipe is full, so the thread is about to wake up anyway
+    }
+    pthread_join(sp->thread, NULL);
+
+    for (size_t i = 0; i < sp->viewers_nb; i++)
+    {
+        viewer_free(sp->viewers[i]);
+    }
+    sp->viewers_nb = 0;
+    close(sp->listen_fd);
+    close(sp->wake[0]);
+    close(sp->wake[1]);
+    pthread_mutex_destroy(&sp->lock);
+}
+
+void chip8_spectate_t_publish(struct chip8_spectate_t *sp, const uint8_t *display)
+{
+    sp->frame += 1;
+    const int changed = memcmp(sp->last, display, SPECTATE_DISPLAY_NB) != 0;
+
+    // the delta is encoded outside the lock, keyframes only when
+    // some viewer turns out to need one
+    struct chip8_spectate_buf_t *delta = NULL;
+    struct chip8_spectate_buf_t *keyframe = NULL;
+    if (changed)
+    {
+        delta = encode_delta(sp->frame, sp->last, display);
+    }
+
+    int queued = 0;
+    pthread_mutex_lock(&sp->lock);
+    for (size_t i = 0; i < sp->viewers_nb; i++)
+    {
+        struct chip8_spectate_viewer_t *viewer = sp->viewers[i];
+
+        if (!viewer->need_keyframe && changed && viewer->nb == SPECTATE_QUEUE_NB)
+        {
+            // slow consumer, skip it ahead instead of waiting for it
+            viewer_drop(viewer);
+            viewer->need_keyframe = 1;
+            sp->drops += 1;
+        }
+
+        if (viewer->need_keyframe)
+        {
+            if (keyframe == NULL)
+            {
+                keyframe = encode_keyframe(sp->frame, display);
+            }
+            if (keyframe != NULL)
+            {
+                viewer_push(viewer, keyframe);
+                viewer->need_keyframe = 0;
+                queued = 1;
+            }
+        }
+        else if (delta != NULL)
+        {
+            viewer_push(viewer, delta);
+            queued = 1;
+        }
+    }
+    pthread_mutex_unlock(&sp->lock);
+
+    buf_release(delta);
+    buf_release(keyframe);
+    memcpy(sp->last, display, SPECTATE_DISPLAY_NB);
+
+    if (queued && write(sp->wake[1], "", 1) < 0)
+    {
+        // the pipe is full, so the thread is about to wake up anyway
+    }
+}
+
+int chip8_spectate_reader_t_open(struct chip8_spectate_reader_t *reader, const char *path)
+{
+    memset(reader, 0, sizeof(struct chip8_spectate_reader_t));
+    reader->fd = sock_connect_unix(path, SOCK_STREAM);
+    if (reader->fd < 0)
+    {
+        return -1;
+    }
+    fcntl(reader->fd, F_SETFL, fcntl(reader->fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+void chip8_spectate_reader_t_close(struct chip8_spectate_reader_t *reader)
+{
+    close(reader->fd);
+    reader->fd = -1;
+}
+
+static int apply(struct chip8_spectate_reader_t *reader, const struct chip8_spectate_header_t *header, const uint8_t *payload)
+{
+    if (header->type == SPECTATE_KEYFRAME)
+    {
+        if (header->len != SPECTATE_DISPLAY_NB)
+        {
+            return -1;
+        }
+        memcpy(reader->display, payload, SPECTATE_DISPLAY_NB);
+        reader->synced = 1;
+    }
+    else if (header->type == SPECTATE_DELTA)
+    {
+        size_t pos = 0;
+        size_t i = 0;
+        while (i + 2 <= header->len)
+        {
+            size_t skip = payload[i++];
+            size_t count = payload[i++];
+            pos += skip;
+            if (pos + count > SPECTATE_DISPLAY_NB || i + count > header->len)
+            {
+                return -1;
+            }
+            for (size_t j = 0; j < count; j++)
+            {
+                reader->display[pos++] ^= payload[i++];
+            }
+        }
+    }
+    else
+    {
+        return -1;
+    }
+    reader->frame = header->frame;
+    return 0;
+}
+
+int chip8_spectate_reader_t_poll(struct chip8_spectate_reader_t *reader)
+{
+    int changed = 0;
+    for (;;)
+    {
+        ssize_t size = read(reader->fd, reader->buf + reader->len, sizeof(reader->buf) - reader->len);
+        if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            return -1;
+        }
+        if (size > 0)
+        {
+            reader->len += size;
+        }
+
+        // apply every complete message in the buffer
+        size_t used = 0;
+        struct chip8_spectate_header_t header;
+        while (reader->len - used >= sizeof(header))
+        {
+            memcpy(&header, reader->buf + used, sizeof(header));
+            if (sizeof(header) + header.len > sizeof(reader->buf))
+            {
+                return -1;
+            }
+            if (reader->len - used < sizeof(header) + header.len)
+            {
+                break;
+            }
+            if (apply(reader, &header, reader->buf + used + sizeof(header)) < 0)
+            {
+                return -1;
+            }
+            changed = 1;
+            used += sizeof(header) + header.len;
+        }
+        memmove(reader->buf, reader->buf + used, reader->len - used);
+        reader->len -= used;
+
+        if (size < 0)
+        {
+            return changed && reader->synced;
+        }
+    }
+}
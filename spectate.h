@@ -0,0 +1,107 @@
+#ifndef CHIP8_SPECTATE_H
+#define CHIP8_SPECTATE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum spectate_constants
+{
+    SPECTATE_DISPLAY_NB = 32 * 64 / 8,
+
+    // message types
+    SPECTATE_KEYFRAME = 0, // the whole display
+    SPECTATE_DELTA = 1,    // what changed since the previous message
+
+    // messages a viewer may fall behind by. past that it's a slow
+    // consumer, its backlog is dropped and it gets a keyframe instead
+    SPECTATE_QUEUE_NB = 64,
+    SPECTATE_VIEWERS_NB = 1024
+};
+
+// every message is this header followed by len bytes of payload.
+// a keyframe payload is the display as is. a delta payload is a list of
+// (skip, count) byte pairs, each followed by count bytes to xor into the
+// display after skipping skip bytes
+struct chip8_spectate_header_t
+{
+    uint32_t frame;
+    uint16_t len;
+    uint8_t type;
+    uint8_t reserved;
+};
+
+// an encoded message, shared by every viewer it's queued for
+struct chip8_spectate_buf_t
+{
+    atomic_uint refs;
+    size_t len;
+    uint8_t data[];
+};
+
+struct chip8_spectate_viewer_t
+{
+    int fd;
+    // joined late or fell behind, the next message it gets is a keyframe
+    int need_keyframe;
+    // bytes of the first queued message already written
+    size_t sent;
+    struct chip8_spectate_buf_t *queue[SPECTATE_QUEUE_NB];
+    size_t head;
+    size_t nb;
+};
+
+// broadcasts the display of one session to any number of read-only viewers.
+// every frame is encoded once and the same buffer is queued for every
+// viewer, and a separate thread writes the queues out with sendmsg, so a
+// slow viewer can never hold up emulation
+struct chip8_spectate_t
+{
+    int listen_fd;
+    // written to by publish to wake the sending thread up
+    int wake[2];
+    pthread_t thread;
+    atomic_int running;
+
+    // protects the viewers and their queues
+    pthread_mutex_t lock;
+    struct chip8_spectate_viewer_t *viewers[SPECTATE_VIEWERS_NB];
+    size_t viewers_nb;
+
+    // the display as of the last published frame
+    uint8_t last[SPECTATE_DISPLAY_NB];
+    uint32_t frame;
+
+    // times a viewer's backlog was dropped
+    uint64_t drops;
+};
+
+// listen for viewers on a unix socket and start the sending thread
+int chip8_spectate_t_start(struct chip8_spectate_t *sp, const char *path);
+void chip8_spectate_t_stop(struct chip8_spectate_t *sp);
+
+// send a frame to every viewer, only encodes anything if the display changed
+// or a viewer is waiting for a keyframe. never blocks on a socket
+void chip8_spectate_t_publish(struct chip8_spectate_t *sp, const uint8_t *display);
+
+// the viewer side: reassembles messages from a non-blocking socket
+struct chip8_spectate_reader_t
+{
+    int fd;
+    uint8_t display[SPECTATE_DISPLAY_NB];
+    uint32_t frame;
+    // waiting for the first keyframe
+    int synced;
+    uint8_t buf[sizeof(struct chip8_spectate_header_t) + 3 * SPECTATE_DISPLAY_NB];
+    size_t len;
+};
+
+int chip8_spectate_reader_t_open(struct chip8_spectate_reader_t *reader, const char *path);
+void chip8_spectate_reader_t_close(struct chip8_spectate_reader_t *reader);
+
+// read whatever arrived. returns 1 if the display changed, 0 if not,
+// -1 if the session ended or sent something we can't decode
+int chip8_spectate_reader_t_poll(struct chip8_spectate_reader_t *reader);
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../spectate.h"
+
+// viewers that hang up mid-stream, with frames still queued for them,
+// must not take the host down, and the ones still watching keep up
+
+enum
+{
+    // hanging up between poll and the write is a race, give it a few goes
+    ROUNDS_NB = 10,
+    VIEWERS_NB = 200,
+    FRAMES_NB = 2000
+};
+
+// returns 0 if the viewer that stayed saw the last frame
+static int round_run(const char *path)
+{
+    static struct chip8_spectate_t sp;
+    if (chip8_spectate_t_start(&sp, path) < 0)
+    {
+        printf("spectate: could not listen on %s\n", path);
+        return -1;
+    }
+
+    static struct chip8_spectate_reader_t readers[VIEWERS_NB];
+    for (int i = 0; i < VIEWERS_NB; i++)
+    {
+        if (chip8_spectate_reader_t_open(readers + i, path) < 0)
+        {
+            printf("spectate: could not connect\n");
+            return -1;
+        }
+    }
+
+    // every viewer but the first reads a little and hangs up while frames
+    // keep going out, so some hang up in the middle of being written to
+    static uint8_t display[SPECTATE_DISPLAY_NB];
+    for (int frame = 0; frame < FRAMES_NB; frame++)
+    {
+        display[frame % SPECTATE_DISPLAY_NB] ^= (uint8_t)(frame | 1);
+        chip8_spectate_t_publish(&sp, display);
+        const int i = frame * VIEWERS_NB / FRAMES_NB;
+        if (i > 0 && frame % (FRAMES_NB / VIEWERS_NB) == 0)
+        {
+            chip8_spectate_reader_t_poll(readers + i);
+            chip8_spectate_reader_t_close(readers + i);
+        }
+        if (chip8_spectate_reader_t_poll(readers) < 0)
+        {
+            printf("spectate: the viewer still watching was cut off\n");
+            return -1;
+        }
+    }
+
+    // let the last frames through
+    for (int i = 0; i < 100 && memcmp(readers[0].display, display, sizeof(display)) != 0; i++)
+    {
+        usleep(10000);
+        chip8_spectate_reader_t_poll(readers);
+    }
+    const int ok = readers[0].synced && memcmp(readers[0].display, display, sizeof(display)) == 0;
+    chip8_spectate_reader_t_close(readers);
+    chip8_spectate_t_stop(&sp);
+    unlink(path);
+    if (!ok)
+    {
+        printf("spectate: the viewer still watching missed frames\n");
+    }
+    return ok ? 0 : -1;
+}
+
+int main(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/chip8-spectate-test-%d.sock", (int)getpid());
+    for (int r = 0; r < ROUNDS_NB; r++)
+    {
+        if (round_run(path) < 0)
+        {
+            return 1;
+        }
+    }
+    printf("spectate: ok\n");
+    return 0;
+}
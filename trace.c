@@ -0,0 +1,463 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "undo.h"
+
+static const char TRACE_MAGIC[8] = "CH8TRACE";
+
+static size_t segment_size(size_t cycles_nb, size_t writes_nb)
+{
+    return sizeof(struct chip8_trace_header_t) + 2 * (MEM_NB + 1) * sizeof(uint32_t) +
+           (cycles_nb + writes_nb) * sizeof(uint32_t) + (cycles_nb + 1) * sizeof(uint16_t) + writes_nb;
+}
+
+static void segment_path(char *path, const char *dir, size_t i)
+{
+    snprintf(path, TRACE_PATH_NB + 16, "%s/%06zu.seg", dir, i);
+}
+
+int chip8_trace_t_open(struct chip8_trace_t *t, const char *dir, const union chip8_t *c8)
+{
+    memset(t, 0, sizeof(*t));
+    if (strlen(dir) >= sizeof(t->dir))
+    {
+        return -1;
+    }
+    strcpy(t->dir, dir);
+    t->pcs = malloc((TRACE_SEGMENT_CYCLES + 1) * sizeof(uint16_t));
+    if (t->pcs == NULL)
+    {
+        return -1;
+    }
+    memcpy(&t->keyframe, c8, sizeof(t->keyframe));
+    memcpy(t->keys, c8->keys, sizeof(t->keys));
+    return 0;
+}
+
+static int add_write(struct chip8_trace_t *t, uint16_t addr, uint8_t value)
+{
+    if (t->writes_nb == t->writes_cap)
+    {
+        const size_t cap = t->writes_cap ? t->writes_cap * 2 : 1 << 16;
+        uint32_t *cycles = realloc(t->write_cycles, cap * sizeof(uint32_t));
+        if (cycles != NULL)
+        {
+            t->write_cycles = cycles;
+        }
+        uint16_t *addrs = realloc(t->write_addrs, cap * sizeof(uint16_t));
+        if (addrs != NULL)
+        {
+            t->write_addrs = addrs;
+        }
+        uint8_t *values = realloc(t->write_values, cap);
+        if (values != NULL)
+        {
+            t->write_values = values;
+        }
+        if (cycles == NULL || addrs == NULL || values == NULL)
+        {
+            return -1;
+        }
+        t->writes_cap = cap;
+    }
+    t->write_cycles[t->writes_nb] = t->cycles_nb;
+    t->write_addrs[t->writes_nb] = addr;
+    t->write_values[t->writes_nb] = value;
+    t->writes_nb++;
+    return 0;
+}
+
+// group the cycles of the segment by PC and the writes by address, with a
+// counting sort so each group stays in cycle order, and write it all out
+static int flush(struct chip8_trace_t *t, const union chip8_t *c8)
+{
+    const size_t n = t->cycles_nb;
+    const size_t m = t->writes_nb;
+    t->pcs[n] = c8->PC;
+
+    static uint32_t pc_index[MEM_NB + 1];
+    static uint32_t write_index[MEM_NB + 1];
+    uint32_t *pc_cycles = malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *write_cycles = malloc((m + 1) * sizeof(uint32_t));
+    uint8_t *write_values = malloc(m + 1);
+
+    int status = -1;
+    char path[TRACE_PATH_NB + 16];
+    segment_path(path, t->dir, t->segments_nb);
+    FILE *f = NULL;
+    if (pc_cycles == NULL || write_cycles == NULL || write_values == NULL || (f = fopen(path, "wb")) == NULL)
+    {
+        goto out;
+    }
+
+    memset(pc_index, 0, sizeof(pc_index));
+    memset(write_index, 0, sizeof(write_index));
+    for (size_t i = 0; i < n; i++)
+    {
+        pc_index[(t->pcs[i] & (MEM_NB - 1)) + 1]++;
+    }
+    for (size_t i = 0; i < m; i++)
+    {
+        write_index[t->write_addrs[i] + 1]++;
+    }
+    for (size_t i = 0; i < MEM_NB; i++)
+    {
+        pc_index[i + 1] += pc_index[i];
+        write_index[i + 1] += write_index[i];
+    }
+    // fill each group from its start, then shift the starts back
+    for (size_t i = 0; i < n; i++)
+    {
+        pc_cycles[pc_index[t->pcs[i] & (MEM_NB - 1)]++] = i;
+    }
+    for (size_t i = 0; i < m; i++)
+    {
+        const uint32_t j = write_index[t->write_addrs[i]]++;
+        write_cycles[j] = t->write_cycles[i];
+        write_values[j] = t->write_values[i];
+    }
+    memmove(pc_index + 1, pc_index, MEM_NB * sizeof(uint32_t));
+    memmove(write_index + 1, write_index, MEM_NB * sizeof(uint32_t));
+    pc_index[0] = 0;
+    write_index[0] = 0;
+
+    static struct chip8_trace_header_t header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.cycle = t->cycle - n;
+    header.cycles_nb = n;
+    header.writes_nb = m;
+    memcpy(&header.keyframe, &t->keyframe, sizeof(header.keyframe));
+
+    if (fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(pc_index, sizeof(pc_index), 1, f) == 1 &&
+        fwrite(write_index, sizeof(write_index), 1, f) == 1 && fwrite(pc_cycles, sizeof(uint32_t), n, f) == n &&
+        fwrite(write_cycles, sizeof(uint32_t), m, f) == m && fwrite(t->pcs, sizeof(uint16_t), n + 1, f) == n + 1 &&
+        fwrite(write_values, 1, m, f) == m)
+    {
+        status = 0;
+    }
+
+out:
+    if (f != NULL && fclose(f) != 0)
+    {
+        status = -1;
+    }
+    free(pc_cycles);
+    free(write_cycles);
+    free(write_values);
+
+    // start the next segment here either way
+    t->segments_nb++;
+    memcpy(&t->keyframe, c8, sizeof(t->keyframe));
+    memcpy(t->keyframe.keys, t->keys, sizeof(t->keys));
+    t->cycles_nb = 0;
+    t->writes_nb = 0;
+    return status;
+}
+
+int chip8_trace_t_step(struct chip8_trace_t *t, union chip8_t *c8)
+{
+    int status = 0;
+    if (t->cycles_nb == TRACE_SEGMENT_CYCLES)
+    {
+        status = flush(t, c8);
+    }
+
+    // the host changing the keys counts as a write by this instruction
+    for (size_t i = 0; i < sizeof(t->keys); i++)
+    {
+        if (c8->keys[i] != t->keys[i] && add_write(t, offsetof(union chip8_t, keys) + i, c8->keys[i]) < 0)
+        {
+            status = -1;
+        }
+    }
+
+    struct chip8_undo_span_t spans[UNDO_SPANS_NB];
+    const size_t spans_nb = chip8_undo_writes(c8, spans);
+    uint8_t old[UNDO_RECORD_NB];
+    memcpy(old, c8->memory + spans[0].off, spans[0].len);
+
+    t->pcs[t->cycles_nb] = c8->PC;
+    chip8_t_emulate_cycle(c8);
+
+    // never PC, that's in pcs. then the timers and SP when they changed,
+    // unless a later span stores them anyway
+    const size_t pc = offsetof(union chip8_t, PC);
+    for (size_t j = 0; j < spans[0].len; j++)
+    {
+        const size_t addr = spans[0].off + j;
+        int stored = addr >= pc && addr < pc + sizeof(c8->PC);
+        for (size_t i = 1; i < spans_nb && !stored; i++)
+        {
+            stored = addr >= spans[i].off && addr < spans[i].off + spans[i].len;
+        }
+        if (!stored && c8->memory[addr] != old[j] && add_write(t, addr, c8->memory[addr]) < 0)
+        {
+            status = -1;
+        }
+    }
+    // and everything else the instruction wrote, even if it's unchanged
+    for (size_t i = 1; i < spans_nb; i++)
+    {
+        for (size_t j = 0; j < spans[i].len; j++)
+        {
+            const size_t addr = spans[i].off + j;
+            if ((addr < pc || addr >= pc + sizeof(c8->PC)) && add_write(t, addr, c8->memory[addr]) < 0)
+            {
+                status = -1;
+            }
+        }
+    }
+
+    t->cycles_nb++;
+    t->cycle++;
+    memcpy(t->keys, c8->keys, sizeof(t->keys));
+    return status;
+}
+
+int chip8_trace_t_close(struct chip8_trace_t *t, const union chip8_t *c8)
+{
+    const int status = flush(t, c8);
+    free(t->pcs);
+    free(t->write_cycles);
+    free(t->write_addrs);
+    free(t->write_values);
+    memset(t, 0, sizeof(*t));
+    return status;
+}
+
+static int map_segment(struct chip8_trace_segment_t *seg, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct chip8_trace_header_t))
+    {
+        close(fd);
+        return -1;
+    }
+    // the mapping stays valid after the descriptor is closed
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    const struct chip8_trace_header_t *h = map;
+    if (memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 ||
+        (size_t)st.st_size != segment_size(h->cycles_nb, h->writes_nb))
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    seg->header = h;
+    seg->size = st.st_size;
+    seg->pc_index = (const uint32_t *)(h + 1);
+    seg->write_index = seg->pc_index + MEM_NB + 1;
+    seg->pc_cycles = seg->write_index + MEM_NB + 1;
+    seg->write_cycles = seg->pc_cycles + h->cycles_nb;
+    seg->pcs = (const uint16_t *)(seg->write_cycles + h->writes_nb);
+    seg->write_values = (const uint8_t *)(seg->pcs + h->cycles_nb + 1);
+    return 0;
+}
+
+int chip8_trace_db_t_open(struct chip8_trace_db_t *db, const char *dir)
+{
+    memset(db, 0, sizeof(*db));
+    char path[TRACE_PATH_NB + 16];
+    for (size_t i = 0;; i++)
+    {
+        segment_path(path, dir, i);
+        if (access(path, F_OK) < 0)
+        {
+            break;
+        }
+        struct chip8_trace_segment_t *segments = realloc(db->segments, (i + 1) * sizeof(*segments));
+        if (segments == NULL)
+        {
+            chip8_trace_db_t_close(db);
+            return -1;
+        }
+        db->segments = segments;
+        memset(segments + i, 0, sizeof(*segments));
+        // each segment starts where the last one ended
+        if (map_segment(segments + i, path) < 0 || segments[i].header->cycle != db->cycles_nb)
+        {
+            if (segments[i].header != NULL)
+            {
+                munmap((void *)segments[i].header, segments[i].size);
+            }
+            chip8_trace_db_t_close(db);
+            return -1;
+        }
+        db->segments_nb++;
+        db->cycles_nb += segments[i].header->cycles_nb;
+    }
+    if (db->segments_nb == 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_trace_db_t_close(struct chip8_trace_db_t *db)
+{
+    for (size_t i = 0; i < db->segments_nb; i++)
+    {
+        munmap((void *)db->segments[i].header, db->segments[i].size);
+    }
+    free(db->segments);
+    memset(db, 0, sizeof(*db));
+}
+
+// the segment holding the state after cycle instructions.
+// the state at the end of one segment is the first of the next
+static size_t find_segment(const struct chip8_trace_db_t *db, uint64_t cycle)
+{
+    size_t lo = 0;
+    size_t hi = db->segments_nb;
+    while (hi - lo > 1)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (db->segments[mid].header->cycle <= cycle)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// first index in [lo, hi) with a[i] >= v
+static size_t lower_bound(const uint32_t *a, size_t lo, size_t hi, uint32_t v)
+{
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (a[mid] < v)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// index into write_cycles of the last write to addr before cycle rel of
+// the segment, or -1
+static int64_t last_write(const struct chip8_trace_segment_t *seg, uint16_t addr, uint32_t rel)
+{
+    const size_t first = seg->write_index[addr];
+    const size_t i = lower_bound(seg->write_cycles, first, seg->write_index[addr + 1], rel);
+    return i > first ? (int64_t)i - 1 : -1;
+}
+
+int64_t chip8_trace_db_t_last_write(const struct chip8_trace_db_t *db, uint16_t addr, uint64_t cycle)
+{
+    if (addr >= MEM_NB)
+    {
+        return -1;
+    }
+    if (cycle > db->cycles_nb)
+    {
+        cycle = db->cycles_nb;
+    }
+    for (size_t s = find_segment(db, cycle) + 1; s-- > 0;)
+    {
+        const struct chip8_trace_segment_t *seg = db->segments + s;
+        const uint64_t rel = cycle - seg->header->cycle;
+        const int64_t i = last_write(seg, addr, rel < seg->header->cycles_nb ? rel : seg->header->cycles_nb);
+        if (i >= 0)
+        {
+            return seg->header->cycle + seg->write_cycles[i];
+        }
+        cycle = seg->header->cycle;
+    }
+    return -1;
+}
+
+size_t chip8_trace_db_t_pc_cycles(const struct chip8_trace_db_t *db, uint16_t pc, uint64_t cycle, uint64_t *out,
+                                  size_t nb)
+{
+    if (cycle >= db->cycles_nb)
+    {
+        return 0;
+    }
+    size_t found = 0;
+    const size_t bucket = pc & (MEM_NB - 1);
+    for (size_t s = find_segment(db, cycle); s < db->segments_nb && found < nb; s++)
+    {
+        const struct chip8_trace_segment_t *seg = db->segments + s;
+        const uint64_t start = seg->header->cycle;
+        const size_t last = seg->pc_index[bucket + 1];
+        size_t i = lower_bound(seg->pc_cycles, seg->pc_index[bucket], last, cycle > start ? cycle - start : 0);
+        for (; i < last && found < nb; i++)
+        {
+            // PCs past the end of memory share a bucket with one inside it
+            if (seg->pcs[seg->pc_cycles[i]] == pc)
+            {
+                out[found++] = start + seg->pc_cycles[i];
+            }
+        }
+    }
+    return found;
+}
+
+int chip8_trace_db_t_value(const struct chip8_trace_db_t *db, uint16_t addr, uint64_t cycle)
+{
+    if (addr >= MEM_NB || cycle > db->cycles_nb)
+    {
+        return -1;
+    }
+    const struct chip8_trace_segment_t *seg = db->segments + find_segment(db, cycle);
+    const uint32_t rel = cycle - seg->header->cycle;
+
+    const size_t pc = offsetof(union chip8_t, PC);
+    if (addr >= pc && addr < pc + sizeof(uint16_t))
+    {
+        uint8_t bytes[sizeof(uint16_t)];
+        memcpy(bytes, seg->pcs + rel, sizeof(bytes));
+        return bytes[addr - pc];
+    }
+
+    const int64_t i = last_write(seg, addr, rel);
+    return i >= 0 ? seg->write_values[i] : seg->header->keyframe.memory[addr];
+}
+
+int chip8_trace_db_t_state(const struct chip8_trace_db_t *db, uint64_t cycle, union chip8_t *c8)
+{
+    if (cycle > db->cycles_nb)
+    {
+        return -1;
+    }
+    const struct chip8_trace_segment_t *seg = db->segments + find_segment(db, cycle);
+    const uint32_t rel = cycle - seg->header->cycle;
+
+    memcpy(c8, &seg->header->keyframe, sizeof(*c8));
+    for (size_t addr = 0; addr < MEM_NB; addr++)
+    {
+        const int64_t i = last_write(seg, addr, rel);
+        if (i >= 0)
+        {
+            c8->memory[addr] = seg->write_values[i];
+        }
+    }
+    c8->PC = seg->pcs[rel];
+    return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef CHIP8_TRACE_H
+#define CHIP8_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum trace_constants
+{
+    // instructions in a segment file
+    TRACE_SEGMENT_CYCLES = 1 << 22,
+
+    TRACE_PATH_NB = 256
+};
+
+// a segment file is this header, then
+//   uint32_t pc_index[MEM_NB + 1]     where each PC's cycles start in pc_cycles
+//   uint32_t write_index[MEM_NB + 1]  where each address' writes start
+//   uint32_t pc_cycles[cycles_nb]     cycles grouped by PC, in order
+//   uint32_t write_cycles[writes_nb]  cycles grouped by address, in order
+//   uint16_t pcs[cycles_nb + 1]       PC before each cycle, and at the end
+//   uint8_t write_values[writes_nb]   the value each write left behind
+// cycles in the file count from the header's cycle
+struct chip8_trace_header_t
+{
+    char magic[8];
+    uint64_t cycle;
+    uint32_t cycles_nb;
+    uint32_t writes_nb;
+
+    // the state at the first cycle
+    union chip8_t keyframe;
+};
+
+// records a run into numbered segment files in a directory, indexing every
+// byte an instruction writes by address, even with the value it already had,
+// and every cycle by PC. PC itself is kept as a plain array instead of as
+// writes, and the timers and SP count as written when they change
+struct chip8_trace_t
+{
+    char dir[TRACE_PATH_NB];
+    size_t segments_nb;
+
+    union chip8_t keyframe;
+    uint64_t cycle;
+    uint32_t cycles_nb;
+
+    uint16_t *pcs;
+
+    // writes of the current segment in the order they happened
+    uint32_t *write_cycles;
+    uint16_t *write_addrs;
+    uint8_t *write_values;
+    size_t writes_nb;
+    size_t writes_cap;
+
+    // keys as of the last instruction, to notice the host changing them
+    uint8_t keys[16];
+};
+
+// start recording c8 into dir, which has to exist.
+// returns -1 if we're out of memory
+int chip8_trace_t_open(struct chip8_trace_t *t, const char *dir, const union chip8_t *c8);
+
+// run and record the instruction at PC. returns -1 if a full segment
+// couldn't be written out, the instruction is still run
+int chip8_trace_t_step(struct chip8_trace_t *t, union chip8_t *c8);
+
+// write the last segment and free everything. c8 is where the run ended.
+// returns -1 if it couldn't be written
+int chip8_trace_t_close(struct chip8_trace_t *t, const union chip8_t *c8);
+
+// a mapped segment file
+struct chip8_trace_segment_t
+{
+    const struct chip8_trace_header_t *header;
+    size_t size;
+
+    const uint32_t *pc_index;
+    const uint32_t *write_index;
+    const uint32_t *pc_cycles;
+    const uint32_t *write_cycles;
+    const uint16_t *pcs;
+    const uint8_t *write_values;
+};
+
+// a recorded trace, answering queries from the indexes without replaying
+struct chip8_trace_db_t
+{
+    struct chip8_trace_segment_t *segments;
+    size_t segments_nb;
+
+    // instructions recorded, states go from cycle 0 to here
+    uint64_t cycles_nb;
+};
+
+// map every segment in dir. returns -1 if there are none or one is broken
+int chip8_trace_db_t_open(struct chip8_trace_db_t *db, const char *dir);
+void chip8_trace_db_t_close(struct chip8_trace_db_t *db);
+
+// the last cycle before cycle that wrote the byte at addr, -1 if none did
+int64_t chip8_trace_db_t_last_write(const struct chip8_trace_db_t *db, uint16_t addr, uint64_t cycle);
+
+// up to nb cycles from cycle on where PC == pc. returns how many were found
+size_t chip8_trace_db_t_pc_cycles(const struct chip8_trace_db_t *db, uint16_t pc, uint64_t cycle, uint64_t *out,
+                                  size_t nb);
+
+// the byte at addr after cycle instructions, -1 if the trace is shorter.
+// V[n] is at offsetof(union chip8_t, V) + n
+int chip8_trace_db_t_value(const struct chip8_trace_db_t *db, uint16_t addr, uint64_t cycle);
+
+// the whole state after cycle instructions. returns -1 if the trace is shorter
+int chip8_trace_db_t_state(const struct chip8_trace_db_t *db, uint64_t cycle, union chip8_t *c8);
+
+#endif
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "chip8.h"
+#include "rom.h"
+#include "trace.h"
+
+// records a run as an indexed trace, or answers queries about one:
+//   ./chip8-trace --record DIR [--frames N] [--keys MASK] ROM
+//   ./chip8-trace DIR
+// the second form reads queries from stdin, a cycle is the state after
+// that many instructions:
+//   last ADDR CYCLE    when the byte at ADDR was last written before CYCLE
+//   pc ADDR [CYCLE]    the first cycles from CYCLE on where PC == ADDR
+//   v N CYCLE          the value of VN at CYCLE
+//   mem ADDR CYCLE     the byte at ADDR at CYCLE
+//   regs CYCLE         every register at CYCLE
+//   quit
+
+enum tracedb_constants
+{
+    LIST_NB = 32
+};
+
+void usage(void)
+{
+    fprintf(stderr, "USAGE: ./chip8-trace --record DIR [--frames N] [--keys MASK] ROM\n"
+                    "       ./chip8-trace DIR\n");
+    exit(1);
+}
+
+static int record(const char *dir, const char *rom_path, long frames, uint16_t keys)
+{
+    struct chip8_rom_t *rom = chip8_rom_t_load(rom_path);
+    if (rom == NULL)
+    {
+        fprintf(stderr, "Could not open ROM %s\n", rom_path);
+        return 1;
+    }
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Could not create %s\n", dir);
+        return 1;
+    }
+
+    union chip8_t c8;
+    chip8_rom_t_boot(rom, &c8);
+    chip8_t_set_keys(&c8, keys);
+    chip8_rom_t_release(rom);
+
+    static struct chip8_trace_t t;
+    if (chip8_trace_t_open(&t, dir, &c8) < 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    int status = 0;
+    for (long i = 0; i < frames * CYCLES_PER_FRAME; i++)
+    {
+        status |= chip8_trace_t_step(&t, &c8);
+    }
+    status |= chip8_trace_t_close(&t, &c8);
+    if (status < 0)
+    {
+        fprintf(stderr, "Could not write the trace to %s\n", dir);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    long frames = 600;
+    uint16_t keys = 0;
+    const char *record_dir = NULL;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            keys = strtol(argv[++i], NULL, 0);
+        }
+        else if (path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (path == NULL || frames < 0)
+    {
+        usage();
+    }
+    if (record_dir != NULL)
+    {
+        return record(record_dir, path, frames, keys);
+    }
+
+    static struct chip8_trace_db_t db;
+    if (chip8_trace_db_t_open(&db, path) < 0)
+    {
+        fprintf(stderr, "Could not open the trace in %s\n", path);
+        return 1;
+    }
+    printf("%llu cycles\n", (unsigned long long)db.cycles_nb);
+
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char cmd[16];
+        long long a = -1;
+        long long b = -1;
+        if (sscanf(line, "%15s %lli %lli", cmd, &a, &b) < 1)
+        {
+            continue;
+        }
+
+        if (strcmp(cmd, "last") == 0 && a >= 0 && a < MEM_NB && b >= 0)
+        {
+            printf("%lld\n", (long long)chip8_trace_db_t_last_write(&db, a, b));
+        }
+        else if (strcmp(cmd, "pc") == 0 && a >= 0 && a <= UINT16_MAX)
+        {
+            uint64_t cycles[LIST_NB];
+            const size_t nb = chip8_trace_db_t_pc_cycles(&db, a, b < 0 ? 0 : b, cycles, LIST_NB);
+            for (size_t i = 0; i < nb; i++)
+            {
+                printf("%llu%c", (unsigned long long)cycles[i], i + 1 == nb ? '\n' : ' ');
+            }
+            if (nb == 0)
+            {
+                printf("none\n");
+            }
+        }
+        else if (strcmp(cmd, "v") == 0 && a >= 0 && a < 16 && b >= 0)
+        {
+            printf("%d\n", chip8_trace_db_t_value(&db, offsetof(union chip8_t, V) + a, b));
+        }
+        else if (strcmp(cmd, "mem") == 0 && a >= 0 && a < MEM_NB && b >= 0)
+        {
+            printf("%d\n", chip8_trace_db_t_value(&db, a, b));
+        }
+        else if (strcmp(cmd, "regs") == 0 && a >= 0)
+        {
+            union chip8_t c8;
+            if (chip8_trace_db_t_state(&db, a, &c8) < 0)
+            {
+                printf("out of range\n");
+            }
+            else
+            {
+                for (size_t i = 0; i < 16; i++)
+                {
+                    printf("V%zX=%02X%c", i, c8.V[i], i == 7 || i == 15 ? '\n' : ' ');
+                }
+                printf("PC=%03X I=%03X DT=%02X ST=%02X SP=%02X\n", c8.PC, c8.I, c8.DT, c8.ST, c8.SP);
+            }
+        }
+        else if (strcmp(cmd, "quit") == 0)
+        {
+            break;
+        }
+        else
+        {
+            printf("?\n");
+        }
+        fflush(stdout);
+    }
+
+    chip8_trace_db_t_close(&db);
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "undo.h"
+
+// a record is a list of runs of (old bytes, offset: 2 bytes, length: 1 byte)
+// followed by the number of runs, so the log can be read from the end
+struct undo_record_t
+{
+    uint8_t bytes[UNDO_RECORD_NB];
+    size_t len;
+    uint8_t runs;
+};
+
+static void save_bytes(struct undo_record_t *r, size_t off, const uint8_t *old, size_t n)
+{
+    while (n > 0)
+    {
+        const size_t run = n < 255 ? n : 255;
+        memcpy(r->bytes + r->len, old, run);
+        r->bytes[r->len + run] = off & 0xFF;
+        r->bytes[r->len + run + 1] = off >> 8;
+        r->bytes[r->len + run + 2] = run;
+        r->len += run + 3;
+        r->runs++;
+        off += run;
+        old += run;
+        n -= run;
+    }
+}
+
+static void span(struct chip8_undo_span_t *spans, size_t *nb, size_t off, size_t len)
+{
+    // I can point anywhere, the part past the end isn't ours to save
+    if (off >= MEM_NB)
+    {
+        return;
+    }
+    if (len > MEM_NB - off)
+    {
+        len = MEM_NB - off;
+    }
+    spans[*nb].off = off;
+    spans[*nb].len = len;
+    *nb += 1;
+}
+
+#define SPAN(spans, nb, c8, field) span(spans, nb, offsetof(union chip8_t, field), sizeof((c8)->field))
+
+size_t chip8_undo_writes(const union chip8_t *c8, struct chip8_undo_span_t *spans)
+{
+    // PC past the end is a bug in the rom, don't make it one of ours
+    const uint16_t pc = c8->PC & (MEM_NB - 1);
+    const struct chip8_insn_t in =
+        chip8_insn_t_decode((c8->memory[pc] << 8) | c8->memory[(pc + 1) & (MEM_NB - 1)]);
+    size_t nb = 0;
+
+    // every instruction moves PC and ticks the timers.
+    // DT, ST, SP and PC sit next to each other
+    const size_t regs = offsetof(union chip8_t, DT);
+    span(spans, &nb, regs, offsetof(union chip8_t, PC) + sizeof(c8->PC) - regs);
+
+    switch (in.op)
+    {
+    case 0x0:
+        if (in.n == 0x0)
+        {
+            // the display is followed by draw_flag
+            span(spans, &nb, offsetof(union chip8_t, display), sizeof(c8->display) + 1);
+        }
+        break;
+    case 0x2:
+        span(spans, &nb, offsetof(union chip8_t, stack) + c8->SP * sizeof(uint16_t), sizeof(uint16_t));
+        if (offsetof(union chip8_t, stack) + c8->SP * sizeof(uint16_t) >= PROG_START)
+        {
+            SPAN(spans, &nb, c8, dirty_pages);
+        }
+        break;
+    case 0x6:
+    case 0x7:
+        SPAN(spans, &nb, c8, V[in.x]);
+        break;
+    case 0x8:
+        SPAN(spans, &nb, c8, V[in.x]);
+        if (in.n >= 0x4)
+        {
+            SPAN(spans, &nb, c8, V[0xF]);
+        }
+        break;
+    case 0xA:
+        SPAN(spans, &nb, c8, I);
+        break;
+    case 0xC:
+        SPAN(spans, &nb, c8, V[in.x]);
+        SPAN(spans, &nb, c8, rng);
+        break;
+    case 0xD:
+        SPAN(spans, &nb, c8, V[0xF]);
+        SPAN(spans, &nb, c8, draw_flag);
+        // each sprite row touches two bytes of a display row, the second
+        // one wrapping around to the start of the row
+        for (size_t row = 0; row < in.n; row++)
+        {
+            const size_t start = offsetof(union chip8_t, display) + ((c8->V[in.y] + row) % 32) * 8;
+            const size_t col = (c8->V[in.x] % 64) / 8;
+            span(spans, &nb, start + col, 1);
+            if (c8->V[in.x] % 8 != 0)
+            {
+                span(spans, &nb, start + (col + 1) % 8, 1);
+            }
+        }
+        break;
+    case 0xF:
+        if (in.kk == 0x07 || in.kk == 0x0A)
+        {
+            SPAN(spans, &nb, c8, V[in.x]);
+        }
+        else if (in.kk == 0x15)
+        {
+            // in the first span already, but stored even if it's the same
+            SPAN(spans, &nb, c8, DT);
+        }
+        else if (in.kk == 0x18)
+        {
+            SPAN(spans, &nb, c8, ST);
+        }
+        else if (in.kk == 0x1E)
+        {
+            SPAN(spans, &nb, c8, V[0xF]);
+            SPAN(spans, &nb, c8, I);
+        }
+        else if (in.kk == 0x29)
+        {
+            SPAN(spans, &nb, c8, I);
+        }
+        else if (in.kk == 0x33)
+        {
+            span(spans, &nb, c8->I, 3);
+            SPAN(spans, &nb, c8, dirty_pages);
+        }
+        else if (in.kk == 0x55)
+        {
+            span(spans, &nb, c8->I, in.x + 1);
+            SPAN(spans, &nb, c8, dirty_pages);
+            SPAN(spans, &nb, c8, I);
+        }
+        else if (in.kk == 0x65)
+        {
+            span(spans, &nb, offsetof(union chip8_t, V), in.x + 1);
+            SPAN(spans, &nb, c8, I);
+        }
+        break;
+    }
+    return nb;
+}
+
+int chip8_undo_t_init(struct chip8_undo_t *u, size_t segments_nb)
+{
+    memset(u, 0, sizeof(*u));
+    u->segments = calloc(segments_nb, sizeof(struct chip8_undo_segment_t));
+    if (segments_nb == 0 || u->segments == NULL)
+    {
+        chip8_undo_t_destroy(u);
+        return -1;
+    }
+    u->nb = segments_nb;
+    return 0;
+}
+
+void chip8_undo_t_destroy(struct chip8_undo_t *u)
+{
+    for (size_t i = 0; i < u->nb; i++)
+    {
+        free(u->segments[i].log);
+    }
+    free(u->segments);
+    memset(u, 0, sizeof(*u));
+}
+
+static struct chip8_undo_segment_t *segment(const struct chip8_undo_t *u, size_t i)
+{
+    return u->segments + (u->first + i) % u->nb;
+}
+
+// start a segment at the current cycle, dropping the oldest if they're
+// all in use
+static struct chip8_undo_segment_t *push(struct chip8_undo_t *u, const union chip8_t *c8)
+{
+    if (u->used == u->nb)
+    {
+        u->first = (u->first + 1) % u->nb;
+        u->used--;
+    }
+    struct chip8_undo_segment_t *seg = segment(u, u->used++);
+    memcpy(&seg->keyframe, c8, sizeof(seg->keyframe));
+    // the keys the host set since belong to the next record
+    memcpy(seg->keyframe.keys, u->keys, sizeof(u->keys));
+    seg->cycle = u->cycle;
+    seg->records_nb = 0;
+    seg->len = 0;
+    return seg;
+}
+
+void chip8_undo_t_clear(struct chip8_undo_t *u, const union chip8_t *c8)
+{
+    u->first = 0;
+    u->used = 0;
+    u->cycle = 0;
+    memcpy(u->keys, c8->keys, sizeof(u->keys));
+    push(u, c8);
+}
+
+int chip8_undo_t_step(struct chip8_undo_t *u, union chip8_t *c8)
+{
+    struct undo_record_t r;
+    r.len = 0;
+    r.runs = 0;
+    // undone last, after any instruction that wrote over the keys
+    if (memcmp(c8->keys, u->keys, sizeof(u->keys)) != 0)
+    {
+        save_bytes(&r, offsetof(union chip8_t, keys), u->keys, sizeof(u->keys));
+    }
+    struct chip8_undo_span_t spans[UNDO_SPANS_NB];
+    const size_t spans_nb = chip8_undo_writes(c8, spans);
+    for (size_t i = 0; i < spans_nb; i++)
+    {
+        save_bytes(&r, spans[i].off, c8->memory + spans[i].off, spans[i].len);
+    }
+    r.bytes[r.len++] = r.runs;
+
+    struct chip8_undo_segment_t *seg = segment(u, u->used - 1);
+    if (seg->records_nb == UNDO_SEGMENT_CYCLES)
+    {
+        seg = push(u, c8);
+    }
+    if (seg->len + r.len > seg->cap)
+    {
+        const size_t cap = seg->cap ? seg->cap * 2 : 16 * UNDO_RECORD_NB;
+        uint8_t *log = realloc(seg->log, cap);
+        if (log == NULL)
+        {
+            return -1;
+        }
+        seg->log = log;
+        seg->cap = cap;
+    }
+    memcpy(seg->log + seg->len, r.bytes, r.len);
+    seg->len += r.len;
+    seg->records_nb++;
+    u->cycle++;
+
+    chip8_t_emulate_cycle(c8);
+    memcpy(u->keys, c8->keys, sizeof(u->keys));
+    return 0;
+}
+
+int chip8_undo_t_back(struct chip8_undo_t *u, union chip8_t *c8)
+{
+    struct chip8_undo_segment_t *seg = segment(u, u->used - 1);
+    while (seg->records_nb == 0)
+    {
+        if (u->used == 1)
+        {
+            return 0;
+        }
+        // c8 is at this keyframe, the record before it is in the last segment
+        u->used--;
+        seg = segment(u, u->used - 1);
+    }
+
+    // keys the host set since the last instruction never made it into a
+    // record, so they're dropped as well
+    memcpy(c8->keys, u->keys, sizeof(u->keys));
+    const uint8_t *end = seg->log + seg->len - 1;
+    for (size_t runs = *end; runs > 0; runs--)
+    {
+        const size_t n = end[-1];
+        const size_t off = end[-3] | (end[-2] << 8);
+        end -= 3 + n;
+        memcpy(c8->memory + off, end, n);
+    }
+    seg->len = end - seg->log;
+    seg->records_nb--;
+    u->cycle--;
+    memcpy(u->keys, c8->keys, sizeof(u->keys));
+    return 1;
+}
+
+uint64_t chip8_undo_t_oldest(const struct chip8_undo_t *u)
+{
+    return segment(u, 0)->cycle;
+}
+
+int chip8_undo_t_seek(struct chip8_undo_t *u, union chip8_t *c8, uint64_t cycle)
+{
+    if (cycle > u->cycle || cycle < chip8_undo_t_oldest(u))
+    {
+        return -1;
+    }
+
+    // the segment holding cycle. if there's one after it, its keyframe
+    // is where that segment ends, and saves undoing everything since
+    size_t i = u->used - 1;
+    while (segment(u, i)->cycle > cycle)
+    {
+        i--;
+    }
+    if (i + 1 < u->used)
+    {
+        const struct chip8_undo_segment_t *next = segment(u, i + 1);
+        memcpy(c8, &next->keyframe, sizeof(*c8));
+        memcpy(u->keys, c8->keys, sizeof(u->keys));
+        u->cycle = next->cycle;
+        u->used = i + 1;
+    }
+    while (u->cycle > cycle)
+    {
+        chip8_undo_t_back(u, c8);
+    }
+    return 0;
+}
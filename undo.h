@@ -0,0 +1,95 @@
+#ifndef CHIP8_UNDO_H
+#define CHIP8_UNDO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum undo_constants
+{
+    // instructions between keyframes
+    UNDO_SEGMENT_CYCLES = 4096,
+
+    // the longest undo record. 00E0 saves the whole display, everything
+    // else saves a few bytes
+    UNDO_RECORD_NB = 512,
+
+    // the most spans an instruction writes, two for each row of a sprite
+    UNDO_SPANS_NB = 40
+};
+
+// a range of bytes of the state
+struct chip8_undo_span_t
+{
+    uint16_t off;
+    uint16_t len;
+};
+
+// a keyframe and the undo records of the instructions run after it
+struct chip8_undo_segment_t
+{
+    union chip8_t keyframe;
+    uint64_t cycle;
+    size_t records_nb;
+
+    uint8_t *log;
+    size_t len;
+    size_t cap;
+};
+
+// instruction level history, for stepping backwards.
+// before each instruction runs, only the bytes it's about to overwrite are
+// logged: PC and the timers, plus the V register, I, stack slot, display
+// rows or the up to 16 bytes of memory the opcode writes. that's around 10
+// bytes an instruction instead of a 4 KB state.
+// the log is split into segments that start with a keyframe. once all
+// segments are in use the oldest one is dropped, which bounds the memory,
+// and seeking far back only has to undo from the next keyframe.
+// the host may change the keys between instructions, anything else it
+// changes needs a chip8_undo_t_clear
+struct chip8_undo_t
+{
+    // ring of segments, oldest first
+    struct chip8_undo_segment_t *segments;
+    size_t nb;
+    size_t first;
+    size_t used;
+
+    // instructions run since the last clear
+    uint64_t cycle;
+
+    // keys as of the last instruction, to notice the host changing them
+    uint8_t keys[16];
+};
+
+// the parts of c8 the instruction at PC is about to write. the first span
+// is PC, the timers and SP, which most instructions leave alone or only
+// tick; every byte of the spans after it is stored to, changed or not.
+// returns how many spans were filled in
+size_t chip8_undo_writes(const union chip8_t *c8, struct chip8_undo_span_t *spans);
+
+// keep at most segments_nb * UNDO_SEGMENT_CYCLES instructions.
+// returns -1 if we're out of memory
+int chip8_undo_t_init(struct chip8_undo_t *u, size_t segments_nb);
+void chip8_undo_t_destroy(struct chip8_undo_t *u);
+
+// forget the history, c8 becomes cycle 0
+void chip8_undo_t_clear(struct chip8_undo_t *u, const union chip8_t *c8);
+
+// log and run the instruction at PC. returns -1 without running it if
+// we're out of memory
+int chip8_undo_t_step(struct chip8_undo_t *u, union chip8_t *c8);
+
+// undo the last instruction. returns 0 if the history doesn't go back
+// any further
+int chip8_undo_t_back(struct chip8_undo_t *u, union chip8_t *c8);
+
+// the earliest cycle still in the history
+uint64_t chip8_undo_t_oldest(const struct chip8_undo_t *u);
+
+// go back to an earlier cycle, restoring the keyframe after it and
+// undoing from there. returns -1 if it isn't in the history
+int chip8_undo_t_seek(struct chip8_undo_t *u, union chip8_t *c8, uint64_t cycle);
+
+#endif
@@ -0,0 +1,515 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "watch.h"
+
+struct watch_parser_t
+{
+    const char *src;
+    const char *p;
+    struct chip8_watch_t *w;
+
+    // stack slots in use at this point of the program, and the most ever
+    size_t depth;
+    size_t max_depth;
+
+    // a jump lands on this instruction, so nothing before it may be
+    // folded together with anything after it
+    size_t barrier;
+
+    char *err;
+    size_t err_size;
+    int failed;
+};
+
+struct watch_name_t
+{
+    const char *name;
+    uint8_t op;
+    int64_t arg;
+};
+
+// names that are plain loads from a fixed place in the instance
+static const struct watch_name_t NAMES[] = {
+    {"I", WATCH_LOAD16, offsetof(union chip8_t, I)},
+    {"PC", WATCH_LOAD16, offsetof(union chip8_t, PC)},
+    {"SP", WATCH_LOAD8, offsetof(union chip8_t, SP)},
+    {"DT", WATCH_LOAD8, offsetof(union chip8_t, DT)},
+    {"ST", WATCH_LOAD8, offsetof(union chip8_t, ST)},
+    {"frame", WATCH_FRAME, 0},
+};
+
+// names that take an index in brackets
+static const struct watch_name_t INDEXED[] = {
+    {"mem", WATCH_MEM, 0},
+    {"V", WATCH_V, 0},
+    {"key", WATCH_KEY, 0},
+};
+
+// binary operators from the loosest binding level to the tightest.
+// longer spellings come first so "<=" isn't read as "<"
+static const struct
+{
+    const char *text;
+    uint8_t op;
+    int level;
+} BINARY[] = {
+    {"||", WATCH_JNZ, 0},
+    {"&&", WATCH_JZ, 1},
+    {"|", WATCH_OR, 2},
+    {"^", WATCH_XOR, 3},
+    {"&", WATCH_AND, 4},
+    {"==", WATCH_EQ, 5},
+    {"!=", WATCH_NE, 5},
+    {"<<", WATCH_SHL, 7},
+    {">>", WATCH_SHR, 7},
+    {"<=", WATCH_LE, 6},
+    {">=", WATCH_GE, 6},
+    {"<", WATCH_LT, 6},
+    {">", WATCH_GT, 6},
+    {"+", WATCH_ADD, 8},
+    {"-", WATCH_SUB, 8},
+    {"*", WATCH_MUL, 9},
+    {"/", WATCH_DIV, 9},
+    {"%", WATCH_MOD, 9},
+};
+
+enum watch_levels
+{
+    LEVEL_NB = 10
+};
+
+static inline int64_t watch_unary(uint8_t op, int64_t a)
+{
+    switch (op)
+    {
+    case WATCH_NEG:
+        return -(uint64_t)a;
+    case WATCH_NOT:
+        return !a;
+    case WATCH_INV:
+        return ~a;
+    default: // WATCH_BOOL
+        return a != 0;
+    }
+}
+
+static inline int64_t watch_binary(uint8_t op, int64_t a, int64_t b)
+{
+    // arithmetic wraps instead of being undefined on overflow
+    switch (op)
+    {
+    case WATCH_MUL:
+        return (uint64_t)a * (uint64_t)b;
+    case WATCH_DIV:
+        return (b == 0 || (b == -1 && a == INT64_MIN)) ? 0 : a / b;
+    case WATCH_MOD:
+        return (b == 0 || b == -1) ? 0 : a % b;
+    case WATCH_ADD:
+        return (uint64_t)a + (uint64_t)b;
+    case WATCH_SUB:
+        return (uint64_t)a - (uint64_t)b;
+    case WATCH_SHL:
+        return (uint64_t)a << (b & 63);
+    case WATCH_SHR:
+        return a >> (b & 63);
+    case WATCH_LT:
+        return a < b;
+    case WATCH_LE:
+        return a <= b;
+    case WATCH_GT:
+        return a > b;
+    case WATCH_GE:
+        return a >= b;
+    case WATCH_EQ:
+        return a == b;
+    case WATCH_NE:
+        return a != b;
+    case WATCH_AND:
+        return a & b;
+    case WATCH_XOR:
+        return a ^ b;
+    default: // WATCH_OR
+        return a | b;
+    }
+}
+
+static inline int watch_pixel(const union chip8_t *c8, int64_t x, int64_t y)
+{
+    const size_t bit = (y & 31) * 64 + (x & 63);
+    return (c8->display[bit / 8] >> (7 - (bit % 8))) & 1;
+}
+
+static void fail(struct watch_parser_t *ps, const char *fmt, ...)
+{
+    if (ps->failed)
+    {
+        return;
+    }
+    ps->failed = 1;
+
+    int len = snprintf(ps->err, ps->err_size, "column %d: ", (int)(ps->p - ps->src) + 1);
+    if (len >= 0 && (size_t)len < ps->err_size)
+    {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(ps->err + len, ps->err_size - len, fmt, args);
+        va_end(args);
+    }
+}
+
+// whether the last n instructions are constants nothing jumps between
+static int last_consts(const struct watch_parser_t *ps, size_t n)
+{
+    const struct chip8_watch_t *w = ps->w;
+    if (w->nb < n || w->nb - n < ps->barrier)
+    {
+        return 0;
+    }
+    for (size_t i = w->nb - n; i < w->nb; i++)
+    {
+        if (w->insns[i].op != WATCH_CONST)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// append an instruction, folding it into the ones before when they're
+// constants, so e.g. mem[0x2F0] compiles to a single load
+static size_t emit(struct watch_parser_t *ps, uint8_t op, int64_t arg)
+{
+    struct chip8_watch_t *w = ps->w;
+    struct chip8_watch_insn_t *last = w->nb ? w->insns + w->nb - 1 : NULL;
+
+    switch (op)
+    {
+    case WATCH_CONST:
+    case WATCH_LOAD8:
+    case WATCH_LOAD16:
+    case WATCH_FRAME:
+        ps->depth += 1;
+        break;
+    case WATCH_MEM:
+    case WATCH_V:
+    case WATCH_KEY:
+        if (last_consts(ps, 1))
+        {
+            const int64_t i = last->arg;
+            last->op = WATCH_LOAD8;
+            last->arg = op == WATCH_MEM ? (i & (MEM_NB - 1))
+                        : op == WATCH_V ? (int64_t)offsetof(union chip8_t, V) + (i & 15)
+                                        : (int64_t)offsetof(union chip8_t, keys) + (i & 15);
+            return w->nb - 1;
+        }
+        break;
+    case WATCH_NEG:
+    case WATCH_NOT:
+    case WATCH_INV:
+    case WATCH_BOOL:
+        if (last_consts(ps, 1))
+        {
+            last->arg = watch_unary(op, last->arg);
+            return w->nb - 1;
+        }
+        break;
+    case WATCH_PIXEL:
+    case WATCH_JZ:
+    case WATCH_JNZ:
+        ps->depth -= 1;
+        break;
+    default:
+        ps->depth -= 1;
+        if (last_consts(ps, 2))
+        {
+            last[-1].arg = watch_binary(op, last[-1].arg, last->arg);
+            w->nb -= 1;
+            return w->nb - 1;
+        }
+        break;
+    }
+
+    if (ps->depth > ps->max_depth)
+    {
+        ps->max_depth = ps->depth;
+    }
+    if (w->nb == WATCH_INSNS_NB)
+    {
+        fail(ps, "expression is too long");
+        return 0;
+    }
+    w->insns[w->nb].op = op;
+    w->insns[w->nb].arg = arg;
+    return w->nb++;
+}
+
+static void skip_space(struct watch_parser_t *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+    {
+        ps->p++;
+    }
+}
+
+static int accept(struct watch_parser_t *ps, const char *text)
+{
+    skip_space(ps);
+    const size_t len = strlen(text);
+    if (strncmp(ps->p, text, len) != 0)
+    {
+        return 0;
+    }
+    ps->p += len;
+    return 1;
+}
+
+static void expect(struct watch_parser_t *ps, const char *text)
+{
+    if (!accept(ps, text))
+    {
+        fail(ps, "expected '%s'", text);
+    }
+}
+
+static void parse_binary(struct watch_parser_t *ps, int level);
+
+static void parse_unary(struct watch_parser_t *ps)
+{
+    skip_space(ps);
+    if (ps->failed)
+    {
+        return;
+    }
+
+    static const struct
+    {
+        char c;
+        uint8_t op;
+    } UNARY[] = {{'-', WATCH_NEG}, {'!', WATCH_NOT}, {'~', WATCH_INV}, {'+', WATCH_BOOL}};
+    for (size_t i = 0; i < sizeof(UNARY) / sizeof(UNARY[0]); i++)
+    {
+        if (*ps->p == UNARY[i].c)
+        {
+            ps->p++;
+            parse_unary(ps);
+            // unary plus is a no-op, not a conversion to 0 or 1
+            if (UNARY[i].op != WATCH_BOOL)
+            {
+                emit(ps, UNARY[i].op, 0);
+            }
+            return;
+        }
+    }
+
+    if (*ps->p == '(')
+    {
+        ps->p++;
+        parse_binary(ps, 0);
+        expect(ps, ")");
+        return;
+    }
+
+    if (isdigit((unsigned char)*ps->p))
+    {
+        char *end;
+        const unsigned long long value = strtoull(ps->p, &end, 0);
+        ps->p = end;
+        emit(ps, WATCH_CONST, (int64_t)value);
+        return;
+    }
+
+    const char *start = ps->p;
+    while (isalnum((unsigned char)*ps->p) || *ps->p == '_')
+    {
+        ps->p++;
+    }
+    const size_t len = ps->p - start;
+
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++)
+    {
+        if (strlen(NAMES[i].name) == len && strncmp(NAMES[i].name, start, len) == 0)
+        {
+            emit(ps, NAMES[i].op, NAMES[i].arg);
+            return;
+        }
+    }
+    for (size_t i = 0; i < sizeof(INDEXED) / sizeof(INDEXED[0]); i++)
+    {
+        if (strlen(INDEXED[i].name) == len && strncmp(INDEXED[i].name, start, len) == 0)
+        {
+            expect(ps, "[");
+            parse_binary(ps, 0);
+            expect(ps, "]");
+            emit(ps, INDEXED[i].op, 0);
+            return;
+        }
+    }
+    if (len == 5 && strncmp(start, "pixel", len) == 0)
+    {
+        expect(ps, "(");
+        parse_binary(ps, 0);
+        expect(ps, ",");
+        parse_binary(ps, 0);
+        expect(ps, ")");
+        emit(ps, WATCH_PIXEL, 0);
+        return;
+    }
+
+    ps->p = start;
+    fail(ps, len ? "unknown name '%.*s'" : "expected a value", (int)len, start);
+}
+
+// precedence climbing, everything binding tighter than level is
+// parsed by the recursive call
+static void parse_binary(struct watch_parser_t *ps, int level)
+{
+    if (level == LEVEL_NB)
+    {
+        parse_unary(ps);
+        return;
+    }
+
+    parse_binary(ps, level + 1);
+    while (!ps->failed)
+    {
+        int op = -1;
+        skip_space(ps);
+        for (size_t i = 0; i < sizeof(BINARY) / sizeof(BINARY[0]); i++)
+        {
+            const size_t len = strlen(BINARY[i].text);
+            if (BINARY[i].level == level && strncmp(ps->p, BINARY[i].text, len) == 0)
+            {
+                // don't read the first half of || or && as | or &
+                if (len == 1 && (ps->p[1] == ps->p[0] || ps->p[1] == '=') && strchr("|&<>", ps->p[0]))
+                {
+                    continue;
+                }
+                ps->p += len;
+                op = BINARY[i].op;
+                break;
+            }
+        }
+        if (op < 0)
+        {
+            return;
+        }
+
+        if (op == WATCH_JZ || op == WATCH_JNZ)
+        {
+            // a && b: if a is 0 that's the result, otherwise it's !!b
+            const size_t jump = emit(ps, op, 0);
+            parse_binary(ps, level + 1);
+            emit(ps, WATCH_BOOL, 0);
+            ps->w->insns[jump].arg = ps->w->nb;
+            ps->barrier = ps->w->nb;
+        }
+        else
+        {
+            parse_binary(ps, level + 1);
+            emit(ps, op, 0);
+        }
+    }
+}
+
+int chip8_watch_t_compile(struct chip8_watch_t *w, const char *src, char *err, size_t err_size)
+{
+    struct watch_parser_t ps = {
+        .src = src,
+        .p = src,
+        .w = w,
+        .err = err,
+        .err_size = err_size,
+    };
+    w->nb = 0;
+
+    parse_binary(&ps, 0);
+    skip_space(&ps);
+    if (!ps.failed && *ps.p != '\0')
+    {
+        fail(&ps, "unexpected '%c'", *ps.p);
+    }
+    if (!ps.failed && ps.max_depth > WATCH_STACK_NB)
+    {
+        fail(&ps, "expression nests too deeply");
+    }
+    return ps.failed ? -1 : 0;
+}
+
+int64_t chip8_watch_t_eval(const struct chip8_watch_t *w, const union chip8_t *c8, uint64_t frame)
+{
+    int64_t stack[WATCH_STACK_NB];
+    size_t sp = 0;
+
+    for (size_t pc = 0; pc < w->nb; pc++)
+    {
+        const struct chip8_watch_insn_t *in = w->insns + pc;
+        switch (in->op)
+        {
+        case WATCH_CONST:
+            stack[sp++] = in->arg;
+            break;
+        case WATCH_LOAD8:
+            stack[sp++] = c8->memory[in->arg];
+            break;
+        case WATCH_LOAD16:
+        {
+            uint16_t value;
+            memcpy(&value, c8->memory + in->arg, sizeof(value));
+            stack[sp++] = value;
+            break;
+        }
+        case WATCH_FRAME:
+            stack[sp++] = (int64_t)frame;
+            break;
+        case WATCH_MEM:
+            stack[sp - 1] = c8->memory[stack[sp - 1] & (MEM_NB - 1)];
+            break;
+        case WATCH_V:
+            stack[sp - 1] = c8->V[stack[sp - 1] & 15];
+            break;
+        case WATCH_KEY:
+            stack[sp - 1] = c8->keys[stack[sp - 1] & 15] != 0;
+            break;
+        case WATCH_PIXEL:
+            sp--;
+            stack[sp - 1] = watch_pixel(c8, stack[sp - 1], stack[sp]);
+            break;
+        case WATCH_JZ:
+            if (stack[sp - 1] == 0)
+            {
+                pc = in->arg - 1;
+            }
+            else
+            {
+                sp--;
+            }
+            break;
+        case WATCH_JNZ:
+            if (stack[sp - 1] != 0)
+            {
+                stack[sp - 1] = 1;
+                pc = in->arg - 1;
+            }
+            else
+            {
+                sp--;
+            }
+            break;
+        case WATCH_NEG:
+        case WATCH_NOT:
+        case WATCH_INV:
+        case WATCH_BOOL:
+            stack[sp - 1] = watch_unary(in->op, stack[sp - 1]);
+            break;
+        default:
+            sp--;
+            stack[sp - 1] = watch_binary(in->op, stack[sp - 1], stack[sp]);
+            break;
+        }
+    }
+    return stack[0];
+}
@@ -0,0 +1,78 @@
+#ifndef CHIP8_WATCH_H
+#define CHIP8_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum watch_constants
+{
+    WATCH_INSNS_NB = 256,
+    WATCH_STACK_NB = 32
+};
+
+enum watch_op
+{
+    WATCH_CONST, // push arg
+    WATCH_LOAD8, // push memory[arg]
+    WATCH_LOAD16, // push the native uint16_t at memory + arg (PC, I)
+    WATCH_FRAME,
+    // pop an index, push mem[i], V[i], key[i]
+    WATCH_MEM,
+    WATCH_V,
+    WATCH_KEY,
+    WATCH_PIXEL, // pop y and x, push the pixel there
+    WATCH_NEG,
+    WATCH_NOT,
+    WATCH_INV,
+    WATCH_BOOL,
+    WATCH_MUL,
+    WATCH_DIV,
+    WATCH_MOD,
+    WATCH_ADD,
+    WATCH_SUB,
+    WATCH_SHL,
+    WATCH_SHR,
+    WATCH_LT,
+    WATCH_LE,
+    WATCH_GT,
+    WATCH_GE,
+    WATCH_EQ,
+    WATCH_NE,
+    WATCH_AND,
+    WATCH_XOR,
+    WATCH_OR,
+    // short circuits: if the top of the stack is zero (non-zero for
+    // WATCH_JNZ) leave it there as 0 (1) and jump to arg, otherwise pop it
+    WATCH_JZ,
+    WATCH_JNZ
+};
+
+struct chip8_watch_insn_t
+{
+    uint8_t op;
+    int64_t arg;
+};
+
+// an expression over an instance, compiled once to a small stack program
+// and evaluated at every frame boundary.
+// it reads memory and registers where they sit in union chip8_t, so
+// evaluating one never calls out of the emulator.
+//   mem[a]  V[x]  key[k]  pixel(x, y)  I  PC  SP  DT  ST  frame
+//   ! ~ - (unary)  * / %  + -  << >>  < <= > >=  == !=  &  ^  |  &&  ||
+// e.g. "mem[0x2F0] * 10 + mem[0x2F1]" or "V[3] == 0 && frame > 60".
+// addresses wrap around the 4 KB address space, dividing by zero gives zero
+struct chip8_watch_t
+{
+    struct chip8_watch_insn_t insns[WATCH_INSNS_NB];
+    size_t nb;
+};
+
+// returns 0 on success, or -1 with a message naming the offending column
+// in err if src doesn't parse or is too big
+int chip8_watch_t_compile(struct chip8_watch_t *w, const char *src, char *err, size_t err_size);
+
+int64_t chip8_watch_t_eval(const struct chip8_watch_t *w, const union chip8_t *c8, uint64_t frame);
+
+#endif